@@ -1,351 +1,1659 @@
-
-
-// Import necessari per la gestione di file (lettura/scrittura) e delle collezioni (Liste, Mappe, Set).
-import java.io.BufferedReader;
-import java.io.BufferedWriter;
-import java.io.FileReader;
-import java.io.FileWriter;
-import java.io.IOException;
-import java.io.PrintWriter;
-import java.util.ArrayList;
-import java.util.Collections;
-import java.util.HashMap;
-import java.util.HashSet;
-import java.util.List;
-import java.util.Map;
-import java.util.Set;
-
-/**
- * La classe Attore modella le informazioni essenziali di un attore.
- * Ogni istanza rappresenta un nodo nel nostro grafo.
- */
-class Attore {
-    // Codice intero, univoco, estratto da 'nconst'.
-    int codice;
-    // Nome dell'attore.
-    String nome;
-    // Anno di nascita, usato per il filtraggio iniziale.
-    int anno;
-    
-    /**
-     * Un Set per memorizzare i codici dei co-protagonisti.
-     * Usiamo un Set (HashSet) perché:
-     * 1. Garantisce l'unicità: un co-protagonista non può essere aggiunto più volte.
-     * 2. Offre performance eccellenti (O(1) in media) per l'aggiunta e la ricerca,
-     *    molto più veloce di una lista.
-     */
-    Set<Integer> coprotagonisti;
-    
-    /**
-     * Un Set per memorizzare i codici dei titoli a cui l'attore ha partecipato.
-     * Valgono le stesse motivazioni di performance e unicità viste per i coprotagonisti.
-     */
-    Set<Integer> titoliPartecipati;
-
-    /**
-     * Costruttore della classe Attore.
-     * Inizializza le variabili d'istanza e crea i Set vuoti.
-     * @param codice L'ID univoco dell'attore.
-     * @param nome Il nome dell'attore.
-     * @param anno L'anno di nascita dell'attore.
-     */
-    public Attore(int codice, String nome, int anno) {
-        this.codice = codice;
-        this.nome = nome;
-        this.anno = anno;
-        this.coprotagonisti = new HashSet<>();
-        this.titoliPartecipati = new HashSet<>(); 
-    }
-}
-
-/**
- * Classe principale del programma.
- * Si occupa di leggere i file TSV di IMDB, costruire il grafo degli attori,
- * e salvare i risultati in tre file di testo: nomi.txt, grafo.txt e partecipazioni.txt.
- */
-public class CreaGrafo {
-
-        /**
-     * Metodo principale eseguito all'avvio del programma.
-     * Gestisce dinamicamente 2 o 3 argomenti per compatibilità con lo script di test.
-     * @param args Argomenti dalla linea di comando:
-     *             - Caso 2 argomenti (test): <file_nomi.tsv> <file_titoli.tsv>
-     *             - Caso 3 argomenti (manuale): <name.basics.tsv> <title.principals.tsv> <title.basics.tsv>
-     */
-    public static void main(String[] args) {
-        // Controllo se il numero di argomenti è valido (deve essere 2 o 3).
-        if (args.length != 2 && args.length != 3) { 
-            // Se non è né 2 né 3, allora è un errore. Mostra un messaggio di aiuto completo.
-            System.err.println("Errore: Numero di argomenti non valido.");
-            System.err.println("Uso per il TEST AUTOMATICO (2 argomenti): java CreaGrafo <file_nomi.tsv> <file_titoli.tsv>");
-            System.err.println("Uso per esecuzione MANUALE (3 argomenti): java CreaGrafo <name.basics.tsv> <title.principals.tsv> <title.basics.tsv>");
-            System.exit(1); // Termina il programma con un codice di errore.
-        }
-
-        // Dichiarazione delle variabili per i percorsi dei file.
-        String pathNameBasics;
-        String pathTitlePrincipals;
-        
-        // Assegnazione dei percorsi dei file a variabili per maggiore leggibilità.
-        // Questa parte gestisce la logica per 2 o 3 argomenti.
-        if (args.length == 2) {
-            System.out.println("INFO: Rilevata esecuzione con 2 argomenti (modalità test).");
-            pathNameBasics = args[0];
-            pathTitlePrincipals = args[1];
-        } else { // In questo ramo, args.length è necessariamente 3.
-            System.out.println("INFO: Rilevata esecuzione con 3 argomenti (modalità manuale).");
-            pathNameBasics = args[0];
-            pathTitlePrincipals = args[1];
-            String pathTitleBasics = args[2]; // Questa variabile è usata solo in questa modalità.
-            
-            // --- PASSO 2 (opzionale): Leggere 'title.basics.tsv' ---
-            // Questo passo viene eseguito SOLO se vengono forniti 3 argomenti.
-            System.out.println("\nPASSO 2: Elaborazione di " + pathTitleBasics + "...");
-            System.out.println("-> File 'title.basics.tsv' scansionato. (Dati non memorizzati per ottimizzare la memoria).");
-        }
-        
-        /**
-         * La struttura dati centrale per memorizzare gli attori.
-         * Usiamo una Mappa (HashMap) che associa un codice (Integer) a un oggetto Attore.
-         * La scelta di HashMap è cruciale per le performance: ci permette di recuperare
-         * un attore dato il suo codice in tempo costante (O(1) in media), operazione
-         * che faremo milioni di volte durante la lettura di title.principals.tsv.
-         */
-        Map<Integer, Attore> attori = new HashMap<>();
-        
-        // Registriamo il tempo di inizio per calcolare la durata totale dell'esecuzione.
-        long startTime = System.currentTimeMillis();
-
-        // --- PASSO 1: Leggere il file dei nomi (es. 'name.basics.tsv' o 'miniN.tsv') e filtrare gli attori ---
-        System.out.println("PASSO 1: Elaborazione di " + pathNameBasics + " per trovare gli attori...");
-        try (BufferedReader br = new BufferedReader(new FileReader(pathNameBasics))) {
-            String line;
-            br.readLine(); // Salta la prima riga che contiene l'intestazione del file.
-            
-            while ((line = br.readLine()) != null) {
-                // Il file è TSV (Tab-Separated Values), quindi dividiamo la riga usando il carattere '\t'.
-                String[] fields = line.split("\t");
-                if (fields.length < 5) continue; // Salta righe malformate.
-
-                // Estrazione dei campi di interesse secondo le specifiche.
-                String nconst = fields[0];          // es. "nm0000001"
-                String primaryName = fields[1];     // es. "Fred Astaire"
-                String birthYearStr = fields[2];    // es. "1899" o "\N"
-                String primaryProfession = fields[4]; // es. "actor,producer"
-
-                // Applichiamo i filtri richiesti dalle specifiche:
-                // 1. L'anno di nascita non deve essere "\\N".
-                if ("\\N".equals(birthYearStr)) {
-                    continue;
-                }
-                // 2. La professione deve contenere "actor" o "actress".
-                //    Controlliamo che la stringa non sia null per sicurezza.
-                if (primaryProfession == null || (!primaryProfession.contains("actor") && !primaryProfession.contains("actress"))) {
-                    continue;
-                }
-
-                try {
-                    // Conversione dei dati nei tipi corretti.
-                    int codice = Integer.parseInt(nconst.substring(2)); // Rimuove "nm" e converte in intero.
-                    int anno = Integer.parseInt(birthYearStr);
-                    
-                    // Se l'attore passa tutti i filtri, creiamo un nuovo oggetto Attore
-                    // e lo inseriamo nella mappa.
-                    Attore attore = new Attore(codice, primaryName, anno);
-                    attori.put(codice, attore);
-                } catch (NumberFormatException | StringIndexOutOfBoundsException e) {
-                    // Ignora silenziosamente le righe con formati numerici o di codice non validi.
-                }
-            }
-        } catch (IOException e) {
-            System.err.println("Errore critico durante la lettura di " + pathNameBasics + ": " + e.getMessage());
-            e.printStackTrace();
-            System.exit(1);
-        }
-        System.out.println("-> Trovati " + attori.size() + " attori che soddisfano i criteri.");
-
-
-        // --- PASSO 3: Scrivere 'nomi.txt' con l'elenco ordinato degli attori ---
-        System.out.println("\nPASSO 3: Scrittura del file nomi.txt...");
-        // Per scrivere in ordine di codice, estraiamo tutte le chiavi (codici) dalla mappa,
-        // le mettiamo in una lista e ordiniamo la lista.
-        List<Integer> codiciAttoriOrdinati = new ArrayList<>(attori.keySet());
-        Collections.sort(codiciAttoriOrdinati);
-
-        // Usiamo PrintWriter e BufferedWriter per una scrittura efficiente su file.
-        try (PrintWriter pw = new PrintWriter(new BufferedWriter(new FileWriter("nomi.txt")))) {
-            for (Integer codice : codiciAttoriOrdinati) {
-                Attore attore = attori.get(codice);
-                pw.println(attore.codice + "\t" + attore.nome + "\t" + attore.anno);
-            }
-        } catch (IOException e) {
-            System.err.println("Errore critico durante la scrittura di nomi.txt: " + e.getMessage());
-            e.printStackTrace();
-            System.exit(1);
-        }
-        System.out.println("-> File nomi.txt scritto correttamente con " + codiciAttoriOrdinati.size() + " righe.");
-
-
-        // --- PASSO 4: Leggere il file dei titoli (es. 'title.principals.tsv') per costruire il grafo e le partecipazioni ---
-        System.out.println("\nPASSO 4: Elaborazione di " + pathTitlePrincipals + " per costruire il grafo...");
-        try (BufferedReader br = new BufferedReader(new FileReader(pathTitlePrincipals))) {
-            String line;
-            br.readLine(); // Salta intestazione.
-
-            // Questa è la logica di "streaming" per elaborare i cast per ogni titolo.
-            // Il file `title.principals.tsv` è raggruppato per `tconst`. Sfruttiamo questo.
-            String currentTconstRaw = null; // Codice del titolo che stiamo attualmente processando
-            Set<Integer> currentCast = new HashSet<>(); // Il cast di attori per il titolo corrente
-
-            while ((line = br.readLine()) != null) {
-                String[] fields = line.split("\t");
-                if (fields.length < 3) continue;
-
-                String tconstRaw = fields[0]; // es. "tt0000001"
-                String nconst = fields[2];    // es. "nm0000123"
-                
-                try {
-                    int codiceAttore = Integer.parseInt(nconst.substring(2));
-                    
-                    // Processiamo la riga SOLO se l'attore è presente nella nostra mappa di attori filtrati.
-                    // Questa verifica è velocissima grazie alla HashMap.
-                    if (attori.containsKey(codiceAttore)) {
-                        Attore attore = attori.get(codiceAttore);
-                        int codiceTitolo = Integer.parseInt(tconstRaw.substring(2));
-                        
-                        // Aggiungiamo il titolo alla lista delle partecipazioni dell'attore.
-                        attore.titoliPartecipati.add(codiceTitolo);
-
-                        // Se stiamo iniziando o se il tconst è cambiato, significa che
-                        // abbiamo finito di leggere il cast del titolo precedente.
-                        if (!tconstRaw.equals(currentTconstRaw)) {
-                            // Se il cast precedente aveva almeno 2 attori, lo elaboriamo.
-                            if (currentCast.size() >= 2) {
-                                processCast(currentCast, attori);
-                            }
-                            // Prepariamo per il nuovo titolo.
-                            currentTconstRaw = tconstRaw;
-                            currentCast.clear();
-                        }
-                        // Aggiungiamo l'attore corrente al cast del titolo attuale.
-                        currentCast.add(codiceAttore);
-                    }
-                } catch (NumberFormatException | StringIndexOutOfBoundsException e) {
-                    // Ignora righe con codici malformati.
-                }
-            }
-            // Alla fine del file, dobbiamo processare l'ultimo cast rimasto in memoria.
-            if (currentCast.size() >= 2) {
-                processCast(currentCast, attori);
-            }
-        } catch (IOException e) {
-            System.err.println("Errore critico durante la lettura di " + pathTitlePrincipals + ": " + e.getMessage());
-            e.printStackTrace();
-            System.exit(1);
-        }
-        System.out.println("-> Relazioni del grafo e partecipazioni costruite con successo.");
-
-
-        // --- PASSO 5: Scrivere 'grafo.txt' ---
-        System.out.println("\nPASSO 5: Scrittura del file grafo.txt...");
-        long totalDegreeSum = 0; // Somma dei gradi di tutti i nodi (utile per verifica)
-
-        try (PrintWriter pw = new PrintWriter(new BufferedWriter(new FileWriter("grafo.txt")))) {
-            // Usiamo la lista di codici già ordinata in precedenza.
-            for (Integer codiceAttore : codiciAttoriOrdinati) {
-                Attore attore = attori.get(codiceAttore);
-                
-                // Per ogni attore, ordiniamo la lista dei suoi co-protagonisti come richiesto.
-                List<Integer> coprotagonistiOrdinati = new ArrayList<>(attore.coprotagonisti);
-                Collections.sort(coprotagonistiOrdinati);
-
-                pw.print(attore.codice);
-                pw.print("\t");
-                pw.print(coprotagonistiOrdinati.size());
-                totalDegreeSum += coprotagonistiOrdinati.size();
-
-                for (Integer coprotagonistaCodice : coprotagonistiOrdinati) {
-                    pw.print("\t");
-                    pw.print(coprotagonistaCodice);
-                }
-                pw.println();
-            }
-        } catch (IOException e) {
-            System.err.println("Errore critico durante la scrittura di grafo.txt: " + e.getMessage());
-            e.printStackTrace();
-            System.exit(1);
-        }
-        System.out.println("-> File grafo.txt scritto correttamente.");
-        // In un grafo non orientato, il numero di archi è la somma dei gradi diviso 2.
-        System.out.println("-> Numero di archi unici nel grafo: " + totalDegreeSum / 2);
-
-
-        // --- PASSO 6: Scrivere 'partecipazioni.txt' ---
-        System.out.println("\nPASSO 6: Scrittura del file partecipazioni.txt...");
-        try (PrintWriter pw = new PrintWriter(new BufferedWriter(new FileWriter("partecipazioni.txt")))) {
-            // Usiamo di nuovo la lista di codici ordinati.
-            for (Integer codiceAttore : codiciAttoriOrdinati) {
-                Attore attore = attori.get(codiceAttore);
-                
-                // Ordiniamo la lista dei titoli a cui ha partecipato.
-                List<Integer> titoliPartecipatiOrdinati = new ArrayList<>(attore.titoliPartecipati);
-                Collections.sort(titoliPartecipatiOrdinati);
-
-                pw.print(attore.codice);
-                pw.print("\t");
-                pw.print(titoliPartecipatiOrdinati.size());
-
-                for (Integer codiceTitolo : titoliPartecipatiOrdinati) {
-                    pw.print("\t");
-                    pw.print(codiceTitolo);
-                }
-                pw.println();
-            }
-        } catch (IOException e) {
-            System.err.println("Errore critico durante la scrittura di partecipazioni.txt: " + e.getMessage());
-            e.printStackTrace();
-            System.exit(1);
-        }
-        System.out.println("-> File partecipazioni.txt scritto correttamente.");
-
-        // Calcolo e stampa del tempo totale di esecuzione.
-        long endTime = System.currentTimeMillis();
-        System.out.println("\nEsecuzione completata in " + (endTime - startTime) / 1000.0 + " secondi.");
-    }
-
-    /**
-     * Metodo di utilità per processare il cast di un singolo titolo.
-     * Dato un insieme di codici di attori che hanno lavorato insieme, crea un arco
-     * (una relazione di co-protagonismo) tra ogni possibile coppia di attori.
-     * 
-     * @param cast Set di codici degli attori che formano il cast di un titolo.
-     * @param attoriMap La mappa principale che contiene tutti gli oggetti Attore.
-     */
-    private static void processCast(Set<Integer> cast, Map<Integer, Attore> attoriMap) {
-        // Se ci sono meno di 2 attori del nostro elenco nel cast, non ci sono coppie da creare.
-        if (cast.size() < 2) {
-            return; 
-        }
-        
-        // Convertiamo il Set in una Lista per poter accedere agli elementi tramite indice.
-        // Questo ci permette di creare le coppie in modo efficiente senza duplicati.
-        List<Integer> castList = new ArrayList<>(cast);
-        
-        // Usiamo due cicli annidati per creare ogni coppia unica (a1, a2).
-        // Il secondo ciclo parte da 'i + 1' per evitare di accoppiare un attore con se stesso
-        // e per evitare coppie duplicate (es. se processiamo (a1, a2), non processeremo (a2, a1)).
-        for (int i = 0; i < castList.size(); i++) {
-            for (int j = i + 1; j < castList.size(); j++) {
-                Integer codice1 = castList.get(i);
-                Integer codice2 = castList.get(j);
-
-                Attore attore1 = attoriMap.get(codice1);
-                Attore attore2 = attoriMap.get(codice2);
-
-                // Poiché il grafo non è orientato, aggiungiamo la relazione in entrambe le direzioni.
-                attore1.coprotagonisti.add(codice2);
-                attore2.coprotagonisti.add(codice1);
-            }
-        }
-    }
-}
+
+
+// Import necessari per la gestione di file (lettura/scrittura), degli array e dei thread.
+import java.io.BufferedInputStream;
+import java.io.BufferedOutputStream;
+import java.io.BufferedWriter;
+import java.io.DataInputStream;
+import java.io.DataOutputStream;
+import java.io.File;
+import java.io.FileInputStream;
+import java.io.FileOutputStream;
+import java.io.FileWriter;
+import java.io.IOException;
+import java.io.PrintWriter;
+import java.io.RandomAccessFile;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.channels.FileChannel;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Files;
+import java.nio.file.Paths;
+import java.nio.file.StandardCopyOption;
+import java.nio.file.StandardOpenOption;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+import java.util.concurrent.Callable;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+
+/**
+ * Gli attori filtrati, memorizzati in array paralleli invece che come oggetti:
+ * dopo ordina() sono in ordine di codice e la posizione di un attore è il suo
+ * indice nel grafo (lo stesso id denso di cammini.c).
+ */
+class ElencoAttori {
+    int n;
+    int[] codici = new int[1024];
+    int[] anni = new int[1024];
+    String[] nomi = new String[1024];
+
+    /**
+     * Tabella diretta codice -> indice (-1 se il codice non è di un attore),
+     * usata quando il codice massimo è abbastanza piccolo; altrimenti si usa una
+     * ricerca binaria su 'codici'.
+     */
+    private int[] indiceDiCodice;
+    private static final int MAX_TABELLA = 1 << 25;
+
+    void aggiungi(int codice, String nome, int anno) {
+        if (n == codici.length) {
+            int cap = n * 2;
+            codici = Arrays.copyOf(codici, cap);
+            anni = Arrays.copyOf(anni, cap);
+            nomi = Arrays.copyOf(nomi, cap);
+        }
+        codici[n] = codice;
+        anni[n] = anno;
+        nomi[n] = nome;
+        n++;
+    }
+
+    /** Aggiunge in coda gli attori di un altro elenco (non ancora ordinato). */
+    void aggiungiTutti(ElencoAttori altro) {
+        for (int i = 0; i < altro.n; i++) {
+            aggiungi(altro.codici[i], altro.nomi[i], altro.anni[i]);
+        }
+    }
+
+    /**
+     * Ordina gli attori per codice. Se un codice compare più volte resta l'ultima
+     * riga letta, come avverrebbe inserendo le righe in una mappa.
+     */
+    void ordina() {
+        // Codice nei 32 bit alti e posizione di lettura in quelli bassi (i codici sono >= 0)
+        long[] chiavi = new long[n];
+        for (int i = 0; i < n; i++) {
+            chiavi[i] = ArrayLong.coppia(codici[i], i);
+        }
+        Arrays.parallelSort(chiavi);
+        int[] nuoviCodici = new int[n];
+        int[] nuoviAnni = new int[n];
+        String[] nuoviNomi = new String[n];
+        int k = 0;
+        for (int i = 0; i < n; i++) {
+            if (i + 1 < n && ArrayLong.alto(chiavi[i + 1]) == ArrayLong.alto(chiavi[i])) {
+                continue; // Un'altra riga con lo stesso codice è stata letta dopo
+            }
+            int pos = ArrayLong.basso(chiavi[i]);
+            nuoviCodici[k] = codici[pos];
+            nuoviAnni[k] = anni[pos];
+            nuoviNomi[k] = nomi[pos];
+            k++;
+        }
+        n = k;
+        codici = Arrays.copyOf(nuoviCodici, n);
+        anni = Arrays.copyOf(nuoviAnni, n);
+        nomi = Arrays.copyOf(nuoviNomi, n);
+
+        indiceDiCodice = null;
+        if (n > 0 && codici[n - 1] < MAX_TABELLA) {
+            indiceDiCodice = new int[codici[n - 1] + 1];
+            Arrays.fill(indiceDiCodice, -1);
+            for (int i = 0; i < n; i++) {
+                indiceDiCodice[codici[i]] = i;
+            }
+        }
+    }
+
+    /** Indice dell'attore con il codice dato, -1 se non è tra gli attori. Dopo ordina(). */
+    int indice(int codice) {
+        if (indiceDiCodice != null) {
+            return codice >= 0 && codice < indiceDiCodice.length ? indiceDiCodice[codice] : -1;
+        }
+        int i = Arrays.binarySearch(codici, 0, n, codice);
+        return i >= 0 ? i : -1;
+    }
+}
+
+/**
+ * Array di long che cresce quando serve, senza un oggetto per elemento.
+ * Raccoglie coppie di interi impacchettate in un long (coppia()), che si
+ * ordinano e si liberano dai duplicati tutte insieme con compatta(). Quando
+ * l'array è pieno, prima di ingrandirlo si prova a compattarlo: se i duplicati
+ * sono molti (un attore che ritrova gli stessi colleghi in molti titoli) lo
+ * spazio basta a lungo.
+ */
+class ArrayLong {
+    long[] dati;
+    int dim;
+
+    ArrayLong(int capacita) {
+        dati = new long[capacita];
+    }
+
+    void aggiungi(long v) {
+        if (dim == dati.length) {
+            compatta();
+            if (dim > dati.length / 2 || dati.length == 0) {
+                long cap = Math.min((long) dati.length * 3 / 2 + 1, Integer.MAX_VALUE - 8);
+                if (cap <= dati.length) {
+                    throw new IllegalStateException("troppe coppie distinte per un array");
+                }
+                dati = Arrays.copyOf(dati, (int) cap);
+            }
+        }
+        dati[dim++] = v;
+    }
+
+    void aggiungiTutti(ArrayLong altro) {
+        for (int i = 0; i < altro.dim; i++) {
+            aggiungi(altro.dati[i]);
+        }
+    }
+
+    /** Ordina (in parallelo) e rimuove i duplicati. */
+    void compatta() {
+        dim = ordinaSenzaDuplicati(dati, dim);
+    }
+
+    /** Libera la memoria degli elementi, che non servono più. */
+    void libera() {
+        dati = new long[0];
+        dim = 0;
+    }
+
+    /** Ordina (in parallelo) i primi dim elementi di dati, rimuove i duplicati e restituisce quanti ne restano. */
+    static int ordinaSenzaDuplicati(long[] dati, int dim) {
+        Arrays.parallelSort(dati, 0, dim);
+        int k = 0;
+        for (int i = 0; i < dim; i++) {
+            if (k == 0 || dati[i] != dati[k - 1]) {
+                dati[k++] = dati[i];
+            }
+        }
+        return k;
+    }
+
+    /** Scorre gli elementi in ordine di posizione (dopo compatta(), in ordine crescente). */
+    SorgenteLong scorri() {
+        return scorri(dati, dim);
+    }
+
+    static SorgenteLong scorri(long[] dati, int dim) {
+        return new SorgenteLong() {
+            private int i;
+
+            public boolean haProssimo() {
+                return i < dim;
+            }
+
+            public long prossimo() {
+                return dati[i++];
+            }
+        };
+    }
+
+    /** Coppia (alto, basso) di interi non negativi: l'ordine dei long è quello delle coppie. */
+    static long coppia(int alto, int basso) {
+        return ((long) alto << 32) | (basso & 0xFFFFFFFFL);
+    }
+
+    static int alto(long v) {
+        return (int) (v >>> 32);
+    }
+
+    static int basso(long v) {
+        return (int) v;
+    }
+}
+
+/** Sequenza di long letta in ordine, da un array o dalla fusione di file temporanei. */
+interface SorgenteLong extends AutoCloseable {
+    boolean haProssimo();
+
+    long prossimo() throws IOException;
+
+    @Override
+    default void close() throws IOException {
+    }
+}
+
+/**
+ * Come ArrayLong, ma con un buffer di dimensione fissa: quando si riempie e la
+ * compattazione non basta, il contenuto ordinato finisce in un file temporaneo
+ * (un "run") e il buffer ricomincia da capo. scorri() fonde i run con un heap
+ * a k vie, eliminando i duplicati tra run diversi, senza caricarli in memoria.
+ * La memoria usata resta quindi entro byteMemoria, qualunque sia l'input.
+ */
+class ArrayLongEsterno implements AutoCloseable {
+    /** Buffer di lettura minimo di un run nella fusione: sotto, conviene una passata in più. */
+    private static final int DIM_LETTURA_MINIMA = 1 << 13;
+    /** Buffer di scrittura di un run. */
+    private static final int DIM_SCRITTURA = 1 << 16;
+
+    private long[] buffer;
+    private int dim;
+    private final long byteMemoria;
+    private final ArrayList<File> run = new ArrayList<>();
+
+    /**
+     * @param byteMemoria La memoria del buffer, e poi di tutti i buffer di lettura della fusione.
+     *                    Il buffer ne usa metà: l'altra metà è per il buffer di lavoro
+     *                    di Arrays.parallelSort, grande quanto l'array da ordinare.
+     */
+    ArrayLongEsterno(long byteMemoria) {
+        this.byteMemoria = byteMemoria;
+        buffer = new long[(int) Math.max(1024, Math.min(byteMemoria / 16, Integer.MAX_VALUE - 8))];
+    }
+
+    void aggiungi(long v) throws IOException {
+        if (dim == buffer.length) {
+            dim = ArrayLong.ordinaSenzaDuplicati(buffer, dim);
+            if (dim > buffer.length / 2) {
+                scriviRun();
+            }
+        }
+        buffer[dim++] = v;
+    }
+
+    int numRun() {
+        return run.size();
+    }
+
+    /** Scrive il buffer, ordinato e senza duplicati, in un nuovo file temporaneo. */
+    private void scriviRun() throws IOException {
+        File f = nuovoRun();
+        run.add(f);
+        try (DataOutputStream out = scrittura(f)) {
+            for (int i = 0; i < dim; i++) {
+                out.writeLong(buffer[i]);
+            }
+        }
+        dim = 0;
+    }
+
+    private static File nuovoRun() throws IOException {
+        File f = File.createTempFile("creagrafo", ".run");
+        f.deleteOnExit();
+        return f;
+    }
+
+    private static DataOutputStream scrittura(File f) throws IOException {
+        return new DataOutputStream(new BufferedOutputStream(new FileOutputStream(f), DIM_SCRITTURA));
+    }
+
+    /**
+     * Da chiamare dopo l'ultimo aggiungi(). Se è già stato scritto un run, ci
+     * finisce anche il resto del buffer, che viene liberato per lasciare la
+     * memoria ai buffer di lettura della fusione.
+     */
+    void chiudiScrittura() throws IOException {
+        dim = ArrayLong.ordinaSenzaDuplicati(buffer, dim);
+        if (!run.isEmpty()) {
+            if (dim > 0) {
+                scriviRun();
+            }
+            buffer = null;
+        }
+    }
+
+    /** Scorre tutti i valori aggiunti, in ordine e senza duplicati. Dopo chiudiScrittura(). */
+    SorgenteLong scorri() throws IOException {
+        if (run.isEmpty()) {
+            return ArrayLong.scorri(buffer, dim);
+        }
+        riduciRun();
+        return new Fusione(run, dimLettura(run.size()));
+    }
+
+    /** Quanti run si possono fondere insieme restando nel budget, con il buffer di scrittura di una passata intermedia. */
+    private int maxVie() {
+        return (int) Math.max(2, Math.min(Integer.MAX_VALUE, (byteMemoria - DIM_SCRITTURA) / DIM_LETTURA_MINIMA));
+    }
+
+    /** Il buffer di lettura di ognuno dei k run di una fusione. */
+    private int dimLettura(int k) {
+        return (int) Math.max(DIM_LETTURA_MINIMA, Math.min((byteMemoria - DIM_SCRITTURA) / k, 1 << 20));
+    }
+
+    /**
+     * Fusione a più passate: finché i run sono troppi per leggerli tutti insieme
+     * nel budget, ogni gruppo di maxVie() run diventa un unico run più lungo. Il
+     * risultato resta in run, così una seconda scorri() non ripete le passate.
+     */
+    private void riduciRun() throws IOException {
+        int vie = maxVie();
+        while (run.size() > vie) {
+            ArrayList<File> fusi = new ArrayList<>();
+            for (int inizio = 0; inizio < run.size(); inizio += vie) {
+                List<File> gruppo = run.subList(inizio, Math.min(inizio + vie, run.size()));
+                if (gruppo.size() == 1) {
+                    fusi.add(gruppo.get(0));
+                    continue;
+                }
+                File f = nuovoRun();
+                fusi.add(f);
+                try (Fusione fusione = new Fusione(gruppo, dimLettura(gruppo.size()));
+                     DataOutputStream out = scrittura(f)) {
+                    while (fusione.haProssimo()) {
+                        out.writeLong(fusione.prossimo());
+                    }
+                } catch (IOException e) {
+                    for (File g : fusi) {
+                        g.delete();
+                    }
+                    throw e;
+                }
+                for (File g : gruppo) {
+                    g.delete();
+                }
+            }
+            run.clear();
+            run.addAll(fusi);
+        }
+    }
+
+    @Override
+    public void close() {
+        for (File f : run) {
+            f.delete();
+        }
+        run.clear();
+    }
+
+    /** Fusione a k vie di alcuni run: un min-heap di indici di run, ordinato per il loro valore in testa. */
+    private static class Fusione implements SorgenteLong {
+        private final DataInputStream[] ingressi;
+        private final long[] rimanenti; // Valori ancora da leggere in ogni run
+        private final long[] teste;     // Valore in testa a ogni run
+        private final int[] heap;
+        private int dimHeap;
+        private long valore, ultimo;
+        private boolean disponibile, restituito;
+
+        Fusione(List<File> run, int dimLettura) throws IOException {
+            int k = run.size();
+            ingressi = new DataInputStream[k];
+            rimanenti = new long[k];
+            teste = new long[k];
+            heap = new int[k];
+            try {
+                for (int r = 0; r < k; r++) {
+                    ingressi[r] = new DataInputStream(new BufferedInputStream(new FileInputStream(run.get(r)), dimLettura));
+                    rimanenti[r] = run.get(r).length() / 8;
+                    if (leggi(r)) {
+                        heap[dimHeap] = r;
+                        sali(dimHeap++);
+                    }
+                }
+                avanza();
+            } catch (IOException e) {
+                close();
+                throw e;
+            }
+        }
+
+        private boolean leggi(int r) throws IOException {
+            if (rimanenti[r] == 0) {
+                return false;
+            }
+            rimanenti[r]--;
+            teste[r] = ingressi[r].readLong();
+            return true;
+        }
+
+        private void sali(int i) {
+            while (i > 0 && teste[heap[(i - 1) / 2]] > teste[heap[i]]) {
+                scambia(i, (i - 1) / 2);
+                i = (i - 1) / 2;
+            }
+        }
+
+        private void scendi(int i) {
+            while (true) {
+                int minimo = i, s = 2 * i + 1, d = 2 * i + 2;
+                if (s < dimHeap && teste[heap[s]] < teste[heap[minimo]]) minimo = s;
+                if (d < dimHeap && teste[heap[d]] < teste[heap[minimo]]) minimo = d;
+                if (minimo == i) {
+                    return;
+                }
+                scambia(i, minimo);
+                i = minimo;
+            }
+        }
+
+        private void scambia(int i, int j) {
+            int t = heap[i];
+            heap[i] = heap[j];
+            heap[j] = t;
+        }
+
+        /** Prepara il prossimo valore diverso dall'ultimo restituito. */
+        private void avanza() throws IOException {
+            disponibile = false;
+            while (dimHeap > 0) {
+                int r = heap[0];
+                long v = teste[r];
+                if (!leggi(r)) {
+                    heap[0] = heap[--dimHeap];
+                }
+                scendi(0);
+                if (restituito && v == ultimo) {
+                    continue; // Lo stesso valore in più run
+                }
+                valore = v;
+                disponibile = true;
+                return;
+            }
+        }
+
+        public boolean haProssimo() {
+            return disponibile;
+        }
+
+        public long prossimo() throws IOException {
+            long v = valore;
+            ultimo = v;
+            restituito = true;
+            avanza();
+            return v;
+        }
+
+        @Override
+        public void close() throws IOException {
+            for (DataInputStream in : ingressi) {
+                if (in != null) {
+                    in.close();
+                }
+            }
+        }
+    }
+}
+
+/**
+ * File TSV letto a blocchi di byte, senza BufferedReader né String per riga.
+ * blocchi() divide il file in tratti di righe intere, che più thread possono
+ * leggere (leggi()) e analizzare in parallelo: le letture posizionali su un
+ * FileChannel non condividono lo stato e funzionano anche oltre i 2 GB.
+ */
+class FileTsv implements AutoCloseable {
+    final FileChannel canale;
+    final long dim;
+
+    FileTsv(String path) throws IOException {
+        canale = FileChannel.open(Paths.get(path), StandardOpenOption.READ);
+        dim = canale.size();
+    }
+
+    /** I byte da inizio (compreso) a fine (escluso). */
+    byte[] leggi(long inizio, long fine) throws IOException {
+        byte[] b = new byte[(int) (fine - inizio)];
+        ByteBuffer buf = ByteBuffer.wrap(b);
+        while (buf.hasRemaining()) {
+            if (canale.read(buf, inizio + buf.position()) < 0) {
+                throw new IOException("file troncato durante la lettura");
+            }
+        }
+        return b;
+    }
+
+    /** Inizio della prima riga che comincia in pos o dopo (dim se non ce ne sono). */
+    long inizioRiga(long pos) throws IOException {
+        if (pos <= 0) {
+            return 0;
+        }
+        for (long p = pos - 1; p < dim; ) {
+            byte[] b = leggi(p, Math.min(dim, p + (1 << 16)));
+            for (int i = 0; i < b.length; i++) {
+                if (b[i] == '\n') {
+                    return p + i + 1;
+                }
+            }
+            p += b.length;
+        }
+        return dim;
+    }
+
+    /**
+     * Inizio della prima riga, a partire da quella che comincia in q, con il
+     * primo campo diverso da quello della riga precedente: un confine che non
+     * divide un gruppo di righe con lo stesso primo campo (es. lo stesso tconst).
+     */
+    long fineGruppo(long q) throws IOException {
+        for (int finestra = 1 << 20; q < dim; finestra *= 2) {
+            byte[] b = leggi(q, Math.min(dim, q + finestra));
+            boolean completa = q + b.length == dim;
+            int t = 0;
+            while (t < b.length && b[t] != '\t' && b[t] != '\n') {
+                t++;
+            }
+            int r = 0;
+            while (true) {
+                while (r < b.length && b[r] != '\n') {
+                    r++;
+                }
+                if (r >= b.length || (r + 1 + t >= b.length && !completa)) {
+                    break; // Serve una finestra più grande
+                }
+                r++;
+                if (r == b.length) {
+                    return dim;
+                }
+                boolean uguale = r + t <= b.length && Arrays.equals(b, 0, t, b, r, r + t)
+                        && (r + t == b.length || b[r + t] == '\t' || b[r + t] == '\n');
+                if (!uguale) {
+                    return q + r;
+                }
+            }
+            if (completa) {
+                return dim;
+            }
+        }
+        return dim;
+    }
+
+    /**
+     * Confini dei blocchi da circa dimBlocco byte, dopo la riga di intestazione
+     * se c'è (i TSV di IMDb, non i file scritti da CreaGrafo): il blocco k va da
+     * confini[k] a confini[k+1] ed è fatto di righe intere.
+     * Con perGruppo, le righe con lo stesso primo campo restano nello stesso blocco.
+     */
+    long[] blocchi(long dimBlocco, boolean perGruppo, boolean intestazione) throws IOException {
+        ArrayList<Long> confini = new ArrayList<>();
+        long confine = intestazione ? inizioRiga(1) : 0; // Salta l'intestazione
+        while (confine < dim) {
+            confini.add(confine);
+            confine = inizioRiga(confine + dimBlocco);
+            if (perGruppo) {
+                confine = fineGruppo(confine);
+            }
+        }
+        confini.add(dim);
+        long[] risultato = new long[confini.size()];
+        for (int k = 0; k < risultato.length; k++) {
+            risultato[k] = confini.get(k);
+        }
+        return risultato;
+    }
+
+    /** Posizione del primo '\n' (o tab, con tab) in b da i a fine, o fine se non c'è. */
+    static int cerca(byte[] b, int i, int fine, boolean tab) {
+        while (i < fine && b[i] != '\n' && !(tab && b[i] == '\t')) {
+            i++;
+        }
+        return i;
+    }
+
+    @Override
+    public void close() throws IOException {
+        canale.close();
+    }
+}
+
+/**
+ * Scrittore sequenziale dello snapshot binario del grafo (grafo.bin).
+ * Scrive gli interi in little-endian, come li legge cammini.c dopo averli mappati
+ * con mmap, e calcola al volo il checksum della sezione corrente: FNV-1a applicato
+ * a parole da 64 bit, con la sezione completata da zeri fino a un multiplo di 8 byte.
+ */
+class ScrittoreSnapshot implements AutoCloseable {
+    static final long FNV_OFFSET = 0xcbf29ce484222325L;
+    static final long FNV_PRIME = 0x100000001b3L;
+
+    private final BufferedOutputStream out;
+    private long posizione;           // Byte scritti finora nel file.
+    private long checksum = FNV_OFFSET;
+    private long parola = 0;          // Parola da 64 bit in costruzione per il checksum.
+    private int byteInParola = 0;
+
+    /**
+     * Apre il file e lascia vuoti i primi dimHeader byte: l'intestazione
+     * si conosce solo alla fine e viene scritta da scriviIntestazione.
+     */
+    ScrittoreSnapshot(String path, int dimHeader) throws IOException {
+        out = new BufferedOutputStream(new FileOutputStream(path), 1 << 20);
+        out.write(new byte[dimHeader]);
+        posizione = dimHeader;
+    }
+
+    long posizione() {
+        return posizione;
+    }
+
+    /** Inizia una nuova sezione: la allinea a 8 byte e azzera il checksum. */
+    void iniziaSezione() throws IOException {
+        while (posizione % 8 != 0) {
+            out.write(0);
+            posizione++;
+        }
+        checksum = FNV_OFFSET;
+        parola = 0;
+        byteInParola = 0;
+    }
+
+    /** Chiude la sezione corrente e ne restituisce il checksum. */
+    long fineSezione() {
+        if (byteInParola > 0) {
+            checksum = (checksum ^ parola) * FNV_PRIME;
+            parola = 0;
+            byteInParola = 0;
+        }
+        return checksum;
+    }
+
+    void scriviByte(int b) throws IOException {
+        out.write(b);
+        posizione++;
+        parola |= (long) (b & 0xFF) << (8 * byteInParola);
+        if (++byteInParola == 8) {
+            checksum = (checksum ^ parola) * FNV_PRIME;
+            parola = 0;
+            byteInParola = 0;
+        }
+    }
+
+    void scriviInt(int v) throws IOException {
+        for (int i = 0; i < 4; i++) {
+            scriviByte(v >>> (8 * i));
+        }
+    }
+
+    void scriviLong(long v) throws IOException {
+        for (int i = 0; i < 8; i++) {
+            scriviByte((int) (v >>> (8 * i)));
+        }
+    }
+
+    void scriviBytes(byte[] b) throws IOException {
+        for (byte x : b) {
+            scriviByte(x);
+        }
+    }
+
+    /**
+     * Sovrascrive l'inizio del file (già chiuso) con l'intestazione, dopo averne
+     * calcolato il checksum sugli ultimi 8 byte, riservati a questo scopo.
+     */
+    static void scriviIntestazione(String path, ByteBuffer header) throws IOException {
+        long h = FNV_OFFSET;
+        for (int i = 0; i + 8 < header.capacity(); i += 8) {
+            h = (h ^ header.getLong(i)) * FNV_PRIME;
+        }
+        header.putLong(header.capacity() - 8, h);
+        try (RandomAccessFile raf = new RandomAccessFile(path, "rw")) {
+            raf.write(header.array());
+        }
+    }
+
+    @Override
+    public void close() throws IOException {
+        out.close();
+    }
+}
+
+/**
+ * Classe principale del programma.
+ * Si occupa di leggere i file TSV di IMDB, costruire il grafo degli attori,
+ * e salvare i risultati in tre file di testo: nomi.txt, grafo.txt e partecipazioni.txt,
+ * più lo snapshot binario grafo.bin che cammini.c può mappare direttamente in memoria.
+ */
+public class CreaGrafo {
+
+    /** Dimensione dell'intestazione di grafo.bin (snapshot_header_t in cammini.c). */
+    private static final int SNAPSHOT_DIM_HEADER = 136;
+    private static final int SNAPSHOT_VERSIONE = 2;
+
+    /** Dimensione indicativa dei blocchi in cui si dividono i file TSV per analizzarli in parallelo. */
+    private static final long DIM_BLOCCO_TSV = 32L << 20;
+    /** Con un budget, sotto questa dimensione si riduce il numero di blocchi in volo invece che i blocchi. */
+    private static final long DIM_BLOCCO_MINIMA = 1L << 20;
+    private static final byte[] ACTOR = "actor".getBytes(StandardCharsets.US_ASCII);
+    private static final byte[] ACTRESS = "actress".getBytes(StandardCharsets.US_ASCII);
+
+        /**
+     * Metodo principale eseguito all'avvio del programma.
+     * Gestisce dinamicamente 2 o 3 argomenti per compatibilità con lo script di test.
+     * @param args Argomenti dalla linea di comando:
+     *             - Caso 2 argomenti (test): <file_nomi.tsv> <file_titoli.tsv>
+     *             - Caso 3 argomenti (manuale): <name.basics.tsv> <title.principals.tsv> <title.basics.tsv>
+     *             - Aggiornamento: --delta <righe_di_title.principals.tsv> (vedi aggiornaConDelta)
+     */
+    public static void main(String[] args) {
+        // Aggiornamento dei file già scritti nella cartella corrente, senza ricostruirli da capo.
+        if (args.length == 2 && "--delta".equals(args[0])) {
+            aggiornaConDelta(args[1]);
+            return;
+        }
+
+        // Controllo se il numero di argomenti è valido (deve essere 2 o 3).
+        if (args.length != 2 && args.length != 3) { 
+            // Se non è né 2 né 3, allora è un errore. Mostra un messaggio di aiuto completo.
+            System.err.println("Errore: Numero di argomenti non valido.");
+            System.err.println("Uso per il TEST AUTOMATICO (2 argomenti): java CreaGrafo <file_nomi.tsv> <file_titoli.tsv>");
+            System.err.println("Uso per esecuzione MANUALE (3 argomenti): java CreaGrafo <name.basics.tsv> <title.principals.tsv> <title.basics.tsv>");
+            System.err.println("Uso per un AGGIORNAMENTO: java CreaGrafo --delta <righe_nuove_di_title.principals.tsv>");
+            System.exit(1); // Termina il programma con un codice di errore.
+        }
+
+        // Dichiarazione delle variabili per i percorsi dei file.
+        String pathNameBasics;
+        String pathTitlePrincipals;
+        
+        // Assegnazione dei percorsi dei file a variabili per maggiore leggibilità.
+        // Questa parte gestisce la logica per 2 o 3 argomenti.
+        if (args.length == 2) {
+            System.out.println("INFO: Rilevata esecuzione con 2 argomenti (modalità test).");
+            pathNameBasics = args[0];
+            pathTitlePrincipals = args[1];
+        } else { // In questo ramo, args.length è necessariamente 3.
+            System.out.println("INFO: Rilevata esecuzione con 3 argomenti (modalità manuale).");
+            pathNameBasics = args[0];
+            pathTitlePrincipals = args[1];
+            String pathTitleBasics = args[2]; // Questa variabile è usata solo in questa modalità.
+            
+            // --- PASSO 2 (opzionale): Leggere 'title.basics.tsv' ---
+            // Questo passo viene eseguito SOLO se vengono forniti 3 argomenti.
+            System.out.println("\nPASSO 2: Elaborazione di " + pathTitleBasics + "...");
+            System.out.println("-> File 'title.basics.tsv' scansionato. (Dati non memorizzati per ottimizzare la memoria).");
+        }
+        
+        /**
+         * La struttura dati centrale per memorizzare gli attori: array paralleli di
+         * codici, anni e nomi (vedi ElencoAttori). Dopo l'ordinamento per codice la
+         * posizione di un attore è il suo indice, e gli archi si raccolgono come
+         * coppie di indici impacchettate in un long, senza oggetti per arco.
+         */
+        ElencoAttori attori = new ElencoAttori();
+
+        // Memoria massima (in MB) per archi e partecipazioni, es. java -Dcreagrafo.memoria=512 CreaGrafo ...
+        // Con 0 (il default) tutto resta in memoria; altrimenti si usano file temporanei (vedi ArrayLongEsterno).
+        long memoria = Long.getLong("creagrafo.memoria", 0) << 20;
+        
+        // Registriamo il tempo di inizio per calcolare la durata totale dell'esecuzione.
+        long startTime = System.currentTimeMillis();
+
+        // --- PASSO 1: Leggere il file dei nomi (es. 'name.basics.tsv' o 'miniN.tsv') e filtrare gli attori ---
+        System.out.println("PASSO 1: Elaborazione di " + pathNameBasics + " per trovare gli attori...");
+        // Il file viene diviso in blocchi di righe intere, analizzati in parallelo
+        // direttamente sui byte; gli attori dei blocchi si riuniscono in ordine di file.
+        int numThread = Runtime.getRuntime().availableProcessors();
+        ExecutorService pool = Executors.newFixedThreadPool(numThread);
+        // Con un budget, anche i blocchi in lettura devono restarci: ognuno pesa qualche volta la sua
+        // dimensione, con i buffer di coppie dimensionati sul blocco (partecipazioniDelBlocco), e tutti
+        // quelli in volo insieme restano entro 1/16 del budget. Con un budget piccolo si riducono prima
+        // i blocchi in volo, fino a uno, e poi la dimensione dei blocchi.
+        int inVolo = numThread + 1;
+        long dimBlocco = DIM_BLOCCO_TSV;
+        if (memoria > 0) {
+            inVolo = (int) Math.max(1, Math.min(numThread + 1, memoria / (16 * DIM_BLOCCO_MINIMA)));
+            dimBlocco = Math.min(DIM_BLOCCO_TSV, memoria / (16L * inVolo));
+        }
+        try (FileTsv file = new FileTsv(pathNameBasics)) {
+            long inizioLettura = System.nanoTime();
+            long[] confini = file.blocchi(dimBlocco, false, true);
+            perBlocchi(pool, confini, inVolo,
+                    (inizio, fine) -> attoriDelBlocco(file.leggi(inizio, fine)),
+                    parte -> attori.aggiungiTutti(parte));
+            stampaVelocita(file.dim, inizioLettura, Math.min(numThread, inVolo));
+        } catch (IOException e) {
+            System.err.println("Errore critico durante la lettura di " + pathNameBasics + ": " + e.getMessage());
+            e.printStackTrace();
+            System.exit(1);
+        }
+        attori.ordina();
+        int n = attori.n;
+        System.out.println("-> Trovati " + n + " attori che soddisfano i criteri.");
+
+
+        // --- PASSO 3: Scrivere 'nomi.txt' con l'elenco ordinato degli attori ---
+        System.out.println("\nPASSO 3: Scrittura del file nomi.txt...");
+        // Gli attori sono già in ordine di codice.
+
+        // Usiamo PrintWriter e BufferedWriter per una scrittura efficiente su file.
+        // Come gli altri file, nomi.txt si scrive in un temporaneo e lo sostituisce solo completo.
+        try {
+            try (PrintWriter pw = new PrintWriter(new BufferedWriter(new FileWriter("nomi.txt.tmp"), 1 << 16))) {
+                for (int i = 0; i < n; i++) {
+                    pw.println(attori.codici[i] + "\t" + attori.nomi[i] + "\t" + attori.anni[i]);
+                }
+                if (pw.checkError()) {
+                    throw new IOException("scrittura di nomi.txt.tmp non riuscita");
+                }
+            }
+            sostituisci("nomi.txt.tmp", "nomi.txt");
+        } catch (IOException e) {
+            System.err.println("Errore critico durante la scrittura di nomi.txt: " + e.getMessage());
+            e.printStackTrace();
+            System.exit(1);
+        }
+        System.out.println("-> File nomi.txt scritto correttamente con " + n + " righe.");
+
+
+        // --- PASSO 4: Leggere il file dei titoli (es. 'title.principals.tsv') per costruire il grafo e le partecipazioni ---
+        System.out.println("\nPASSO 4: Elaborazione di " + pathTitlePrincipals + " per costruire il grafo...");
+        // In memoria, ogni arco una volta sola, come (indice minore, indice maggiore).
+        // Con un budget restano vuoti: non vi si aggiunge nulla e non devono pesarvi.
+        final ArrayLong coppie = new ArrayLong(memoria > 0 ? 0 : 1 << 20);
+        // Ogni partecipazione come (indice dell'attore, codice del titolo).
+        final ArrayLong partecipazioni = new ArrayLong(memoria > 0 ? 0 : 1 << 20);
+        // Con un budget, le stesse coppie in buffer fissi e file temporanei; gli archi
+        // in entrambe le direzioni, così la fusione dà direttamente le righe di grafo.txt.
+        ArrayLongEsterno coppieEsterne = null, partecipazioniEsterne = null;
+        if (memoria > 0) {
+            coppieEsterne = new ArrayLongEsterno(memoria * 3 / 8);
+            partecipazioniEsterne = new ArrayLongEsterno(memoria / 8);
+        }
+        final ArrayLongEsterno ce = coppieEsterne, pe = partecipazioniEsterne;
+        // I blocchi non dividono mai le righe di uno stesso titolo, quindi ogni
+        // blocco ricostruisce da solo i cast completi dei suoi titoli.
+        try (FileTsv file = new FileTsv(pathTitlePrincipals)) {
+            long inizioLettura = System.nanoTime();
+            long[] confini = file.blocchi(dimBlocco, true, true);
+            perBlocchi(pool, confini, inVolo,
+                    (inizio, fine) -> partecipazioniDelBlocco(file.leggi(inizio, fine), attori),
+                    parte -> {
+                        if (ce == null) {
+                            coppie.aggiungiTutti(parte[0]);
+                            partecipazioni.aggiungiTutti(parte[1]);
+                            return;
+                        }
+                        for (int k = 0; k < parte[0].dim; k++) {
+                            long v = parte[0].dati[k];
+                            ce.aggiungi(v);
+                            ce.aggiungi(ArrayLong.coppia(ArrayLong.basso(v), ArrayLong.alto(v)));
+                        }
+                        for (int k = 0; k < parte[1].dim; k++) {
+                            pe.aggiungi(parte[1].dati[k]);
+                        }
+                    });
+            stampaVelocita(file.dim, inizioLettura, Math.min(numThread, inVolo));
+            if (ce != null) {
+                ce.chiudiScrittura();
+                pe.chiudiScrittura();
+                System.out.println("-> File temporanei: " + ce.numRun() + " per gli archi, " + pe.numRun() + " per le partecipazioni.");
+            }
+        } catch (IOException e) {
+            System.err.println("Errore critico durante la lettura di " + pathTitlePrincipals + ": " + e.getMessage());
+            e.printStackTrace();
+            System.exit(1);
+        } finally {
+            pool.shutdown();
+        }
+        coppie.compatta();
+        partecipazioni.compatta();
+        System.out.println("-> Relazioni del grafo e partecipazioni costruite con successo.");
+
+        scriviRisultati(attori, coppie, partecipazioni, ce, pe);
+
+        // Calcolo e stampa del tempo totale di esecuzione.
+        long endTime = System.currentTimeMillis();
+        System.out.println("\nEsecuzione completata in " + (endTime - startTime) / 1000.0 + " secondi.");
+    }
+
+    /**
+     * PASSI 5-7: scrive grafo.txt, partecipazioni.txt e grafo.bin. Archi e
+     * partecipazioni sono in coppie e partecipazioni (già compattati), oppure,
+     * se ce e pe non sono null, nei loro file temporanei.
+     */
+    private static void scriviRisultati(ElencoAttori attori, ArrayLong coppie, ArrayLong partecipazioni,
+                                        ArrayLongEsterno ce, ArrayLongEsterno pe) {
+        int n = attori.n;
+        long[] offsets = null;
+        int[] vicini = null;
+        if (ce == null) {
+            // Formato CSR, come in cammini.c: i coprotagonisti dell'attore i sono
+            // vicini[offsets[i]] .. vicini[offsets[i+1]-1]. Le coppie sono in ordine
+            // (a, b) con a < b, quindi ogni riga riceve prima i vicini minori di i e
+            // poi quelli maggiori, entrambi in ordine: le righe nascono già ordinate.
+            offsets = new long[n + 1];
+            for (int k = 0; k < coppie.dim; k++) {
+                offsets[ArrayLong.alto(coppie.dati[k]) + 1]++;
+                offsets[ArrayLong.basso(coppie.dati[k]) + 1]++;
+            }
+            for (int i = 0; i < n; i++) {
+                offsets[i + 1] += offsets[i];
+            }
+            if (offsets[n] > Integer.MAX_VALUE - 8) {
+                System.err.println("Errore critico: troppi archi (" + offsets[n] / 2 + ") per un array di vicini; usare -Dcreagrafo.memoria.");
+                System.exit(1);
+            }
+            vicini = new int[(int) offsets[n]];
+            long[] scrittura = Arrays.copyOf(offsets, n);
+            for (int k = 0; k < coppie.dim; k++) {
+                int a = ArrayLong.alto(coppie.dati[k]), b = ArrayLong.basso(coppie.dati[k]);
+                vicini[(int) scrittura[a]++] = b;
+                vicini[(int) scrittura[b]++] = a;
+            }
+            coppie.libera();
+            scrittura = null;
+        }
+
+
+        // --- PASSO 5: Scrivere 'grafo.txt' ---
+        System.out.println("\nPASSO 5: Scrittura del file grafo.txt...");
+        // Le righe sono in ordine di codice, e i coprotagonisti di ogni riga
+        // sono ordinati per indice, cioè per codice.
+        try (SorgenteLong archi = ce == null ? archiCsr(offsets, vicini) : ce.scorri()) {
+            offsets = scriviRighe("grafo.txt", attori, archi, true);
+        } catch (IOException e) {
+            System.err.println("Errore critico durante la scrittura di grafo.txt: " + e.getMessage());
+            e.printStackTrace();
+            System.exit(1);
+        }
+        System.out.println("-> File grafo.txt scritto correttamente.");
+        // In un grafo non orientato, il numero di archi è la somma dei gradi diviso 2.
+        System.out.println("-> Numero di archi unici nel grafo: " + offsets[n] / 2);
+
+
+        // --- PASSO 6: Scrivere 'partecipazioni.txt' ---
+        System.out.println("\nPASSO 6: Scrittura del file partecipazioni.txt...");
+        try (SorgenteLong righe = pe == null ? partecipazioni.scorri() : pe.scorri()) {
+            scriviRighe("partecipazioni.txt", attori, righe, false);
+        } catch (IOException e) {
+            System.err.println("Errore critico durante la scrittura di partecipazioni.txt: " + e.getMessage());
+            e.printStackTrace();
+            System.exit(1);
+        }
+        partecipazioni.libera();
+        if (pe != null) {
+            pe.close();
+        }
+        System.out.println("-> File partecipazioni.txt scritto correttamente.");
+
+
+        // --- PASSO 7: Scrivere lo snapshot binario 'grafo.bin' ---
+        System.out.println("\nPASSO 7: Scrittura dello snapshot binario grafo.bin...");
+        // Fuori memoria i vicini si rileggono con una seconda fusione dei run.
+        try (SorgenteLong archi = ce == null ? archiCsr(offsets, vicini) : ce.scorri()) {
+            scriviSnapshot("grafo.bin", attori, offsets, archi);
+        } catch (IOException e) {
+            System.err.println("Errore critico durante la scrittura di grafo.bin: " + e.getMessage());
+            e.printStackTrace();
+            System.exit(1);
+        }
+        if (ce != null) {
+            ce.close();
+        }
+        System.out.println("-> File grafo.bin scritto correttamente.");
+    }
+
+    /**
+     * Modalità --delta: aggiorna grafo.txt, partecipazioni.txt e grafo.bin della
+     * cartella corrente con un estratto di title.principals.tsv (stessa
+     * intestazione, stesso formato, righe raggruppate per titolo), senza
+     * rileggere i TSV completi. Le righe di un titolo nell'estratto sostituiscono
+     * tutte quelle che il titolo aveva: i titoli nuovi si aggiungono, quelli
+     * cambiati si ricostruiscono. nomi.txt non cambia, perché cambiano solo i cast.
+     *
+     * Un attore è "toccato" se è nel cast vecchio o nuovo di un titolo
+     * dell'estratto. Gli archi tra attori non toccati restano quelli di
+     * grafo.txt; quelli di un attore toccato si ricalcolano dai cast di tutti i
+     * suoi titoli, ricavati da partecipazioni.txt.
+     *
+     * Tutto resta in memoria, anche con -Dcreagrafo.memoria: partecipazioni e
+     * archi si cercano per titolo e per attore, non solo in ordine come nella
+     * fusione di ArrayLongEsterno.
+     */
+    private static void aggiornaConDelta(String pathDelta) {
+        long startTime = System.currentTimeMillis();
+        if (Long.getLong("creagrafo.memoria", 0) > 0) {
+            System.err.println("ATTENZIONE: --delta ignora -Dcreagrafo.memoria e tiene archi e partecipazioni in memoria;"
+                    + " se non bastano, ricostruire il grafo da capo con i TSV aggiornati.");
+        }
+        int numThread = Runtime.getRuntime().availableProcessors();
+        ExecutorService pool = Executors.newFixedThreadPool(numThread);
+        ElencoAttori attori = new ElencoAttori();
+        ArrayLong titoliDelta = new ArrayLong(1 << 10);
+        ArrayLong partecipazioniDelta = new ArrayLong(1 << 10);
+        ArrayLong vecchiePartecipazioni = new ArrayLong(1 << 20);
+        ArrayLong coppie = new ArrayLong(1 << 20);
+        ArrayLong partecipazioni = null;
+        try {
+            // --- PASSO 1: Leggere gli attori da 'nomi.txt' ---
+            System.out.println("PASSO 1: Lettura di nomi.txt...");
+            try (FileTsv file = new FileTsv("nomi.txt")) {
+                perBlocchi(pool, file.blocchi(DIM_BLOCCO_TSV, false, false), numThread + 1,
+                        (inizio, fine) -> nomiDelBlocco(file.leggi(inizio, fine)),
+                        parte -> attori.aggiungiTutti(parte));
+            }
+            attori.ordina();
+            int n = attori.n;
+            System.out.println("-> " + n + " attori.");
+
+            // --- PASSO 2: Leggere l'estratto di 'title.principals.tsv' ---
+            System.out.println("\nPASSO 2: Lettura dell'estratto " + pathDelta + "...");
+            try (FileTsv file = new FileTsv(pathDelta)) {
+                perBlocchi(pool, file.blocchi(DIM_BLOCCO_TSV, true, true), numThread + 1,
+                        (inizio, fine) -> deltaDelBlocco(file.leggi(inizio, fine), attori),
+                        parte -> {
+                            titoliDelta.aggiungiTutti(parte[0]);
+                            partecipazioniDelta.aggiungiTutti(parte[1]);
+                        });
+            }
+            titoliDelta.compatta();
+            partecipazioniDelta.compatta();
+            int[] titoli = new int[titoliDelta.dim];
+            for (int k = 0; k < titoli.length; k++) {
+                titoli[k] = (int) titoliDelta.dati[k];
+            }
+            System.out.println("-> " + titoli.length + " titoli da aggiornare, con " + partecipazioniDelta.dim + " partecipazioni di attori.");
+
+            // --- PASSO 3: Leggere 'partecipazioni.txt' e sostituire i cast dei titoli dell'estratto ---
+            System.out.println("\nPASSO 3: Lettura di partecipazioni.txt...");
+            try (FileTsv file = new FileTsv("partecipazioni.txt")) {
+                perBlocchi(pool, file.blocchi(DIM_BLOCCO_TSV, false, false), numThread + 1,
+                        (inizio, fine) -> righeDelBlocco(file.leggi(inizio, fine), attori, false, null),
+                        parte -> vecchiePartecipazioni.aggiungiTutti(parte));
+            }
+            vecchiePartecipazioni.compatta();
+            boolean[] toccato = new boolean[n];
+            partecipazioni = new ArrayLong(vecchiePartecipazioni.dim + partecipazioniDelta.dim + 1);
+            for (int k = 0; k < vecchiePartecipazioni.dim; k++) {
+                long v = vecchiePartecipazioni.dati[k];
+                if (Arrays.binarySearch(titoli, ArrayLong.basso(v)) >= 0) {
+                    toccato[ArrayLong.alto(v)] = true; // Nel cast vecchio di un titolo dell'estratto
+                } else {
+                    partecipazioni.aggiungi(v);
+                }
+            }
+            for (int k = 0; k < partecipazioniDelta.dim; k++) {
+                long v = partecipazioniDelta.dati[k];
+                toccato[ArrayLong.alto(v)] = true;
+                partecipazioni.aggiungi(v);
+            }
+            vecchiePartecipazioni.libera();
+            partecipazioni.compatta();
+            int numToccati = 0;
+            for (int i = 0; i < n; i++) {
+                numToccati += toccato[i] ? 1 : 0;
+            }
+            System.out.println("-> " + numToccati + " attori toccati dall'estratto.");
+
+            // --- PASSO 4: Leggere 'grafo.txt' e ricalcolare gli archi degli attori toccati ---
+            System.out.println("\nPASSO 4: Lettura di grafo.txt...");
+            try (FileTsv file = new FileTsv("grafo.txt")) {
+                perBlocchi(pool, file.blocchi(DIM_BLOCCO_TSV, false, false), numThread + 1,
+                        (inizio, fine) -> righeDelBlocco(file.leggi(inizio, fine), attori, true, toccato),
+                        parte -> coppie.aggiungiTutti(parte));
+            }
+            // I cast (titolo, indice) dei titoli in cui compare almeno un attore toccato
+            ArrayLong titoliToccati = new ArrayLong(1 << 10);
+            for (int k = 0; k < partecipazioni.dim; k++) {
+                if (toccato[ArrayLong.alto(partecipazioni.dati[k])]) {
+                    titoliToccati.aggiungi(ArrayLong.basso(partecipazioni.dati[k]));
+                }
+            }
+            titoliToccati.compatta();
+            ArrayLong cast = new ArrayLong(1 << 10);
+            for (int k = 0; k < partecipazioni.dim; k++) {
+                long v = partecipazioni.dati[k];
+                if (Arrays.binarySearch(titoliToccati.dati, 0, titoliToccati.dim, ArrayLong.basso(v)) >= 0) {
+                    cast.aggiungi(ArrayLong.coppia(ArrayLong.basso(v), ArrayLong.alto(v)));
+                }
+            }
+            titoliToccati.libera();
+            cast.compatta();
+            // Ogni cast, già senza ripetizioni, passa da processCast come nella costruzione completa
+            int[] membri = new int[16];
+            for (int k = 0; k < cast.dim; ) {
+                int titolo = ArrayLong.alto(cast.dati[k]), dimCast = 0;
+                for (; k < cast.dim && ArrayLong.alto(cast.dati[k]) == titolo; k++) {
+                    if (dimCast == membri.length) {
+                        membri = Arrays.copyOf(membri, dimCast * 2);
+                    }
+                    membri[dimCast++] = ArrayLong.basso(cast.dati[k]);
+                }
+                processCast(membri, dimCast, coppie);
+            }
+            cast.libera();
+            coppie.compatta();
+            System.out.println("-> Relazioni del grafo e partecipazioni aggiornate con successo.");
+        } catch (IOException e) {
+            System.err.println("Errore critico durante l'aggiornamento con " + pathDelta + ": " + e.getMessage());
+            e.printStackTrace();
+            System.exit(1);
+        } finally {
+            pool.shutdown();
+        }
+
+        scriviRisultati(attori, coppie, partecipazioni, null, null);
+
+        long endTime = System.currentTimeMillis();
+        System.out.println("\nAggiornamento completato in " + (endTime - startTime) / 1000.0 + " secondi.");
+    }
+
+    /** Analizza un blocco di righe di nomi.txt (<codice>\t<nome>\t<anno>), nell'ordine del file. */
+    private static ElencoAttori nomiDelBlocco(byte[] b) {
+        ElencoAttori parte = new ElencoAttori();
+        for (int i = 0; i < b.length; ) {
+            int fineRiga = FileTsv.cerca(b, i, b.length, false);
+            int riga = i;
+            i = fineRiga + 1;
+            int tab1 = FileTsv.cerca(b, riga, fineRiga, true);
+            if (tab1 == fineRiga) continue;
+            int tab2 = FileTsv.cerca(b, tab1 + 1, fineRiga, true);
+            if (tab2 == fineRiga) continue;
+            long codice = intero(b, riga, tab1), anno = intero(b, tab2 + 1, fineRiga);
+            if (codice < 0 || anno == Long.MIN_VALUE) continue;
+            parte.aggiungi((int) codice, new String(b, tab1 + 1, tab2 - tab1 - 1, StandardCharsets.UTF_8), (int) anno);
+        }
+        return parte;
+    }
+
+    /**
+     * Analizza un blocco dell'estratto di title.principals.tsv. Restituisce tutti
+     * i titoli del blocco, anche quelli senza attori (il loro cast nuovo è vuoto),
+     * e le partecipazioni (indice dell'attore, codice del titolo) degli attori.
+     */
+    private static ArrayLong[] deltaDelBlocco(byte[] b, ElencoAttori attori) {
+        ArrayLong titoli = new ArrayLong(1 << 10);
+        ArrayLong partecipazioni = new ArrayLong(1 << 10);
+        for (int i = 0; i < b.length; ) {
+            int fineRiga = FileTsv.cerca(b, i, b.length, false);
+            int riga = i;
+            i = fineRiga + 1;
+            int tab1 = FileTsv.cerca(b, riga, fineRiga, true);
+            if (tab1 == fineRiga) continue;
+            int tab2 = FileTsv.cerca(b, tab1 + 1, fineRiga, true);
+            if (tab2 == fineRiga) continue;
+            int tab3 = FileTsv.cerca(b, tab2 + 1, fineRiga, true);
+            int codiceTitolo = codice(b, riga, tab1);
+            if (codiceTitolo < 0) continue;
+            titoli.aggiungi(codiceTitolo);
+            int codiceAttore = codice(b, tab2 + 1, tab3);
+            int indice = codiceAttore < 0 ? -1 : attori.indice(codiceAttore);
+            if (indice >= 0) {
+                partecipazioni.aggiungi(ArrayLong.coppia(indice, codiceTitolo));
+            }
+        }
+        titoli.compatta();
+        partecipazioni.compatta();
+        return new ArrayLong[] { titoli, partecipazioni };
+    }
+
+    /**
+     * Analizza un blocco di righe scritte da scriviRighe e restituisce le coppie
+     * (indice dell'attore, valore). Con comeCodici (grafo.txt) i valori sono
+     * codici di coprotagonisti, tradotti in indici: ogni arco si tiene una volta
+     * sola, come (indice minore, indice maggiore), e solo se nessuno dei due
+     * attori è toccato.
+     */
+    private static ArrayLong righeDelBlocco(byte[] b, ElencoAttori attori, boolean comeCodici, boolean[] toccato) {
+        ArrayLong coppie = new ArrayLong(1 << 16);
+        for (int i = 0; i < b.length; ) {
+            int fineRiga = FileTsv.cerca(b, i, b.length, false);
+            int riga = i;
+            i = fineRiga + 1;
+            int tab = FileTsv.cerca(b, riga, fineRiga, true);
+            long codice = intero(b, riga, tab);
+            int a = codice < 0 ? -1 : attori.indice((int) codice);
+            if (a < 0 || (comeCodici && toccato[a])) continue;
+            // Il secondo campo è il numero di valori, che seguono tutti nella riga
+            int j = FileTsv.cerca(b, tab + 1, fineRiga, true);
+            while (j < fineRiga) {
+                int fineValore = FileTsv.cerca(b, j + 1, fineRiga, true);
+                long valore = intero(b, j + 1, fineValore);
+                j = fineValore;
+                if (valore < 0) continue;
+                if (!comeCodici) {
+                    coppie.aggiungi(ArrayLong.coppia(a, (int) valore));
+                    continue;
+                }
+                int v = attori.indice((int) valore);
+                if (v > a && !toccato[v]) {
+                    coppie.aggiungi(ArrayLong.coppia(a, v));
+                }
+            }
+        }
+        coppie.compatta();
+        return coppie;
+    }
+
+    /** Analisi di un blocco di un file TSV, da inizio (compreso) a fine (escluso). */
+    interface CompitoBlocco<T> {
+        T esegui(long inizio, long fine) throws IOException;
+    }
+
+    /** Raccoglie il risultato di un blocco, nel thread principale. */
+    interface Raccoglitore<T> {
+        void accetta(T parte) throws IOException;
+    }
+
+    /**
+     * Esegue il compito su ogni blocco nel pool e passa i risultati a raccogli
+     * nell'ordine dei blocchi, cioè del file. I blocchi inviati e non ancora
+     * raccolti sono al più inVolo, così la memoria non dipende dalla dimensione del file.
+     */
+    private static <T> void perBlocchi(ExecutorService pool, long[] confini, int inVolo,
+                                       CompitoBlocco<T> compito, Raccoglitore<T> raccogli) throws IOException {
+        ArrayDeque<Future<T>> inCorso = new ArrayDeque<>();
+        int prossimo = 0, numBlocchi = confini.length - 1;
+        while (prossimo < numBlocchi || !inCorso.isEmpty()) {
+            while (prossimo < numBlocchi && inCorso.size() < inVolo) {
+                long inizio = confini[prossimo], fine = confini[prossimo + 1];
+                Callable<T> c = () -> compito.esegui(inizio, fine);
+                inCorso.add(pool.submit(c));
+                prossimo++;
+            }
+            raccogli.accetta(attendi(inCorso.poll()));
+        }
+    }
+
+    /**
+     * Scrive un file di righe "<codice>\t<numero>\t<valore_1>...", una per attore
+     * in ordine di indice (anche senza valori), dalle coppie (indice dell'attore,
+     * valore) in ordine crescente. In grafo.txt i valori sono indici di
+     * coprotagonisti, scritti come codici (comeCodici); in partecipazioni.txt
+     * sono già i codici dei titoli.
+     * @return I confini delle righe, come gli offsets di cammini.c.
+     */
+    private static long[] scriviRighe(String path, ElencoAttori attori, SorgenteLong coppie, boolean comeCodici) throws IOException {
+        int n = attori.n;
+        long[] offsets = new long[n + 1];
+        int[] riga = new int[16];
+        boolean haCoppia = coppie.haProssimo();
+        long coppia = haCoppia ? coppie.prossimo() : 0;
+        try (PrintWriter pw = new PrintWriter(new BufferedWriter(new FileWriter(path + ".tmp"), 1 << 16))) {
+            for (int i = 0; i < n; i++) {
+                // Il numero di valori precede i valori: la riga si raccoglie prima di scriverla.
+                int dimRiga = 0;
+                while (haCoppia && ArrayLong.alto(coppia) == i) {
+                    if (dimRiga == riga.length) {
+                        riga = Arrays.copyOf(riga, dimRiga * 2);
+                    }
+                    riga[dimRiga++] = ArrayLong.basso(coppia);
+                    haCoppia = coppie.haProssimo();
+                    if (haCoppia) {
+                        coppia = coppie.prossimo();
+                    }
+                }
+                offsets[i + 1] = offsets[i] + dimRiga;
+
+                pw.print(attori.codici[i]);
+                pw.print("\t");
+                pw.print(dimRiga);
+                for (int k = 0; k < dimRiga; k++) {
+                    pw.print("\t");
+                    pw.print(comeCodici ? attori.codici[riga[k]] : riga[k]);
+                }
+                pw.println();
+            }
+        }
+        sostituisci(path + ".tmp", path);
+        return offsets;
+    }
+
+    /**
+     * Sostituisce path con il file completo temporaneo, con una rename atomica:
+     * chi apre path (o un cammini che lo ricarica) vede il file vecchio o quello
+     * nuovo, mai uno a metà, e chi ha già mappato il vecchio grafo.bin lo conserva intatto.
+     */
+    private static void sostituisci(String temporaneo, String path) throws IOException {
+        Files.move(Paths.get(temporaneo), Paths.get(path), StandardCopyOption.REPLACE_EXISTING, StandardCopyOption.ATOMIC_MOVE);
+    }
+
+    /** Gli archi del formato CSR come coppie (indice dell'attore, indice del coprotagonista), riga dopo riga. */
+    private static SorgenteLong archiCsr(long[] offsets, int[] vicini) {
+        return new SorgenteLong() {
+            private int i;
+            private long k;
+
+            public boolean haProssimo() {
+                return k < vicini.length;
+            }
+
+            public long prossimo() {
+                while (offsets[i + 1] <= k) {
+                    i++;
+                }
+                return ArrayLong.coppia(i, vicini[(int) k++]);
+            }
+        };
+    }
+
+    /**
+     * Analizza un blocco di righe di name.basics.tsv e restituisce, nell'ordine
+     * del file, gli attori che soddisfano i criteri. Dai byte si crea una String
+     * solo per il nome di chi viene tenuto.
+     */
+    private static ElencoAttori attoriDelBlocco(byte[] b) {
+        ElencoAttori parte = new ElencoAttori();
+        // Fine (esclusa) dei campi nconst, primaryName, birthYear, deathYear, primaryProfession
+        int[] fineCampo = new int[5];
+        for (int i = 0; i < b.length; ) {
+            int fineRiga = FileTsv.cerca(b, i, b.length, false);
+            int numCampi = 0;
+            for (int j = i; numCampi < 5 && j <= fineRiga; j++) {
+                j = FileTsv.cerca(b, j, fineRiga, true);
+                fineCampo[numCampi++] = j;
+            }
+            int riga = i;
+            i = fineRiga + 1;
+            if (numCampi < 5) continue; // Salta righe malformate.
+
+            // Applichiamo i filtri richiesti dalle specifiche:
+            // 1. L'anno di nascita non deve essere "\\N".
+            int inizioAnno = fineCampo[1] + 1;
+            if (fineCampo[2] - inizioAnno == 2 && b[inizioAnno] == '\\' && b[inizioAnno + 1] == 'N') {
+                continue;
+            }
+            // 2. La professione deve contenere "actor" o "actress".
+            int inizioProfessione = fineCampo[3] + 1;
+            if (!contiene(b, inizioProfessione, fineCampo[4], ACTOR) && !contiene(b, inizioProfessione, fineCampo[4], ACTRESS)) {
+                continue;
+            }
+
+            // Conversione dei dati nei tipi corretti; le righe con numeri non validi si ignorano.
+            int codice = codice(b, riga, fineCampo[0]); // Salta "nm" e converte in intero.
+            long anno = intero(b, inizioAnno, fineCampo[2]);
+            if (codice < 0 || anno == Long.MIN_VALUE) {
+                continue;
+            }
+            String nome = new String(b, fineCampo[0] + 1, fineCampo[1] - fineCampo[0] - 1, StandardCharsets.UTF_8);
+            parte.aggiungi(codice, nome, (int) anno);
+        }
+        return parte;
+    }
+
+    /**
+     * Analizza un blocco di righe di title.principals.tsv, che contiene tutte le
+     * righe dei suoi titoli. Restituisce le coppie di coprotagonisti e le
+     * partecipazioni del blocco, già ordinate e senza duplicati.
+     */
+    private static ArrayLong[] partecipazioniDelBlocco(byte[] b, ElencoAttori attori) {
+        // Dimensionati sul blocco, e quindi sul budget (vedi dimBlocco): una riga
+        // ha almeno una trentina di byte e dà al più una partecipazione.
+        int capacita = Math.max(16, b.length / 32);
+        ArrayLong coppie = new ArrayLong(capacita);
+        ArrayLong partecipazioni = new ArrayLong(capacita);
+
+        // Questa è la logica di "streaming" per elaborare i cast per ogni titolo.
+        // Il file `title.principals.tsv` è raggruppato per `tconst`. Sfruttiamo questo.
+        int titoloCorrente = -1;   // Codice del titolo che stiamo attualmente processando
+        int[] cast = new int[16];  // Indici degli attori del cast del titolo corrente, senza ripetizioni
+        int dimCast = 0;
+
+        for (int i = 0; i < b.length; ) {
+            int fineRiga = FileTsv.cerca(b, i, b.length, false);
+            int riga = i;
+            i = fineRiga + 1;
+
+            // Servono solo i campi 0 (tconst) e 2 (nconst).
+            int tab1 = FileTsv.cerca(b, riga, fineRiga, true);
+            if (tab1 == fineRiga) continue;
+            int tab2 = FileTsv.cerca(b, tab1 + 1, fineRiga, true);
+            if (tab2 == fineRiga) continue;
+            int tab3 = FileTsv.cerca(b, tab2 + 1, fineRiga, true);
+
+            int codiceAttore = codice(b, tab2 + 1, tab3); // es. "nm0000123"
+            // Processiamo la riga SOLO se l'attore è tra quelli filtrati.
+            int indice = codiceAttore < 0 ? -1 : attori.indice(codiceAttore);
+            if (indice < 0) continue;
+            int codiceTitolo = codice(b, riga, tab1); // es. "tt0000001"
+            if (codiceTitolo < 0) continue;
+
+            // Aggiungiamo il titolo alle partecipazioni dell'attore.
+            partecipazioni.aggiungi(ArrayLong.coppia(indice, codiceTitolo));
+
+            // Se il titolo è cambiato, abbiamo finito di leggere il cast del titolo precedente.
+            if (codiceTitolo != titoloCorrente) {
+                processCast(cast, dimCast, coppie);
+                titoloCorrente = codiceTitolo;
+                dimCast = 0;
+            }
+            // Aggiungiamo l'attore al cast del titolo attuale, se non c'è già.
+            boolean presente = false;
+            for (int k = 0; k < dimCast && !presente; k++) {
+                presente = cast[k] == indice;
+            }
+            if (!presente) {
+                if (dimCast == cast.length) {
+                    cast = Arrays.copyOf(cast, dimCast * 2);
+                }
+                cast[dimCast++] = indice;
+            }
+        }
+        // Alla fine del blocco, dobbiamo processare l'ultimo cast rimasto in memoria.
+        processCast(cast, dimCast, coppie);
+        coppie.compatta();
+        partecipazioni.compatta();
+        return new ArrayLong[] { coppie, partecipazioni };
+    }
+
+    /** Risultato di un compito del pool, con l'eccezione del compito rilanciata così com'è. */
+    private static <T> T attendi(Future<T> parte) throws IOException {
+        try {
+            return parte.get();
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+            throw new IOException("lettura interrotta", e);
+        } catch (ExecutionException e) {
+            Throwable causa = e.getCause();
+            if (causa instanceof IOException) {
+                throw (IOException) causa;
+            }
+            if (causa instanceof RuntimeException) {
+                throw (RuntimeException) causa;
+            }
+            if (causa instanceof Error) {
+                throw (Error) causa;
+            }
+            throw new IOException(causa);
+        }
+    }
+
+    /** Stampa la velocità di lettura di un file, in totale e per core. */
+    private static void stampaVelocita(long byteLetti, long inizioNs, int numThread) {
+        double secondi = Math.max(System.nanoTime() - inizioNs, 1) / 1e9;
+        double mb = byteLetti / (1024.0 * 1024.0);
+        System.out.printf("-> Letti %.1f MB in %.2f s con %d thread: %.1f MB/s, %.1f MB/s per core.%n",
+                mb, secondi, numThread, mb / secondi, mb / secondi / numThread);
+    }
+
+    /** true se i byte di b da inizio a fine contengono la sequenza cercata. */
+    private static boolean contiene(byte[] b, int inizio, int fine, byte[] cercata) {
+        for (int i = inizio; i + cercata.length <= fine; i++) {
+            if (Arrays.equals(b, i, i + cercata.length, cercata, 0, cercata.length)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Codice numerico di un campo come "nm0000123" o "tt0000001", tra le posizioni
+     * inizio (compresa) e fine (esclusa) di b: si saltano i due caratteri del
+     * prefisso e il resto deve essere composto di sole cifre.
+     * @return Il codice, o -1 se il campo è malformato o fuori dal range di un int.
+     */
+    static int codice(byte[] b, int inizio, int fine) {
+        if (fine - inizio <= 2) {
+            return -1;
+        }
+        long valore = 0;
+        for (int i = inizio + 2; i < fine; i++) {
+            int cifra = b[i] - '0';
+            if (cifra < 0 || cifra > 9) {
+                return -1;
+            }
+            valore = valore * 10 + cifra;
+            if (valore > Integer.MAX_VALUE) {
+                return -1;
+            }
+        }
+        return (int) valore;
+    }
+
+    /**
+     * Intero decimale tra inizio e fine, con un segno opzionale come per Integer.parseInt.
+     * @return Il valore, o Long.MIN_VALUE se il campo non è un int valido.
+     */
+    static long intero(byte[] b, int inizio, int fine) {
+        boolean negativo = inizio < fine && b[inizio] == '-';
+        if (inizio < fine && (b[inizio] == '-' || b[inizio] == '+')) {
+            inizio++;
+        }
+        if (inizio >= fine) {
+            return Long.MIN_VALUE;
+        }
+        long valore = 0;
+        for (int i = inizio; i < fine; i++) {
+            int cifra = b[i] - '0';
+            if (cifra < 0 || cifra > 9) {
+                return Long.MIN_VALUE;
+            }
+            valore = valore * 10 + cifra;
+            if (valore > (long) Integer.MAX_VALUE + 1) {
+                return Long.MIN_VALUE;
+            }
+        }
+        valore = negativo ? -valore : valore;
+        return valore < Integer.MIN_VALUE || valore > Integer.MAX_VALUE ? Long.MIN_VALUE : valore;
+    }
+
+    /**
+     * Scrive lo snapshot binario del grafo, letto da cammini.c con l'opzione -s.
+     * Gli attori sono numerati da 0 a N-1 nell'ordine di codice (lo stesso di nomi.txt)
+     * e i coprotagonisti sono scritti direttamente come questi indici, ordinati.
+     * Le sezioni, ognuna allineata a 8 byte e con il proprio checksum, sono:
+     * attori (codice, anno, posizione del nome), offsets (N+1 long), vicini (int),
+     * nomi (UTF-8 terminati da 0) e componenti (int): la componente connessa di ogni
+     * attore, numerate da 0 nell'ordine del loro attore con indice minore.
+     *
+     * @param path Il file da scrivere.
+     * @param attori Gli attori, in ordine di codice.
+     * @param offsets I confini delle righe dei vicini, come in cammini.c.
+     * @param archi Le coppie (indice dell'attore, indice del coprotagonista), riga dopo riga, ordinate.
+     */
+    private static void scriviSnapshot(String path, ElencoAttori attori, long[] offsets, SorgenteLong archi) throws IOException {
+        int n = attori.n;
+
+        long offAttori = 0, offOffsets = 0, offVicini = 0, offNomi = 0, offComponenti = 0;
+        long chkAttori = 0, chkOffsets = 0, chkVicini = 0, chkNomi = 0, chkComponenti = 0;
+        long numVicini = offsets[n], dimNomi = 0;
+        int numComponenti = 0;
+
+        // Union-find sugli indici per le componenti connesse, riempito mentre si
+        // scrivono i vicini: la radice di ogni insieme è il suo indice minore.
+        int[] padre = new int[n];
+        for (int i = 0; i < n; i++) {
+            padre[i] = i;
+        }
+
+        String temporaneo = path + ".tmp";
+        try (ScrittoreSnapshot w = new ScrittoreSnapshot(temporaneo, SNAPSHOT_DIM_HEADER)) {
+            w.iniziaSezione();
+            offAttori = w.posizione();
+            long posizioneNome = 0;
+            for (int i = 0; i < n; i++) {
+                w.scriviInt(attori.codici[i]);
+                w.scriviInt(attori.anni[i]);
+                w.scriviLong(posizioneNome);
+                posizioneNome += attori.nomi[i].getBytes(StandardCharsets.UTF_8).length + 1;
+            }
+            chkAttori = w.fineSezione();
+
+            w.iniziaSezione();
+            offOffsets = w.posizione();
+            for (int i = 0; i <= n; i++) {
+                w.scriviLong(offsets[i]);
+            }
+            chkOffsets = w.fineSezione();
+
+            w.iniziaSezione();
+            offVicini = w.posizione();
+            for (int i = 0; i < n; i++) {
+                for (long k = offsets[i]; k < offsets[i + 1]; k++) {
+                    int v = ArrayLong.basso(archi.prossimo());
+                    w.scriviInt(v);
+                    unisci(padre, i, v);
+                }
+            }
+            chkVicini = w.fineSezione();
+
+            w.iniziaSezione();
+            offNomi = w.posizione();
+            for (int i = 0; i < n; i++) {
+                w.scriviBytes(attori.nomi[i].getBytes(StandardCharsets.UTF_8));
+                w.scriviByte(0);
+            }
+            dimNomi = w.posizione() - offNomi;
+            chkNomi = w.fineSezione();
+
+            // padre[i] <= i: quando si arriva a i, padre[padre[i]] contiene già il numero della componente.
+            w.iniziaSezione();
+            offComponenti = w.posizione();
+            for (int i = 0; i < n; i++) {
+                padre[i] = (padre[i] == i) ? numComponenti++ : padre[padre[i]];
+                w.scriviInt(padre[i]);
+            }
+            chkComponenti = w.fineSezione();
+        }
+
+        // L'intestazione si scrive per ultima, quando dimensioni e checksum sono noti.
+        ByteBuffer header = ByteBuffer.allocate(SNAPSHOT_DIM_HEADER).order(ByteOrder.LITTLE_ENDIAN);
+        header.put("CAMGRAFO".getBytes(StandardCharsets.US_ASCII));
+        header.putInt(SNAPSHOT_VERSIONE);
+        header.putInt(SNAPSHOT_DIM_HEADER);
+        header.putLong(n);
+        header.putLong(numVicini);
+        header.putLong(dimNomi);
+        header.putLong(offAttori);
+        header.putLong(offOffsets);
+        header.putLong(offVicini);
+        header.putLong(offNomi);
+        header.putLong(chkAttori);
+        header.putLong(chkOffsets);
+        header.putLong(chkVicini);
+        header.putLong(chkNomi);
+        header.putLong(offComponenti);
+        header.putLong(numComponenti);
+        header.putLong(chkComponenti);
+        ScrittoreSnapshot.scriviIntestazione(temporaneo, header);
+        sostituisci(temporaneo, path);
+    }
+
+    /** Radice dell'insieme di i, dimezzando il cammino. */
+    private static int radice(int[] padre, int i) {
+        while (padre[i] != i) {
+            padre[i] = padre[padre[i]];
+            i = padre[i];
+        }
+        return i;
+    }
+
+    /** Unisce gli insiemi di a e b collegando la radice maggiore a quella minore. */
+    private static void unisci(int[] padre, int a, int b) {
+        int ra = radice(padre, a), rb = radice(padre, b);
+        if (ra != rb) {
+            padre[Math.max(ra, rb)] = Math.min(ra, rb);
+        }
+    }
+
+    /**
+     * Metodo di utilità per processare il cast di un singolo titolo.
+     * Dati gli indici degli attori che hanno lavorato insieme (senza ripetizioni),
+     * aggiunge un arco (una relazione di co-protagonismo) per ogni possibile coppia.
+     * I duplicati tra titoli diversi si eliminano dopo, tutti insieme.
+     * 
+     * @param cast Indici degli attori che formano il cast di un titolo, nelle prime dimCast posizioni.
+     * @param dimCast Numero di attori del cast.
+     * @param coppie Gli archi raccolti finora, come (indice minore, indice maggiore).
+     */
+    private static void processCast(int[] cast, int dimCast, ArrayLong coppie) {
+        // Se ci sono meno di 2 attori del nostro elenco nel cast, non ci sono coppie da creare.
+        // Il secondo ciclo parte da 'i + 1' per evitare di accoppiare un attore con se stesso
+        // e per evitare coppie duplicate (es. se processiamo (a1, a2), non processeremo (a2, a1)).
+        // Il grafo non è orientato: la coppia vale per entrambe le direzioni.
+        for (int i = 0; i < dimCast; i++) {
+            for (int j = i + 1; j < dimCast; j++) {
+                coppie.aggiungi(ArrayLong.coppia(Math.min(cast[i], cast[j]), Math.max(cast[i], cast[j])));
+            }
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#!/bin/bash
+# Benchmark riproducibile di cammini.out (e, con 'java', di CreaGrafo) su un
+# grafo sintetico generato da genera.out. Di solito si lancia con 'make bench'
+# o 'make bench_java', che compilano prima i programmi.
+#
+# Parametri (variabili d'ambiente):
+#   BENCH_ATTORI    attori del grafo sintetico (default: 100000)
+#   BENCH_SEME      seme del generatore (default: 1)
+#   BENCH_QUERY     richieste della misura di latenza; quella di throughput
+#                   ne usa 4 volte tante (default: 1000)
+#   BENCH_OPZIONI   opzioni aggiuntive di cammini.out, es. "-m bidir -C 256"
+#   BENCH_DIR       cartella dei dati e dei risultati (default: bench)
+#   BENCH_JAVA_BASE con 'java', una revisione git di CreaGrafo.java da misurare
+#                   sugli stessi dati come riferimento, es. la prima del
+#                   repository (default: nessuna)
+#   JVM_OPTS        con 'java', le opzioni della JVM (default: -Xmx4g)
+#   BENCH_MEMORIA   con 'java', il budget in MB di CreaGrafo (-Dcreagrafo.memoria)
+#                   e una heap di soli BENCH_MEMORIA + 64 MB, per verificare che
+#                   il budget tenga; non si applica alla versione di riferimento
+#
+# Il grafo viene rigenerato solo se cambiano attori o seme. Le richieste sono
+# quelle di carico.out, con semi fissi: a parità di parametri la miscela di
+# query è sempre la stessa, quindi due esecuzioni sono confrontabili.
+
+set -e
+RADICE=$(cd "$(dirname "$0")" && pwd)
+ATTORI=${BENCH_ATTORI:-100000}
+SEME=${BENCH_SEME:-1}
+QUERY=${BENCH_QUERY:-1000}
+OPZIONI=${BENCH_OPZIONI:-}
+DIR=${BENCH_DIR:-bench}
+THREAD=$(nproc 2>/dev/null || echo 1)
+
+mkdir -p "$DIR"
+DIR=$(cd "$DIR" && pwd)
+
+# Memoria massima (VmHWM, in kB) del processo $1, campionata finché non termina
+picco_memoria() {
+    local pid=$1 picco=0 h
+    while kill -0 "$pid" 2>/dev/null; do
+        h=$(awk '/^VmHWM/ {print $2}' "/proc/$pid/status" 2>/dev/null || true)
+        if [ -n "$h" ] && [ "$h" -gt "$picco" ]; then picco=$h; fi
+        sleep 0.2
+    done
+    echo "$picco"
+}
+
+echo "=== Grafo sintetico: $ATTORI attori, seme $SEME ==="
+if [ "$(cat "$DIR/parametri" 2>/dev/null)" != "$ATTORI $SEME" ]; then
+    rm -f "$DIR/parametri"
+    (cd "$DIR" && "$RADICE/genera.out" -a "$ATTORI" -s "$SEME" -T)
+    echo "$ATTORI $SEME" > "$DIR/parametri"
+else
+    echo "Dati già presenti in $DIR"
+fi
+
+# Esegue CreaGrafo compilato in $1 nella cartella $2, con le opzioni aggiuntive
+# della JVM $3, e stampa tempo e picco di memoria
+misura_creagrafo() {
+    local classi=$1 cartella=$2 opzioni=$3 inizio fine pid picco
+    mkdir -p "$cartella"
+    cd "$cartella"
+    rm -f nomi.txt grafo.txt grafo.bin partecipazioni.txt
+    inizio=$(date +%s.%N)
+    java -cp "$classi" ${JVM_OPTS:--Xmx4g} $opzioni CreaGrafo ../name.basics.tsv ../title.principals.tsv ../title.basics.tsv > creagrafo.log &
+    pid=$!
+    picco=$(picco_memoria $pid)
+    wait $pid
+    fine=$(date +%s.%N)
+    awk -v a="$inizio" -v b="$fine" -v m="$picco" \
+        'BEGIN { printf "Tempo %.2f s, memoria massima %.1f MB\n", b - a, m / 1024 }'
+}
+
+if [ "$1" = "java" ]; then
+    echo "=== JVM: ${JVM_OPTS:--Xmx4g} ==="
+    # La versione di riferimento, compilata a parte, prima di quella corrente
+    if [ -n "${BENCH_JAVA_BASE:-}" ]; then
+        mkdir -p "$DIR/java_base/classi"
+        git -C "$RADICE" show "$BENCH_JAVA_BASE:CreaGrafo.java" > "$DIR/java_base/classi/CreaGrafo.java"
+        javac -d "$DIR/java_base/classi" "$DIR/java_base/classi/CreaGrafo.java"
+        echo "=== CreaGrafo di $BENCH_JAVA_BASE ==="
+        misura_creagrafo "$DIR/java_base/classi" "$DIR/java_base" ""
+    fi
+    # CreaGrafo in una sottocartella, perché scrive i suoi file nella cartella corrente
+    # Il -Xmx più a destra prevale: con un budget la heap è solo quella del budget,
+    # più 64 MB per gli attori, che non vi rientrano, e per la JVM
+    budget=
+    if [ -n "${BENCH_MEMORIA:-}" ]; then
+        budget="-Xmx$((BENCH_MEMORIA + 64))m -Dcreagrafo.memoria=$BENCH_MEMORIA"
+    fi
+    echo "=== CreaGrafo ${budget:+($budget)} ==="
+    misura_creagrafo "$RADICE" "$DIR/java" "$budget"
+    if cmp -s nomi.txt ../nomi.txt && cmp -s grafo.txt ../grafo.txt; then
+        echo "nomi.txt e grafo.txt identici a quelli del generatore"
+    else
+        echo "ATTENZIONE: nomi.txt o grafo.txt diversi da quelli del generatore"
+        exit 1
+    fi
+    exit 0
+fi
+
+cd "$DIR"
+rm -f bench.sock statistiche.txt
+"$RADICE/cammini.out" $OPZIONI -S bench.sock -T statistiche.txt nomi.txt grafo.txt "$THREAD" > /dev/null 2> server.log &
+SERVER=$!
+trap 'kill -INT $SERVER 2>/dev/null || true' EXIT
+for i in $(seq 6000); do
+    [ -S bench.sock ] && break
+    if ! kill -0 $SERVER 2>/dev/null; then
+        echo "cammini.out terminato durante il caricamento:"
+        cat server.log
+        exit 1
+    fi
+    sleep 0.1
+done
+
+echo "=== Latenza: $QUERY richieste, una alla volta ==="
+"$RADICE/carico.out" -u bench.sock -c 1 -w 1 -b 0 -n "$QUERY" nomi.txt
+echo "=== Throughput: $((QUERY * 4)) richieste, 4 client con 64 in volo ==="
+"$RADICE/carico.out" -u bench.sock -c 4 -w 64 -n $((QUERY * 4)) nomi.txt
+
+kill -INT $SERVER
+wait $SERVER || true
+trap - EXIT
+echo "=== Statistiche del server (opzioni: ${OPZIONI:-nessuna}) ==="
+grep -v "^===" statistiche.txt
@@ -7,74 +7,382 @@
 #include <fcntl.h>    
 #include <unistd.h>   
 #include <signal.h>
+#include <setjmp.h>
 #include <errno.h>
 #include <sys/times.h> 
+#include <sys/resource.h>
 #include <stdint.h>    
+#include <stdarg.h>
+#include <inttypes.h>
+#include <stddef.h>
 #include <limits.h>    
 #include <time.h>      
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 // Valori per S_PROGRAM_PHASE
 #define PHASE_GRAPH_CONSTRUCTION 0
 #define PHASE_PIPE_READING 1
+#define PHASE_TERMINATION 2      // self-pipe in chiusura: SIGHUP e SIGINT si ignorano
+
+// Modalità di ricerca del cammino minimo (opzione -m)
+#define BFS_UNIDIREZIONALE 0
+#define BFS_BIDIREZIONALE 1
+
+// Strategie di numerazione degli attori (opzione -R): vedi "Riordino del Grafo"
+#define RIORDINO_NESSUNO 0
+#define RIORDINO_GRADO 1
+#define RIORDINO_RCM 2
+#define RIORDINO_GORDER 3
 
 // --- Strutture Dati ---
+// Stesso formato di snapshot_attore_t: con uno snapshot 'attori' è la sua sezione mappata.
 typedef struct {
     int codice;
-    char *nome;
     int anno;
-    int numcop;
-    int *cop;
+    int64_t nome;       // posizione del nome in grafo_t.nomi
 } attore;
 
-// Buffer condiviso per produttore-consumatore (linee da grafo.txt)
+// Arena di memoria in pagine grandi, liberata tutta insieme: vedi "Arene in Pagine Grandi".
+typedef struct regione_arena regione_arena_t;
+typedef struct {
+    regione_arena_t *regioni;   // tutte le regioni, la più recente per prima
+    regione_arena_t *corrente;  // regione condivisa delle allocazioni piccole
+    size_t mappati;             // byte mappati in totale
+    int num_regioni;
+    int esplicite;              // regioni in pagine grandi esplicite (MAP_HUGETLB)
+} arena_t;
+
+// Grafo in formato CSR (Compressed Sparse Row).
+// Gli attori sono identificati da un id denso 0..tota_attori-1 (la posizione in 'attori',
+// ordinato per codice, o nell'ordine scelto con -R). I coprotagonisti dell'attore i sono
+// vicini[offsets[i]] .. vicini[offsets[i+1]-1], già convertiti in id densi.
+// I nomi sono tutti in un'unica area, 'nomi', terminati da '\0'.
+// Se il grafo è stato caricato da uno snapshot binario, attori, offsets, vicini e
+// nomi puntano direttamente nella mappatura (condivisa tra i processi che la usano).
+// Tutti gli altri array del grafo stanno in 'arena'.
+// Con -z, dopo il caricamento le liste vengono compresse (vicini diventa NULL)
+// e si leggono con grafo_vicini: vedi la sezione "Adiacenze Compresse".
+typedef struct {
+    const attore *attori;
+    int tota_attori;
+    const char *nomi;       // dim_nomi byte
+    int64_t dim_nomi;
+    const int *per_nome;    // id degli attori in ordine di nome: vedi "Indice dei Nomi"
+    const int *per_codice;  // id degli attori in ordine di codice, NULL se 'attori' lo è già
+    const int64_t *offsets; // tota_attori + 1 elementi
+    const int *vicini;      // offsets[tota_attori] elementi
+    const uint8_t *compressi;   // liste compresse, NULL se non usate
+    const uint64_t *posizioni;  // tota_attori + 1 offset in byte delle liste in 'compressi'
+    int grado_max;
+    const int *componente;  // componente connessa di ogni attore, numerate da 0 nell'ordine
+                            // del loro attore con id minore
+    int num_componenti;
+    void *snapshot;         // mmap dello snapshot, NULL se caricato dai file di testo
+    size_t dim_snapshot;
+    arena_t arena;
+} grafo_t;
+
+static inline const char *grafo_nome(const grafo_t *g, int id) {
+    return g->nomi + g->attori[id].nome;
+}
+
+// Partecipazioni degli attori (opzione -P) in formato CSR, come il grafo: i
+// titoli dell'attore con id v sono titoli[inizio[v]] .. titoli[inizio[v+1]-1],
+// codici in ordine crescente. Vedi la sezione "Titoli in Comune".
+typedef struct {
+    int64_t *inizio;            // tota_attori + 1 elementi
+    int32_t *titoli;            // inizio[tota_attori] elementi
+    // Nomi dei titoli (opzione -t): per ogni codice distinto di 'titoli', in
+    // ordine crescente, la posizione del nome in 'nomi' (-1 se manca)
+    int64_t num_codici;
+    int32_t *codici;
+    int64_t *pos_nomi;
+    char *nomi;                 // NULL senza -t
+    arena_t arena;              // tutti gli array qui sopra
+} partecipazioni_t;
+
+// --- Snapshot Binario del Grafo ---
+// File scritto da CreaGrafo.java (grafo.bin) e mappato in memoria da cammini.
+// Tutti gli interi sono little-endian e ogni sezione inizia a un offset
+// multiplo di 8. Dopo l'intestazione seguono, nell'ordine:
+//   attori   tota_attori record snapshot_attore_t, in ordine di codice
+//   offsets  tota_attori + 1 int64, come in grafo_t
+//   vicini   num_vicini int32, già come id densi
+//   nomi     dim_nomi byte: i nomi UTF-8 terminati da '\0'
+//   componenti  tota_attori int32, come grafo_t.componente
+#define SNAPSHOT_MAGIC "CAMGRAFO"
+#define SNAPSHOT_VERSIONE 2
+
+typedef struct {
+    char magic[8];
+    uint32_t versione;
+    uint32_t dim_header;        // sizeof(snapshot_header_t)
+    int64_t tota_attori;
+    int64_t num_vicini;
+    int64_t dim_nomi;
+    int64_t off_attori, off_offsets, off_vicini, off_nomi;
+    uint64_t chk_attori, chk_offsets, chk_vicini, chk_nomi;
+    int64_t off_componenti;
+    int64_t num_componenti;
+    uint64_t chk_componenti;
+    uint64_t chk_header;        // checksum dei campi precedenti
+} snapshot_header_t;
+
+typedef struct {
+    int32_t codice;
+    int32_t anno;
+    int64_t nome;               // posizione del nome nella sezione nomi
+} snapshot_attore_t;
+
+_Static_assert(sizeof(attore) == sizeof(snapshot_attore_t) &&
+               offsetof(attore, nome) == offsetof(snapshot_attore_t, nome),
+               "attore deve avere il formato di snapshot_attore_t");
+
+// --- Indice 2-hop (Pruned Landmark Labeling) ---
+// Ogni attore v ha un'etichetta: l'elenco degli hub h con la distanza d(v, h),
+// in ordine crescente di rango dell'hub (gli hub sono numerati per grado
+// decrescente). d(s, t) è il minimo di d(s, h) + d(h, t) sugli hub comuni alle
+// due etichette, che si trovano con un'unica fusione delle due liste.
+#define PLL_INFINITO 255            // distanza non raggiungibile (le distanze sono uint8_t)
+#define PLL_MAGIC "CAMPLL01"
+#define PLL_VERSIONE 1
+
+typedef struct {
+    int tota_attori;
+    int64_t num_etichette;
+    const int64_t *offsets;     // etichetta di v: posizioni offsets[v] .. offsets[v+1]-1
+    const int32_t *hub;         // rango dell'hub
+    const uint8_t *dist;        // distanza dall'hub
+    void *mappa;                // mmap del file dell'indice, NULL se costruito in memoria
+    size_t dim_mappa;
+} pll_indice_t;
+
+// Cache dei risultati e degli alberi BFS delle sorgenti frequenti (vedi la sezione
+// "Cache dei Risultati"), condivisa dai worker.
+typedef struct cache cache_t;
+
+// Scrittore asincrono dei risultati su un log o una FIFO (opzione -o), vedi la
+// sezione "Scrittore Asincrono dei Risultati".
+typedef struct scrittore scrittore_t;
+
+// Intestazione del file dell'indice; le sezioni sono allineate a 8 byte come nello snapshot.
+typedef struct {
+    char magic[8];
+    uint32_t versione;
+    uint32_t dim_header;
+    int64_t tota_attori;
+    int64_t num_etichette;
+    uint64_t impronta_grafo;    // checksum di offsets e vicini del grafo indicizzato
+    int64_t off_offsets, off_hub, off_dist;
+    uint64_t chk_offsets, chk_hub, chk_dist;
+    uint64_t chk_header;
+} pll_header_t;
+
+// Memoria di lavoro di una BFS, allocata una volta e riutilizzata tra le query.
+// 'visitato' è marcato con un numero di generazione: incrementandolo all'inizio
+// di ogni query tutti i nodi risultano non visitati, senza azzerare l'array.
+typedef struct {
+    uint32_t *visitato;         // visitato[v] == generazione <=> v già scoperto
+    int *parent;                // predecessore (id denso) di v nella BFS, -1 per la sorgente
+    int *coda;                  // frontiera FIFO contigua (ogni nodo entra al più una volta)
+    uint32_t generazione;
+    uint8_t *dist_hub;          // indice 2-hop: dist_hub[h] = d(h, t) per gli hub di t (allocato al primo uso)
+    int *vicini;                // liste decodificate se il grafo è compresso, NULL altrimenti
+    arena_t arena;              // tutti gli array qui sopra
+} bfs_scratch_t;
+
+// Compiti eseguibili dal team della BFS parallela
+#define TEAM_INIT_VISITATI 0
+#define TEAM_TOP_DOWN 1
+#define TEAM_BOTTOM_UP 2
+#define TEAM_STOP 3
+
+// Team di thread che espande in parallelo i livelli di una singola query grande.
+// Il team è unico e viene usato da una query alla volta (mutex 'occupato'):
+// la query che lo acquisisce fa da leader, gli altri thread attendono i compiti
+// sulla barriera 'inizio'. Frontiera e visitati sono bitmap di tota_attori bit.
+typedef struct {
+    int num_thread;             // leader incluso
+    pthread_t *tids;            // num_thread - 1 helper
+    pthread_barrier_t inizio;
+    pthread_barrier_t fine;
+    pthread_mutex_t occupato;
+    size_t parole;              // parole da 64 bit di ogni bitmap
+    uint64_t *frontiera;
+    uint64_t *prossima;
+    uint64_t *visitati;
+    // Compito corrente, scritto dal leader prima della barriera 'inizio'
+    int compito;
+    const grafo_t *g;
+    bfs_scratch_t *sc;
+    uint32_t marca;             // generazione del lato espanso
+    uint32_t marca_altro;       // generazione dell'altro lato (o della destinazione)
+    size_t prossimo_blocco;     // contatore atomico dei blocchi di lavoro
+    // Risultati del compito, accumulati atomicamente dai thread
+    int64_t n_prossima;         // nodi della nuova frontiera
+    int64_t m_prossima;         // somma dei loro gradi
+    int64_t archi_esaminati;
+    int trovato;                // 1 se è stato trovato l'arco di incontro
+    int meet_da, meet_verso;
+    arena_t arena;              // le tre bitmap
+} bfs_team_t;
+
+// Opzioni della riga di comando, condivise in sola lettura da tutti i thread
+typedef struct {
+    int modalita_bfs;   // BFS_UNIDIREZIONALE o BFS_BIDIREZIONALE
+    int verbose;        // stampa su stderr le statistiche di ogni query
+    int thread_query;   // thread del team per la BFS parallela di una singola query
+    int num_worker;     // worker del pool che rispondono alle richieste
+    int capacita_coda;  // richieste accodabili prima di bloccare la lettura della pipe
+    int min_batch;      // richieste in attesa oltre le quali si usa la MS-BFS (0: mai)
+    const char *snapshot;   // snapshot binario da mappare, NULL per i soli file di testo
+    int verifica_snapshot;  // controlla i checksum di tutte le sezioni dello snapshot
+    const char *file_indice; // indice 2-hop da caricare o costruire e salvare, NULL se non usato
+    long cache_mb;          // memoria della cache dei risultati in MB (0: disattivata)
+    const char *file_risultati; // log o FIFO dei risultati, NULL per un file per richiesta
+    long fsync_ms;          // con -o: fdatasync al più ogni fsync_ms ms (0: a ogni scrittura, -1: mai)
+    const char *socket;     // socket Unix su cui accettare client, NULL se non usato
+    const char *file_statistiche; // file per le statistiche di SIGUSR1, NULL per stderr
+    int comprimi;           // liste di adiacenza compresse in memoria
+    const char *file_partecipazioni; // partecipazioni.txt per i titoli in comune, NULL se non usato
+    const char *file_titoli;        // title.basics.tsv per i nomi dei titoli, NULL se non usato
+    int riordino;           // strategia di numerazione degli attori (RIORDINO_*)
+} opzioni_t;
+
+// Statistiche raccolte durante una singola ricerca
 typedef struct {
-    char **buffer;
+    long nodi_espansi;  // nodi estratti dalle frontiere
+    long archi_esaminati;
+    long frontiera_max; // nodi nella frontiera più grande espansa
+} bfs_stats_t;
+
+// Come è stata risolta una richiesta
+#define VIA_NON_VALIDA 0    // codice inesistente
+#define VIA_COMPONENTI 1    // componenti connesse diverse
+#define VIA_CACHE 2
+#define VIA_INDICE 3        // indice 2-hop
+#define VIA_BFS 4
+#define VIA_BATCH 5         // MS-BFS
+#define VIA_NUM 6
+
+// Misure di una richiesta, prese dal worker che la elabora
+typedef struct {
+    struct timespec cpu_inizio; // CPU del thread (CLOCK_THREAD_CPUTIME_ID)
+    struct timespec inizio;     // tempo reale (CLOCK_MONOTONIC)
+    bfs_stats_t bfs;            // visita dedicata alla richiesta, a zero per le altre vie
+    uint64_t cpu_quota_ns;      // quota della MS-BFS condivisa del batch, a zero per le altre vie
+    uint64_t servizio_quota_ns; // idem, in tempo reale
+    int via;                    // VIA_*
+} metriche_t;
+
+// Blocco di righe complete di un file di testo mappato in memoria, analizzato
+// da uno dei thread del caricamento.
+typedef struct {
+    const char *inizio, *fine;
+    grafo_t *g;         // grafo in costruzione
+    const char **prima_riga; // grafo.txt: prima_riga[id], la riga dell'attore che vale (passo 1)
+    int *gradi;         // grafo.txt: gradi[id], il grado dichiarato in prima_riga[id], limitato
+    int *scritti;       // grafo.txt: scritti[id], coprotagonisti validi copiati in vicini (passo 2)
+    int64_t righe;      // nomi.txt: righe del blocco (passo 1)
+    int64_t byte_nomi;  // nomi.txt: byte dei nomi del blocco, '\0' compresi (passo 1)
+    int64_t primo;      // nomi.txt: posizione in attori della prima riga del blocco
+    int64_t primo_byte; // nomi.txt: posizione in g->nomi del primo nome del blocco
+    int64_t validi;     // nomi.txt: attori validi scritti da 'primo' in poi (passo 2)
+    partecipazioni_t *part; // partecipazioni.txt e title.basics.tsv: indice in costruzione
+} blocco_testo_t;
+
+// Numero massimo di richieste risolte insieme da una BFS multi-sorgente
+// (una per bit di una parola da 64 bit).
+#define MSBFS_MAX 64
+
+// Voce del registro dei livelli della MS-BFS: il nodo 'id' è stato raggiunto
+// in quel livello dalle ricerche indicate in 'maschera'.
+typedef struct {
+    int id;
+    uint64_t maschera;
+} msbfs_voce_t;
+
+// Memoria di lavoro della BFS multi-sorgente, allocata da un worker al primo batch.
+typedef struct {
+    uint64_t *seen;             // seen[v] bit i: la ricerca i ha raggiunto v
+    uint64_t *visit;            // frontiera corrente, stesso formato
+    uint64_t *visit_next;       // frontiera del livello successivo
+    msbfs_voce_t *voci;         // registro dei livelli, in ordine di livello e di id
+    int64_t num_voci, cap_voci;
+    int64_t *inizio_livello;    // posizione nel registro dell'inizio di ogni livello
+    int cap_livelli;
+    arena_t arena;              // seen, visit e visit_next; il registro cresce con realloc
+} msbfs_scratch_t;
+
+// Connessione di un client al socket del server (opzione -S), vedi la sezione
+// "Connessioni dei Client su Socket".
+typedef struct connessione connessione_t;
+
+// Una richiesta letta da cammini.pipe o da una connessione
+typedef struct {
+    int start_codice;
+    int end_codice;
+    connessione_t *conn;        // connessione a cui rispondere, NULL per cammini.pipe
+    uint64_t arrivo_ns;         // lettura della richiesta (CLOCK_MONOTONIC)
+} richiesta_t;
+
+// Coda circolare limitata di un singolo worker. Il proprietario preleva dalla
+// testa; gli altri worker, se restano senza lavoro, rubano dalla coda.
+typedef struct {
+    richiesta_t *buffer;
     int capacity;
     int count;
     int head;
-    int tail;
     pthread_mutex_t mutex;
-    pthread_cond_t not_empty;
-    pthread_cond_t not_full;
-    int done_producing;
-} line_buffer_t;
-
-// Nodo per la coda FIFO (usata in BFS)
-typedef struct q_node {
-    int codice;
-    struct q_node *next;
-} q_node_t;
+} coda_worker_t;
 
-// Coda FIFO
+// Versione del grafo in servizio, con tutto ciò che dipende dai suoi id densi.
+// Con SIGHUP se ne carica una nuova in background (vedi "Ricarica a Caldo"):
+// i worker la prendono con versione_acquisisci e la vecchia si libera solo
+// quando nessuno la usa più.
 typedef struct {
-    q_node_t *head;
-    q_node_t *tail;
-} fifo_queue_t;
-
-// Nodo per Albero Binario di Ricerca (ABR) (usato in BFS per 'explored' e 'parent')
-typedef struct abr_node {
-    int shuffled_codice; // Chiave (codice "mescolato")
-    int original_codice; // Codice attore originale
-    int parent_codice;   // Codice del predecessore nel cammino BFS
-    struct abr_node *left;
-    struct abr_node *right;
-} abr_node_t;
+    grafo_t grafo;
+    pll_indice_t *indice;       // indice 2-hop, NULL se le query usano la BFS
+    cache_t *cache;             // cache dei risultati, NULL se disattivata
+    bfs_team_t *team;
+    partecipazioni_t *partecipazioni; // titoli in comune (-P), NULL se non usati
+    uint64_t numero;            // 1 per il grafo iniziale, poi uno in più a ogni ricarica
+} versione_t;
 
-// Argomenti per i thread consumatori
+// Pool fisso di worker BFS. Le richieste sono distribuite a turno sulle code dei
+// worker; 'posti_occupati' conta le richieste nel sistema (accodate o appena
+// prelevate) e non supera 'capacity': oltre quel limite il lettore della pipe
+// si blocca, e con lui chi scrive sulla FIFO.
 typedef struct {
-    line_buffer_t *buffer;
-    attore *attori_arr;
-    int tota_attori;
-} consumer_args_t;
+    int num_worker;
+    pthread_t *tids;
+    coda_worker_t *code;
+    int prossima_coda;          // round-robin, usato solo dal lettore della pipe
+    pthread_mutex_t mutex;      // protegge i contatori seguenti
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    int capacity;
+    int posti_occupati;         // posti riservati dal lettore e non ancora liberati
+    int disponibili;            // richieste accodate e non ancora assegnate a un worker
+    int chiusura;
+    // Contesto condiviso dai worker
+    versione_t *versione;       // versione corrente, sostituita con un'operazione atomica
+    versione_t **in_uso;        // versione in uso da ogni worker (e dal main, ultimo posto), NULL se nessuna
+    scrittore_t *scrittore;     // destinazione dei risultati, NULL per un file per richiesta
+    const opzioni_t *opzioni;
+} bfs_pool_t;
 
-// Argomenti per i thread BFS
+// Argomenti di un thread worker
 typedef struct {
-    attore *attori_arr;
-    int tota_attori;
-    int start_codice_orig;
-    int end_codice_orig;
-} bfs_args_t;
+    bfs_pool_t *pool;
+    int indice;
+} worker_args_t;
 
 // --- Variabili Statiche (per coordinamento segnali) ---
 static volatile sig_atomic_t S_PROGRAM_PHASE = PHASE_GRAPH_CONSTRUCTION;
@@ -82,11 +390,10 @@ static volatile sig_atomic_t S_SHUTDOWN_REQUEST = 0;
 static pthread_t S_MAIN_THREAD_ID;
 static int S_CAMMINI_PIPE_FD = -1; 
 static int S_SELF_PIPE_FD[2] = {-1, -1};
-
-// --- Funzioni Shuffle/Unshuffle ---
-int shuffle(int n) {
-    return ((((n & 0x3F) << 26) | ((n >> 6) & 0x3FFFFFF)) ^ 0x55555555);
-}
+// Il thread dei segnali scrive nella self-pipe solo sotto questo mutex e in
+// PHASE_PIPE_READING; il main passa a PHASE_TERMINATION sotto lo stesso mutex
+// prima di chiuderla, così nessun byte va a un descrittore chiuso o riusato.
+static pthread_mutex_t S_SELF_PIPE_MUTEX = PTHREAD_MUTEX_INITIALIZER;
 
 // Handler vuoto, serve solo per interrompere le chiamate di sistema bloccanti.
 static void empty_signal_handler(int signum) {
@@ -103,443 +410,4941 @@ int compare_attori(const void *a, const void *b) {
 }
 
 // Wrapper per bsearch per trovare un attore
-attore *find_attore_by_codice(int codice, attore *attori_arr, int tota_attori) {
+const attore *find_attore_by_codice(int codice, const attore *attori_arr, int tota_attori) {
     attore key = { .codice = codice };
-    return (attore *)bsearch(&key, attori_arr, tota_attori, sizeof(attore), compare_attori);
+    return (const attore *)bsearch(&key, attori_arr, tota_attori, sizeof(attore), compare_attori);
+}
+
+// Restituisce l'id denso dell'attore con il codice dato, -1 se non presente.
+int id_attore_by_codice(int codice, const attore *attori_arr, int tota_attori) {
+    const attore *a = find_attore_by_codice(codice, attori_arr, tota_attori);
+    return a ? (int)(a - attori_arr) : -1;
+}
+
+// Come id_attore_by_codice, ma anche per un grafo riordinato con -R, in cui
+// la ricerca binaria passa per per_codice.
+int grafo_id(const grafo_t *g, int codice) {
+    if (!g->per_codice) return id_attore_by_codice(codice, g->attori, g->tota_attori);
+    int lo = 0, hi = g->tota_attori;
+    while (lo < hi) {
+        int m = lo + (hi - lo) / 2;
+        if (g->attori[g->per_codice[m]].codice < codice) lo = m + 1;
+        else hi = m;
+    }
+    return lo < g->tota_attori && g->attori[g->per_codice[lo]].codice == codice ? g->per_codice[lo] : -1;
 }
 
 // --- Funzioni di Utilità (Gestione Errori) ---
+// Punto di ripresa del thread corrente, armato solo mentre si carica una nuova
+// versione del grafo con il server già in servizio (vedi ricarica_thread_func).
+static __thread sigjmp_buf *S_RIPRESA = NULL;
+
+// Errore irrecuperabile: senza un punto di ripresa termina il processo, come
+// all'avvio; durante una ricarica torna al punto di ripresa, che scarta la
+// versione a metà e lascia in servizio quella vecchia.
+void fallisci(void) {
+    if (S_RIPRESA) siglongjmp(*S_RIPRESA, 1);
+    exit(EXIT_FAILURE);
+}
+
+// SIGBUS arriva leggendo una mappatura di un file troncato nel frattempo. Durante
+// una ricarica è un errore come un altro; altrimenti ha l'effetto predefinito.
+static void sigbus_handler(int signum) {
+    if (S_RIPRESA) siglongjmp(*S_RIPRESA, 1);
+    signal(signum, SIG_DFL);
+    raise(signum);
+}
+
 void *xmalloc(size_t size) {
     void *p = malloc(size);
     if (!p) {
         perror("malloc fallita");
-        exit(EXIT_FAILURE);
+        fallisci();
     }
     return p;
 }
 
-char *xstrdup(const char *s) {
-    char *p = strdup(s);
-    if (!p) {
-        perror("strdup fallito");
-        exit(EXIT_FAILURE);
+// Mappa in sola lettura l'intero file 'path' e ne restituisce la dimensione in
+// *dim. Un file vuoto non viene mappato e restituisce NULL.
+const char *xmappa_file(const char *path, size_t *dim) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        perror(path);
+        fallisci();
+    }
+    *dim = (size_t)st.st_size;
+    if (*dim == 0) {
+        close(fd);
+        return NULL;
+    }
+    void *dati = mmap(NULL, *dim, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (dati == MAP_FAILED) {
+        perror(path);
+        fallisci();
+    }
+    madvise(dati, *dim, MADV_SEQUENTIAL);
+    return (const char *)dati;
+}
+
+// --- Arene in Pagine Grandi ---
+// Grafo, partecipazioni, memoria di lavoro dei worker e bitmap del team vivono
+// quanto il loro proprietario e vengono allocati in un'arena: regioni mappate
+// con mmap, allineate a 2 MB e in pagine grandi, così la TLB copre molta più
+// memoria con le stesse voci. Con -H si chiedono pagine grandi esplicite
+// (MAP_HUGETLB, da /proc/sys/vm/nr_hugepages); se non ce ne sono, o senza -H,
+// le regioni sono normali con madvise(MADV_HUGEPAGE), che le affida alle
+// pagine grandi trasparenti.
+// Ogni allocazione oltre mezza ARENA_REGIONE ha una regione propria, che
+// arena_libera può restituire al sistema; le più piccole si accodano in una
+// regione condivisa e restano fino ad arena_destroy, che libera tutto con una
+// munmap per regione. La memoria di un'arena è azzerata. Un'arena non è
+// thread-safe: la usa solo chi la possiede.
+#define ARENA_REGIONE ((size_t)2 << 20)     // pagina grande x86-64: dimensione e allineamento delle regioni
+#define ARENA_ALLINEAMENTO 64               // allineamento di ogni allocazione (una riga di cache)
+
+struct regione_arena {
+    regione_arena_t *succ;
+    size_t dim;                 // byte mappati, intestazione compresa
+    size_t usati;               // byte già assegnati, intestazione compresa
+    int esplicita;              // in pagine grandi esplicite
+    int propria;                // contiene una sola allocazione grande
+};
+#define ARENA_INTESTAZIONE (((sizeof(regione_arena_t) + ARENA_ALLINEAMENTO - 1) / ARENA_ALLINEAMENTO) * ARENA_ALLINEAMENTO)
+
+static int S_PAGINE_ESPLICITE;         // -H: prova MAP_HUGETLB prima delle pagine trasparenti
+
+// Mappa una regione di 'dim' byte (multiplo di ARENA_REGIONE) allineata ad ARENA_REGIONE.
+static regione_arena_t *arena_mappa(size_t dim) {
+    void *p = MAP_FAILED;
+    int esplicita = 0;
+#ifdef MAP_HUGETLB
+    if (S_PAGINE_ESPLICITE) {
+        p = mmap(NULL, dim, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        esplicita = p != MAP_FAILED;
+    }
+#endif
+    if (p == MAP_FAILED) {
+        // Una pagina grande in più per poter tagliare testa e coda non allineate
+        char *m = (char *)mmap(NULL, dim + ARENA_REGIONE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m == MAP_FAILED) {
+            perror("mmap dell'arena fallita");
+            fallisci();
+        }
+        char *inizio = (char *)(((uintptr_t)m + ARENA_REGIONE - 1) & ~(uintptr_t)(ARENA_REGIONE - 1));
+        if (inizio > m) munmap(m, inizio - m);
+        if (m + ARENA_REGIONE > inizio) munmap(inizio + dim, m + ARENA_REGIONE - inizio);
+        p = inizio;
+#ifdef MADV_HUGEPAGE
+        madvise(p, dim, MADV_HUGEPAGE);
+#endif
+    }
+    regione_arena_t *r = (regione_arena_t *)p;
+    r->dim = dim;
+    r->usati = ARENA_INTESTAZIONE;
+    r->esplicita = esplicita;
+    r->propria = 0;
+    return r;
+}
+
+static regione_arena_t *arena_aggiungi(arena_t *a, size_t dim) {
+    regione_arena_t *r = arena_mappa(dim);
+    r->succ = a->regioni;
+    a->regioni = r;
+    a->mappati += r->dim;
+    a->num_regioni++;
+    a->esplicite += r->esplicita;
+    return r;
+}
+
+// Restituisce 'dim' byte azzerati, allineati ad ARENA_ALLINEAMENTO.
+void *arena_alloca(arena_t *a, size_t dim) {
+    dim = (dim + ARENA_ALLINEAMENTO - 1) & ~(size_t)(ARENA_ALLINEAMENTO - 1);
+    if (dim == 0) dim = ARENA_ALLINEAMENTO;
+    if (dim + ARENA_INTESTAZIONE > ARENA_REGIONE / 2) {
+        size_t totale = (dim + ARENA_INTESTAZIONE + ARENA_REGIONE - 1) & ~(ARENA_REGIONE - 1);
+        regione_arena_t *r = arena_aggiungi(a, totale);
+        r->usati = r->dim;
+        r->propria = 1;
+        return (char *)r + ARENA_INTESTAZIONE;
     }
+    regione_arena_t *r = a->corrente;
+    if (!r || r->usati + dim > r->dim) {
+        r = arena_aggiungi(a, ARENA_REGIONE);
+        a->corrente = r;
+    }
+    void *p = (char *)r + r->usati;
+    r->usati += dim;
     return p;
 }
 
-FILE *xfopen(const char *path, const char *mode) {
-    FILE *fp = fopen(path, mode);
-    if (!fp) {
-        perror(path);
-        exit(EXIT_FAILURE);
+// Restituisce subito al sistema un'allocazione con una regione propria; le
+// altre restano fino ad arena_destroy.
+void arena_libera(arena_t *a, const void *p) {
+    if (!p) return;
+    for (regione_arena_t **pr = &a->regioni; *pr; pr = &(*pr)->succ) {
+        regione_arena_t *r = *pr;
+        if (r->propria && (const char *)r + ARENA_INTESTAZIONE == (const char *)p) {
+            *pr = r->succ;
+            a->mappati -= r->dim;
+            a->num_regioni--;
+            a->esplicite -= r->esplicita;
+            munmap(r, r->dim);
+            return;
+        }
+    }
+}
+
+void arena_destroy(arena_t *a) {
+    regione_arena_t *r = a->regioni;
+    while (r) {
+        regione_arena_t *succ = r->succ;
+        munmap(r, r->dim);
+        r = succ;
+    }
+    *a = (arena_t){ 0 };
+}
+
+// --- Adiacenze Compresse (Stream VByte) ---
+// Con -z le liste di adiacenza restano in memoria compresse. Ogni lista,
+// ordinata, diventa la sequenza delle differenze tra id consecutivi (il primo
+// rispetto a 0), codificata in formato Stream VByte: prima un byte di controllo
+// ogni 4 valori, con 2 bit per valore che ne danno la lunghezza in byte (1-4),
+// poi i byte dei valori. Tra coprotagonisti le differenze sono piccole e
+// bastano quasi sempre 1 o 2 byte invece di 4.
+// Separare i controlli dai dati permette di decodificare 4 valori alla volta:
+// con SSSE3 il byte di controllo sceglie una maschera per pshufb, che sposta
+// ogni valore nella sua corsia da 32 bit, e la somma prefissa si fa nel
+// registro con due shift. Senza SSSE3 si decodifica un valore alla volta.
+// 'offsets' resta invariato, quindi gradi e somme di gradi non richiedono
+// decodifica; chi legge una lista le passa un buffer di grado_max + 3 interi.
+static uint8_t S_SVB_MASCHERE[256][16];
+static uint8_t S_SVB_LUNGHEZZE[256];   // byte di dati dei 4 valori di un controllo
+static int S_SVB_SIMD;
+
+static int svb_lunghezza(uint32_t x) {
+    return x < (1u << 8) ? 1 : x < (1u << 16) ? 2 : x < (1u << 24) ? 3 : 4;
+}
+
+static void svb_inizializza(void) {
+    for (int c = 0; c < 256; ++c) {
+        int pos = 0;
+        for (int j = 0; j < 4; ++j) {
+            int l = ((c >> (2 * j)) & 3) + 1;
+            for (int b = 0; b < 4; ++b) S_SVB_MASCHERE[c][4 * j + b] = b < l ? (uint8_t)(pos + b) : 0x80;
+            pos += l;
+        }
+        S_SVB_LUNGHEZZE[c] = (uint8_t)pos;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    S_SVB_SIMD = __builtin_cpu_supports("ssse3");
+#endif
+}
+
+// Codifica i valori ordinati 'v' (n) in 'out', se non NULL; restituisce i byte usati.
+static size_t svb_codifica(const int *v, int64_t n, uint8_t *out) {
+    size_t dim_controlli = (size_t)(n + 3) / 4, pos = dim_controlli;
+    if (out) memset(out, 0, dim_controlli);
+    uint32_t prec = 0;
+    for (int64_t i = 0; i < n; ++i) {
+        uint32_t d = (uint32_t)v[i] - prec;
+        int l = svb_lunghezza(d);
+        prec = (uint32_t)v[i];
+        if (out) {
+            out[i >> 2] |= (uint8_t)((l - 1) << ((i & 3) * 2));
+            memcpy(out + pos, &d, l); // little-endian, come lo snapshot
+        }
+        pos += l;
+    }
+    return pos;
+}
+
+static void svb_decodifica(const uint8_t *riga, int n, int *out) {
+    const uint8_t *controlli = riga, *dati = riga + (n + 3) / 4;
+    uint32_t prec = 0;
+    for (int i = 0; i < n; ++i) {
+        int l = ((controlli[i >> 2] >> ((i & 3) * 2)) & 3) + 1;
+        uint32_t d = 0;
+        memcpy(&d, dati, l);
+        dati += l;
+        prec += d;
+        out[i] = (int)prec;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Scrive sempre gruppi interi di 4 valori e legge 16 byte alla volta: 'out'
+// ha 3 interi di margine e 'compressi' 16 byte di coda.
+__attribute__((target("ssse3")))
+static void svb_decodifica_ssse3(const uint8_t *riga, int n, int *out) {
+    const uint8_t *controlli = riga, *dati = riga + (n + 3) / 4;
+    __m128i prec = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 4) {
+        uint8_t c = *controlli++;
+        __m128i x = _mm_loadu_si128((const __m128i *)dati);
+        x = _mm_shuffle_epi8(x, _mm_loadu_si128((const __m128i *)S_SVB_MASCHERE[c]));
+        dati += S_SVB_LUNGHEZZE[c];
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, prec);
+        _mm_storeu_si128((__m128i *)(out + i), x);
+        prec = _mm_shuffle_epi32(x, 0xFF);
+    }
+}
+#endif
+
+// Coprotagonisti dell'attore v (g->offsets[v+1] - g->offsets[v] elementi):
+// direttamente nel CSR, o decodificati in 'buf' se il grafo è compresso.
+static inline const int *grafo_vicini(const grafo_t *g, int v, int *buf) {
+    if (!g->compressi) return g->vicini + g->offsets[v];
+    int n = (int)(g->offsets[v + 1] - g->offsets[v]);
+#if defined(__x86_64__) || defined(__i386__)
+    if (S_SVB_SIMD) {
+        svb_decodifica_ssse3(g->compressi + g->posizioni[v], n, buf);
+        return buf;
+    }
+#endif
+    svb_decodifica(g->compressi + g->posizioni[v], n, buf);
+    return buf;
+}
+
+static int confronta_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Comprime le liste di adiacenza e rilascia il CSR originale. Va chiamata dopo
+// tutti gli usi di g->vicini del caricamento (componenti, indice 2-hop).
+void grafo_comprimi(grafo_t *g) {
+    svb_inizializza();
+    int n = g->tota_attori;
+    uint64_t *posizioni = (uint64_t *)arena_alloca(&g->arena, (n + 1) * sizeof(uint64_t));
+    int grado_max = 0;
+    for (int v = 0; v < n; ++v) {
+        int64_t grado = g->offsets[v + 1] - g->offsets[v];
+        if (grado > grado_max) grado_max = (int)grado;
+    }
+    // Le righe di grafo.txt sono già ordinate; le altre si ordinano in una copia
+    int *riga = (int *)xmalloc((grado_max + 1) * sizeof(int));
+    for (int passo = 0; passo < 2; ++passo) {
+        uint8_t *dati = passo ? (uint8_t *)g->compressi : NULL;
+        uint64_t pos = 0;
+        for (int v = 0; v < n; ++v) {
+            int64_t grado = g->offsets[v + 1] - g->offsets[v];
+            const int *lista = g->vicini + g->offsets[v];
+            for (int64_t i = 1; i < grado; ++i) {
+                if (lista[i - 1] > lista[i]) {
+                    memcpy(riga, lista, grado * sizeof(int));
+                    qsort(riga, grado, sizeof(int), confronta_int);
+                    lista = riga;
+                    break;
+                }
+            }
+            posizioni[v] = pos;
+            pos += svb_codifica(lista, grado, dati ? dati + pos : NULL);
+        }
+        posizioni[n] = pos;
+        if (!passo) {
+            // 16 byte azzerati in coda per le letture a 16 byte della decodifica SIMD
+            g->compressi = (uint8_t *)arena_alloca(&g->arena, pos + 16);
+        }
+    }
+    free(riga);
+
+    size_t dim_originale = g->offsets[n] * sizeof(int);
+    if (g->snapshot) {
+        // Le pagine della mappatura non servono più: si lasciano alla cache del kernel
+        uintptr_t pagina = (uintptr_t)sysconf(_SC_PAGESIZE);
+        uintptr_t inizio = ((uintptr_t)g->vicini + pagina - 1) & ~(pagina - 1);
+        uintptr_t fine = ((uintptr_t)g->vicini + dim_originale) & ~(pagina - 1);
+        if (fine > inizio) madvise((void *)inizio, fine - inizio, MADV_DONTNEED);
+    } else {
+        arena_libera(&g->arena, g->vicini);
+    }
+    g->vicini = NULL;
+    g->posizioni = posizioni;
+    g->grado_max = grado_max;
+    fprintf(stderr, "Adiacenze compresse: %.1f MB invece di %.1f MB (%.2f byte per arco), decodifica %s\n",
+            (posizioni[n] + (n + 1) * sizeof(uint64_t)) / (1024.0 * 1024.0), dim_originale / (1024.0 * 1024.0),
+            g->offsets[n] ? (double)posizioni[n] / g->offsets[n] : 0.0, S_SVB_SIMD ? "SSSE3" : "scalare");
+}
+
+// --- Funzioni Memoria di Lavoro (per BFS) ---
+bfs_scratch_t *bfs_scratch_create(const grafo_t *g) {
+    int tota_attori = g->tota_attori;
+    bfs_scratch_t *sc = (bfs_scratch_t *)xmalloc(sizeof(bfs_scratch_t));
+    sc->arena = (arena_t){ 0 };
+    sc->visitato = (uint32_t *)arena_alloca(&sc->arena, tota_attori * sizeof(uint32_t));
+    sc->parent = (int *)arena_alloca(&sc->arena, tota_attori * sizeof(int));
+    sc->coda = (int *)arena_alloca(&sc->arena, tota_attori * sizeof(int));
+    sc->generazione = 0;
+    sc->dist_hub = NULL;
+    sc->vicini = g->compressi ? (int *)arena_alloca(&sc->arena, (g->grado_max + 3) * sizeof(int)) : NULL;
+    return sc;
+}
+
+// Prepara il blocco per una nuova query e restituisce la generazione da usare.
+// Ogni query riserva due valori consecutivi (gen, gen+1): la ricerca bidirezionale
+// marca con gen i nodi scoperti dalla sorgente e con gen+1 quelli scoperti dalla destinazione.
+uint32_t bfs_scratch_new_query(bfs_scratch_t *sc, int tota_attori) {
+    if (sc->generazione > UINT32_MAX - 2) {
+        // Overflow del contatore: unico caso in cui serve azzerare.
+        memset(sc->visitato, 0, tota_attori * sizeof(uint32_t));
+        sc->generazione = 0;
+    }
+    sc->generazione += 2;
+    return sc->generazione - 1;
+}
+
+void bfs_scratch_destroy(bfs_scratch_t *sc) {
+    arena_destroy(&sc->arena);
+    free(sc);
+}
+
+// Scrive in sc->coda il cammino start -> end passante per l'arco (meet_f, meet_b):
+// meet_f risale tramite 'parent' fino alla sorgente, meet_b fino alla destinazione
+// (-1 se la ricerca è unidirezionale). Restituisce il numero di nodi del cammino.
+static int bfs_ricostruisci_cammino(bfs_scratch_t *sc, int meet_f, int meet_b) {
+    int *path = sc->coda; // A ricerca terminata la coda non serve più
+    int path_len = 0;
+    for (int v = meet_f; v != -1; v = sc->parent[v]) {
+        path[path_len++] = v;
+    }
+    for (int i = 0, j = path_len - 1; i < j; ++i, --j) {
+        int tmp = path[i]; path[i] = path[j]; path[j] = tmp;
+    }
+    for (int v = meet_b; v != -1; v = sc->parent[v]) {
+        path[path_len++] = v;
+    }
+    return path_len;
+}
+
+// Un lato della ricerca (sorgente o destinazione). Finché la frontiera è piccola
+// il lato usa una coda in sc->coda: quella della sorgente cresce dall'inizio,
+// quella della destinazione dalla fine (elemento i in base[i * passo]); poiché
+// ogni nodo è scoperto da un solo lato prima dell'incontro, insieme non superano
+// mai tota_attori elementi. Quando la frontiera diventa grande il lato passa
+// alle bitmap del team parallelo e ci resta fino alla fine della query.
+typedef struct {
+    int *base;
+    int passo;                  // +1 per la sorgente, -1 per la destinazione
+    int head, tail;             // la frontiera corrente è [head, tail)
+    uint32_t marca;             // generazione usata da questo lato
+    int parallelo;              // 1 se la frontiera è nelle bitmap del team
+    int bottom_up;              // direzione dell'ultimo livello parallelo
+    int64_t dim_frontiera;      // nodi in frontiera (solo in modalità parallela)
+    int64_t archi_frontiera;    // somma dei gradi della frontiera (m_f)
+    int64_t archi_inesplorati;  // somma dei gradi dei nodi non visitati (m_u)
+} bfs_lato_t;
+
+static int64_t bfs_lato_dimensione(const bfs_lato_t *lato) {
+    return lato->parallelo ? lato->dim_frontiera : lato->tail - lato->head;
+}
+
+static void bfs_lato_init(bfs_lato_t *lato, int *base, int passo, uint32_t marca,
+                          bfs_scratch_t *sc, int radice) {
+    memset(lato, 0, sizeof(*lato));
+    lato->base = base;
+    lato->passo = passo;
+    lato->marca = marca;
+    lato->base[lato->tail++ * lato->passo] = radice;
+    sc->visitato[radice] = marca;
+    sc->parent[radice] = -1; // -1 indica nessun parente
+}
+
+// Espande un intero livello del lato 'lato' scorrendo la sua coda. Se trova
+// un nodo già scoperto dall'altro lato si ferma e restituisce 1, con *da
+// (nodo di questo lato) e *verso (nodo dell'altro lato) estremi dell'arco di incontro.
+static int bfs_espandi_livello(const grafo_t *g, bfs_scratch_t *sc, bfs_lato_t *lato,
+                               uint32_t marca_altro, int *da, int *verso, bfs_stats_t *stats) {
+    int fine_livello = lato->tail;
+    while (lato->head < fine_livello) {
+        int current_id = lato->base[lato->head++ * lato->passo];
+        stats->nodi_espansi++;
+        int64_t grado = g->offsets[current_id + 1] - g->offsets[current_id];
+        const int *vicini = grafo_vicini(g, current_id, sc->vicini);
+        stats->archi_esaminati += grado;
+        for (int64_t i = 0; i < grado; ++i) {
+            int neighbor_id = vicini[i];
+            uint32_t m = sc->visitato[neighbor_id];
+            if (m == lato->marca) continue; // Già esplorato da questo lato
+            if (m == marca_altro) {
+                *da = current_id;
+                *verso = neighbor_id;
+                return 1;
+            }
+            sc->visitato[neighbor_id] = lato->marca;
+            sc->parent[neighbor_id] = current_id;
+            lato->base[lato->tail++ * lato->passo] = neighbor_id;
+        }
+    }
+    return 0;
+}
+
+// --- BFS Parallela (direction-optimizing) ---
+// Un livello è espanso da tutti i thread del team in modo sincrono. In top-down
+// ogni nodo della frontiera scandisce i suoi vicini e li reclama con un
+// fetch_or atomico sulla bitmap dei visitati; in bottom-up ogni nodo non
+// visitato cerca un vicino nella frontiera e si ferma al primo trovato.
+// La direzione segue l'euristica di Beamer: si passa a bottom-up quando
+// gli archi della frontiera superano archi_inesplorati / ALPHA, e si torna
+// a top-down quando la frontiera scende sotto tota_attori / BETA.
+#define BFS_PAR_ALPHA 14
+#define BFS_PAR_BETA 24
+#define BFS_PAR_MIN_FRONTIERA 4096  // sotto questa soglia la BFS resta seriale
+#define BFS_PAR_BLOCCO 64           // parole di bitmap per blocco di lavoro (4096 nodi)
+
+#define BITMAP_TEST(bm, v) (((bm)[(v) >> 6] >> ((v) & 63)) & 1)
+
+// Esegue sui blocchi di lavoro, presi dinamicamente da un contatore atomico,
+// il compito corrente del team. Chiamata sia dal leader sia dagli helper.
+static void bfs_team_esegui(bfs_team_t *team, int *buf) {
+    const grafo_t *g = team->g;
+    bfs_scratch_t *sc = team->sc;
+    int64_t n_prossima = 0, m_prossima = 0, archi_esaminati = 0;
+    size_t blocco;
+
+    while ((blocco = __atomic_fetch_add(&team->prossimo_blocco, 1, __ATOMIC_RELAXED)) * BFS_PAR_BLOCCO < team->parole) {
+        if (__atomic_load_n(&team->trovato, __ATOMIC_RELAXED)) break;
+        size_t w_inizio = blocco * BFS_PAR_BLOCCO;
+        size_t w_fine = w_inizio + BFS_PAR_BLOCCO < team->parole ? w_inizio + BFS_PAR_BLOCCO : team->parole;
+
+        for (size_t w = w_inizio; w < w_fine; ++w) {
+            if (team->compito == TEAM_INIT_VISITATI) {
+                // Costruisce la bitmap dei visitati dalle marcature di generazione
+                uint64_t parola = 0;
+                for (int b = 0; b < 64; ++b) {
+                    int64_t v = (int64_t)w * 64 + b;
+                    if (v < g->tota_attori && sc->visitato[v] == team->marca) {
+                        parola |= 1ULL << b;
+                        m_prossima += g->offsets[v + 1] - g->offsets[v];
+                    }
+                }
+                team->visitati[w] = parola;
+
+            } else if (team->compito == TEAM_TOP_DOWN) {
+                uint64_t parola = team->frontiera[w];
+                while (parola) {
+                    int u = (int)(w * 64 + __builtin_ctzll(parola));
+                    parola &= parola - 1;
+                    int64_t grado = g->offsets[u + 1] - g->offsets[u];
+                    const int *vicini = grafo_vicini(g, u, buf);
+                    archi_esaminati += grado;
+                    for (int64_t i = 0; i < grado; ++i) {
+                        int v = vicini[i];
+                        uint64_t bit = 1ULL << (v & 63);
+                        if (__atomic_load_n(&team->visitati[v >> 6], __ATOMIC_RELAXED) & bit) continue;
+                        if (__atomic_load_n(&sc->visitato[v], __ATOMIC_RELAXED) == team->marca_altro) {
+                            int atteso = 0;
+                            if (__atomic_compare_exchange_n(&team->trovato, &atteso, 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                                team->meet_da = u;
+                                team->meet_verso = v;
+                            }
+                            break;
+                        }
+                        if (__atomic_fetch_or(&team->visitati[v >> 6], bit, __ATOMIC_RELAXED) & bit) continue;
+                        // Questo thread ha reclamato v: è l'unico a scriverne parent e marca
+                        sc->parent[v] = u;
+                        __atomic_store_n(&sc->visitato[v], team->marca, __ATOMIC_RELAXED);
+                        __atomic_fetch_or(&team->prossima[v >> 6], bit, __ATOMIC_RELAXED);
+                        n_prossima++;
+                        m_prossima += g->offsets[v + 1] - g->offsets[v];
+                    }
+                }
+
+            } else { // TEAM_BOTTOM_UP: le parole del blocco appartengono solo a questo thread
+                uint64_t non_visitati = ~team->visitati[w];
+                while (non_visitati) {
+                    int64_t v = (int64_t)w * 64 + __builtin_ctzll(non_visitati);
+                    non_visitati &= non_visitati - 1;
+                    if (v >= g->tota_attori) break;
+                    int64_t grado = g->offsets[v + 1] - g->offsets[v];
+                    const int *vicini = grafo_vicini(g, (int)v, buf);
+                    for (int64_t i = 0; i < grado; ++i) {
+                        int u = vicini[i];
+                        archi_esaminati++;
+                        if (!BITMAP_TEST(team->frontiera, u)) continue;
+                        if (sc->visitato[v] == team->marca_altro) {
+                            int atteso = 0;
+                            if (__atomic_compare_exchange_n(&team->trovato, &atteso, 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                                team->meet_da = u;
+                                team->meet_verso = (int)v;
+                            }
+                            break;
+                        }
+                        sc->parent[v] = u;
+                        sc->visitato[v] = team->marca;
+                        team->visitati[w] |= 1ULL << (v & 63);
+                        team->prossima[w] |= 1ULL << (v & 63);
+                        n_prossima++;
+                        m_prossima += g->offsets[v + 1] - g->offsets[v];
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    __atomic_fetch_add(&team->n_prossima, n_prossima, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&team->m_prossima, m_prossima, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&team->archi_esaminati, archi_esaminati, __ATOMIC_RELAXED);
+}
+
+// Corpo dei thread helper: attendono un compito, lo eseguono e si sincronizzano col leader.
+// Con il grafo compresso ogni helper ha il proprio buffer per decodificare le liste.
+static void *bfs_team_thread_func(void *arg) {
+    bfs_team_t *team = (bfs_team_t *)arg;
+    int *buf = NULL;
+    while (1) {
+        pthread_barrier_wait(&team->inizio);
+        if (team->compito == TEAM_STOP) break;
+        if (!buf && team->g->compressi) buf = (int *)xmalloc((team->g->grado_max + 3) * sizeof(int));
+        bfs_team_esegui(team, buf);
+        pthread_barrier_wait(&team->fine);
+    }
+    free(buf);
+    return NULL;
+}
+
+// Eseguito dal leader (il thread BFS che possiede il team): avvia il compito
+// su tutti i thread, vi partecipa e attende che tutti abbiano finito.
+static void bfs_team_lancia(bfs_team_t *team, int compito) {
+    team->compito = compito;
+    team->prossimo_blocco = 0;
+    team->n_prossima = 0;
+    team->m_prossima = 0;
+    team->archi_esaminati = 0;
+    pthread_barrier_wait(&team->inizio);
+    bfs_team_esegui(team, team->sc->vicini);
+    pthread_barrier_wait(&team->fine);
+}
+
+// Crea il team con num_thread thread complessivi (leader incluso).
+// Restituisce NULL se num_thread <= 1: in tal caso ogni BFS resta seriale.
+bfs_team_t *bfs_team_create(int num_thread, int tota_attori) {
+    if (num_thread <= 1) return NULL;
+    bfs_team_t *team = (bfs_team_t *)xmalloc(sizeof(bfs_team_t));
+    memset(team, 0, sizeof(*team));
+    team->num_thread = num_thread;
+    team->parole = ((size_t)tota_attori + 63) / 64;
+    team->frontiera = (uint64_t *)arena_alloca(&team->arena, team->parole * sizeof(uint64_t));
+    team->prossima = (uint64_t *)arena_alloca(&team->arena, team->parole * sizeof(uint64_t));
+    team->visitati = (uint64_t *)arena_alloca(&team->arena, team->parole * sizeof(uint64_t));
+    if (pthread_mutex_init(&team->occupato, NULL) != 0 ||
+        pthread_barrier_init(&team->inizio, NULL, num_thread) != 0 ||
+        pthread_barrier_init(&team->fine, NULL, num_thread) != 0) {
+        perror("inizializzazione sincronizzazione del team fallita");
+        fallisci();
+    }
+    team->tids = (pthread_t *)xmalloc((num_thread - 1) * sizeof(pthread_t));
+    for (int i = 0; i < num_thread - 1; ++i) {
+        if (pthread_create(&team->tids[i], NULL, bfs_team_thread_func, team) != 0) {
+            perror("pthread_create per bfs_team fallito");
+            fallisci();
+        }
+    }
+    return team;
+}
+
+void bfs_team_destroy(bfs_team_t *team) {
+    if (!team) return;
+    pthread_mutex_lock(&team->occupato); // Attende l'eventuale query che lo sta usando
+    team->compito = TEAM_STOP;
+    pthread_barrier_wait(&team->inizio);
+    for (int i = 0; i < team->num_thread - 1; ++i) {
+        pthread_join(team->tids[i], NULL);
+    }
+    pthread_mutex_unlock(&team->occupato);
+    pthread_mutex_destroy(&team->occupato);
+    pthread_barrier_destroy(&team->inizio);
+    pthread_barrier_destroy(&team->fine);
+    free(team->tids);
+    arena_destroy(&team->arena);
+    free(team);
+}
+
+// Porta il lato dalla coda alle bitmap del team (che il chiamante ha già acquisito).
+static void bfs_team_attiva(bfs_team_t *team, const grafo_t *g, bfs_scratch_t *sc,
+                            bfs_lato_t *lato, uint32_t marca_altro) {
+    team->g = g;
+    team->sc = sc;
+    team->marca = lato->marca;
+    team->marca_altro = marca_altro;
+    team->trovato = 0;
+    memset(team->frontiera, 0, team->parole * sizeof(uint64_t));
+    memset(team->prossima, 0, team->parole * sizeof(uint64_t));
+
+    bfs_team_lancia(team, TEAM_INIT_VISITATI);
+    int64_t archi_visitati = team->m_prossima;
+
+    lato->archi_frontiera = 0;
+    for (int i = lato->head; i < lato->tail; ++i) {
+        int v = lato->base[i * lato->passo];
+        team->frontiera[v >> 6] |= 1ULL << (v & 63);
+        lato->archi_frontiera += g->offsets[v + 1] - g->offsets[v];
+    }
+    lato->dim_frontiera = lato->tail - lato->head;
+    lato->archi_inesplorati = g->offsets[g->tota_attori] - archi_visitati;
+    lato->bottom_up = 0;
+    lato->parallelo = 1;
+}
+
+// Espande un livello del lato con il team, scegliendo la direzione.
+static int bfs_team_espandi_livello(bfs_team_t *team, const grafo_t *g, bfs_lato_t *lato,
+                                    int *da, int *verso, bfs_stats_t *stats) {
+    if (!lato->bottom_up && lato->archi_frontiera > lato->archi_inesplorati / BFS_PAR_ALPHA) {
+        lato->bottom_up = 1;
+    } else if (lato->bottom_up && lato->dim_frontiera < g->tota_attori / BFS_PAR_BETA) {
+        lato->bottom_up = 0;
+    }
+    stats->nodi_espansi += lato->dim_frontiera;
+
+    bfs_team_lancia(team, lato->bottom_up ? TEAM_BOTTOM_UP : TEAM_TOP_DOWN);
+    stats->archi_esaminati += team->archi_esaminati;
+    if (team->trovato) {
+        *da = team->meet_da;
+        *verso = team->meet_verso;
+        return 1;
+    }
+
+    uint64_t *tmp = team->frontiera;
+    team->frontiera = team->prossima;
+    team->prossima = tmp;
+    memset(team->prossima, 0, team->parole * sizeof(uint64_t));
+    lato->dim_frontiera = team->n_prossima;
+    lato->archi_frontiera = team->m_prossima;
+    lato->archi_inesplorati -= team->m_prossima;
+    return 0;
+}
+
+// Stato di una singola query, condiviso dai due lati.
+typedef struct {
+    const grafo_t *g;
+    bfs_scratch_t *sc;
+    bfs_team_t *team;
+    int team_acquisito;
+    bfs_stats_t *stats;
+} bfs_query_t;
+
+// Espande un livello di 'lato', passando al team parallelo se la frontiera è
+// abbastanza grande e il team è libero (altrimenti si prosegue in seriale).
+static int bfs_espandi(bfs_query_t *q, bfs_lato_t *lato, uint32_t marca_altro, int *da, int *verso) {
+    int64_t dim_frontiera = bfs_lato_dimensione(lato);
+    if (dim_frontiera > q->stats->frontiera_max) q->stats->frontiera_max = dim_frontiera;
+    if (!lato->parallelo && q->team && !q->team_acquisito) {
+        int64_t soglia = q->g->tota_attori / 64 > BFS_PAR_MIN_FRONTIERA ? q->g->tota_attori / 64 : BFS_PAR_MIN_FRONTIERA;
+        if (lato->tail - lato->head >= soglia && pthread_mutex_trylock(&q->team->occupato) == 0) {
+            q->team_acquisito = 1;
+            bfs_team_attiva(q->team, q->g, q->sc, lato, marca_altro);
+        }
+    }
+    if (lato->parallelo) {
+        return bfs_team_espandi_livello(q->team, q->g, lato, da, verso, q->stats);
+    }
+    return bfs_espandi_livello(q->g, q->sc, lato, marca_altro, da, verso, q->stats);
+}
+
+// Calcola il cammino minimo con la modalità scelta all'avvio. Restituisce la
+// lunghezza (in nodi) del cammino scritto in sc->coda, 0 se non esiste.
+//
+// La ricerca unidirezionale è il caso particolare in cui il lato della
+// destinazione contiene solo end_id e non viene mai espanso: la visita si
+// ferma quando end_id viene scoperto.
+// La ricerca bidirezionale espande a ogni passo un livello del lato con la
+// frontiera più piccola e si ferma al primo arco che collega le due visite.
+// Poiché fino al livello precedente le visite erano disgiunte, il primo
+// incontro individua già un cammino di lunghezza minima.
+int bfs_cerca_cammino(const grafo_t *g, bfs_scratch_t *sc, bfs_team_t *team, int modalita,
+                      int start_id, int end_id, bfs_stats_t *stats) {
+    uint32_t gen = bfs_scratch_new_query(sc, g->tota_attori);
+    if (start_id == end_id) {
+        sc->parent[start_id] = -1;
+        return bfs_ricostruisci_cammino(sc, start_id, -1);
+    }
+
+    bfs_query_t q = { g, sc, team, 0, stats };
+    bfs_lato_t fwd, bwd;
+    bfs_lato_init(&fwd, sc->coda, 1, gen, sc, start_id);
+    bfs_lato_init(&bwd, sc->coda + g->tota_attori - 1, -1, gen + 1, sc, end_id);
+
+    int path_len = 0;
+    int da, verso;
+    while (bfs_lato_dimensione(&fwd) > 0 && bfs_lato_dimensione(&bwd) > 0) {
+        if (modalita == BFS_UNIDIREZIONALE || bfs_lato_dimensione(&fwd) <= bfs_lato_dimensione(&bwd)) {
+            if (bfs_espandi(&q, &fwd, bwd.marca, &da, &verso)) {
+                path_len = bfs_ricostruisci_cammino(sc, da, verso);
+                break;
+            }
+        } else {
+            if (bfs_espandi(&q, &bwd, fwd.marca, &da, &verso)) {
+                path_len = bfs_ricostruisci_cammino(sc, verso, da);
+                break;
+            }
+        }
+    }
+    if (q.team_acquisito) {
+        pthread_mutex_unlock(&team->occupato);
+    }
+    return path_len;
+}
+
+
+// --- Statistiche di Funzionamento ---
+// Contatori globali aggiornati dai worker con operazioni atomiche, senza lock:
+// numero di richieste per via di risoluzione, lavoro delle visite e istogrammi
+// delle latenze. Il thread dei segnali li scrive su richiesta (SIGUSR1) su
+// stderr o nel file di -T, mentre i worker continuano a lavorare.
+//
+// Gli istogrammi sono log-lineari: ogni potenza di due è divisa in
+// ISTO_SOTTO classi, quindi un percentile ha un errore relativo massimo di
+// 1/ISTO_SOTTO con una dimensione fissa e un solo incremento per misura.
+#define ISTO_SOTTO 8
+#define ISTO_CLASSI (64 * ISTO_SOTTO)
+#define STAT_LUNGHEZZE 16   // lunghezze dei cammini contate una per una; l'ultima raccoglie le maggiori
+
+typedef struct {
+    uint64_t conteggi[ISTO_CLASSI];
+    uint64_t totale, somma, massimo;
+} istogramma_t;
+
+typedef struct {
+    // Caricamento del grafo
+    const char *origine;
+    double secondi_caricamento;
+    uint64_t byte_caricati, attori, archi;
+    uint64_t ricariche, ricariche_fallite;  // SIGHUP, vedi "Ricarica a Caldo"
+    // Richieste
+    uint64_t richieste, per_via[VIA_NUM], senza_cammino;
+    uint64_t lunghezze[STAT_LUNGHEZZE];
+    uint64_t nodi_espansi, archi_esaminati, frontiera_max;
+    uint64_t passi_annotati, ns_annotazioni;   // titoli in comune (-P)
+    istogramma_t totale;        // dalla lettura alla risposta (ns)
+    istogramma_t servizio;      // dal prelievo alla risposta (ns)
+    istogramma_t cpu;           // CPU del worker (ns)
+} statistiche_t;
+
+static statistiche_t S_STATISTICHE;
+static const char *S_FILE_STATISTICHE; // NULL: le statistiche di SIGUSR1 vanno su stderr
+
+static uint64_t ns_da_timespec(const struct timespec *t) {
+    return (uint64_t)t->tv_sec * 1000000000ULL + (uint64_t)t->tv_nsec;
+}
+
+uint64_t adesso_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ns_da_timespec(&t);
+}
+
+static int isto_classe(uint64_t v) {
+    if (v < ISTO_SOTTO) return (int)v;
+    int e = 63 - __builtin_clzll(v); // e >= 3
+    return (e - 2) * ISTO_SOTTO + (int)((v >> (e - 3)) & (ISTO_SOTTO - 1));
+}
+
+// Valore massimo della classe k
+static uint64_t isto_limite(int k) {
+    if (k < ISTO_SOTTO) return (uint64_t)k;
+    int e = k / ISTO_SOTTO + 2, sotto = k % ISTO_SOTTO;
+    return ((uint64_t)(ISTO_SOTTO + sotto + 1) << (e - 3)) - 1;
+}
+
+static void isto_registra(istogramma_t *h, uint64_t v) {
+    __atomic_add_fetch(&h->conteggi[isto_classe(v)], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->totale, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->somma, v, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&h->massimo, __ATOMIC_RELAXED);
+    while (v > max && !__atomic_compare_exchange_n(&h->massimo, &max, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Valore sotto cui cade la frazione 'p' delle misure (per eccesso, entro la classe)
+static uint64_t isto_percentile(const istogramma_t *h, double p) {
+    uint64_t totale = 0;
+    for (int k = 0; k < ISTO_CLASSI; ++k) totale += __atomic_load_n(&h->conteggi[k], __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&h->massimo, __ATOMIC_RELAXED);
+    if (totale == 0) return 0;
+    uint64_t soglia = (uint64_t)(p * totale + 0.999999), cumulati = 0;
+    if (soglia == 0) soglia = 1;
+    for (int k = 0; k < ISTO_CLASSI; ++k) {
+        cumulati += __atomic_load_n(&h->conteggi[k], __ATOMIC_RELAXED);
+        if (cumulati >= soglia) return isto_limite(k) < max ? isto_limite(k) : max;
+    }
+    return max;
+}
+
+static void isto_stampa(FILE *fp, const char *nome, const istogramma_t *h) {
+    uint64_t n = __atomic_load_n(&h->totale, __ATOMIC_RELAXED);
+    double media = n ? (double)__atomic_load_n(&h->somma, __ATOMIC_RELAXED) / n : 0;
+    fprintf(fp, "%-9s media %.3f ms, p50 %.3f ms, p99 %.3f ms, p999 %.3f ms, max %.3f ms\n", nome,
+            media / 1e6, isto_percentile(h, 0.50) / 1e6, isto_percentile(h, 0.99) / 1e6,
+            isto_percentile(h, 0.999) / 1e6, __atomic_load_n(&h->massimo, __ATOMIC_RELAXED) / 1e6);
+}
+
+// Registra il caricamento del grafo, all'avvio e a ogni ricarica: le
+// statistiche descrivono l'ultima versione caricata.
+void statistiche_caricamento(const char *origine, double secondi, uint64_t byte, const grafo_t *g) {
+    statistiche_t *st = &S_STATISTICHE;
+    st->origine = origine;
+    st->secondi_caricamento = secondi;
+    st->byte_caricati = byte;
+    st->attori = g->tota_attori;
+    st->archi = g->offsets[g->tota_attori];
+    double s = secondi > 0 ? secondi : 1e-9;
+    fprintf(stderr, "Caricamento da %s: %" PRIu64 " attori, %" PRIu64 " archi, %.1f MB in %.2f s "
+            "(%.0f MB/s, %.1f milioni di archi/s)\n", origine, st->attori, st->archi,
+            byte / (1024.0 * 1024.0), secondi, byte / (1024.0 * 1024.0) / s, st->archi / s / 1e6);
+}
+
+// Aggiunge il lavoro di una visita (BFS di una richiesta o MS-BFS di un batch).
+void statistiche_visita(long nodi_espansi, long archi_esaminati, long frontiera_max) {
+    statistiche_t *st = &S_STATISTICHE;
+    __atomic_add_fetch(&st->nodi_espansi, (uint64_t)nodi_espansi, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&st->archi_esaminati, (uint64_t)archi_esaminati, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&st->frontiera_max, __ATOMIC_RELAXED);
+    while ((uint64_t)frontiera_max > max &&
+           !__atomic_compare_exchange_n(&st->frontiera_max, &max, (uint64_t)frontiera_max, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Aggiunge l'annotazione dei titoli in comune di un cammino di 'passi' passi.
+void statistiche_annotazione(int passi, uint64_t ns) {
+    statistiche_t *st = &S_STATISTICHE;
+    __atomic_add_fetch(&st->passi_annotati, (uint64_t)passi, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&st->ns_annotazioni, ns, __ATOMIC_RELAXED);
+}
+
+// Registra l'esito di una richiesta; path_len è -1 se la richiesta non era valida.
+void statistiche_richiesta(const richiesta_t *req, const metriche_t *m, int path_len,
+                           uint64_t cpu_ns, uint64_t servizio_ns, uint64_t fine_ns) {
+    statistiche_t *st = &S_STATISTICHE;
+    __atomic_add_fetch(&st->richieste, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&st->per_via[m->via], 1, __ATOMIC_RELAXED);
+    if (path_len == 0) {
+        __atomic_add_fetch(&st->senza_cammino, 1, __ATOMIC_RELAXED);
+    } else if (path_len > 0) {
+        int k = path_len - 1 < STAT_LUNGHEZZE - 1 ? path_len - 1 : STAT_LUNGHEZZE - 1;
+        __atomic_add_fetch(&st->lunghezze[k], 1, __ATOMIC_RELAXED);
+    }
+    if (m->via == VIA_BFS) statistiche_visita(m->bfs.nodi_espansi, m->bfs.archi_esaminati, m->bfs.frontiera_max);
+    isto_registra(&st->servizio, servizio_ns);
+    isto_registra(&st->cpu, cpu_ns);
+    if (req->arrivo_ns && fine_ns > req->arrivo_ns) isto_registra(&st->totale, fine_ns - req->arrivo_ns);
+}
+
+// Memoria in pagine grandi del processo, trasparenti ed esplicite, in MB (0 se non si sa).
+static double memoria_pagine_grandi_mb(void) {
+    FILE *fp = fopen("/proc/self/smaps_rollup", "r");
+    if (!fp) return 0.0;
+    char riga[256];
+    long kb, totale = 0;
+    while (fgets(riga, sizeof(riga), fp)) {
+        if (sscanf(riga, "AnonHugePages: %ld", &kb) == 1 || sscanf(riga, "Private_Hugetlb: %ld", &kb) == 1 ||
+            sscanf(riga, "Shared_Hugetlb: %ld", &kb) == 1) {
+            totale += kb;
+        }
     }
-    return fp;
+    fclose(fp);
+    return totale / 1024.0;
 }
 
-// --- Funzioni Line Buffer (Produttore-Consumatore) ---
-line_buffer_t* line_buffer_init(int capacity) {
-    line_buffer_t *lb = (line_buffer_t*)xmalloc(sizeof(line_buffer_t));
-    lb->buffer = (char**)xmalloc(capacity * sizeof(char*));
-    lb->capacity = capacity;
-    lb->count = 0;
-    lb->head = 0;
-    lb->tail = 0;
-    lb->done_producing = 0;
-    if (pthread_mutex_init(&lb->mutex, NULL) != 0) {
-        perror("pthread_mutex_init for line_buffer"); exit(EXIT_FAILURE);
+void statistiche_stampa(FILE *fp) {
+    static const char *nomi_via[VIA_NUM] = { "non valide", "componenti", "cache", "indice", "BFS", "batch" };
+    const statistiche_t *st = &S_STATISTICHE;
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    fprintf(fp, "=== Statistiche di cammini (pid %d) ===\n", (int)getpid());
+    // Memoria residente attuale: il massimo di getrusage è di solito quello del caricamento
+    long pagine_totali = 0, pagine_residenti = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        if (fscanf(statm, "%ld %ld", &pagine_totali, &pagine_residenti) != 2) pagine_residenti = 0;
+        fclose(statm);
+    }
+    fprintf(fp, "Processo: CPU utente %.2f s, sistema %.2f s, memoria attuale %.1f MB (%.1f MB in pagine grandi), massima %.1f MB\n",
+            ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6, ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6,
+            pagine_residenti * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0), memoria_pagine_grandi_mb(),
+            ru.ru_maxrss / 1024.0);
+    if (st->origine) {
+        fprintf(fp, "Caricamento: da %s, %" PRIu64 " attori, %" PRIu64 " archi, %.1f MB in %.2f s\n",
+                st->origine, st->attori, st->archi, st->byte_caricati / (1024.0 * 1024.0), st->secondi_caricamento);
+    }
+    uint64_t ricariche = __atomic_load_n(&st->ricariche, __ATOMIC_RELAXED);
+    uint64_t ricariche_fallite = __atomic_load_n(&st->ricariche_fallite, __ATOMIC_RELAXED);
+    if (ricariche || ricariche_fallite) {
+        fprintf(fp, "Ricariche: %" PRIu64 " riuscite, %" PRIu64 " non riuscite\n", ricariche, ricariche_fallite);
     }
-    if (pthread_cond_init(&lb->not_empty, NULL) != 0) {
-        perror("pthread_cond_init not_empty for line_buffer"); exit(EXIT_FAILURE);
+    uint64_t richieste = __atomic_load_n(&st->richieste, __ATOMIC_RELAXED);
+    fprintf(fp, "Richieste: %" PRIu64 " (", richieste);
+    for (int v = 0; v < VIA_NUM; ++v) {
+        fprintf(fp, "%s%s %" PRIu64, v ? ", " : "", nomi_via[v], __atomic_load_n(&st->per_via[v], __ATOMIC_RELAXED));
+    }
+    fprintf(fp, "), senza cammino %" PRIu64 "\n", __atomic_load_n(&st->senza_cammino, __ATOMIC_RELAXED));
+    fprintf(fp, "Visite: %" PRIu64 " nodi espansi, %" PRIu64 " archi esaminati, frontiera massima %" PRIu64 "\n",
+            __atomic_load_n(&st->nodi_espansi, __ATOMIC_RELAXED), __atomic_load_n(&st->archi_esaminati, __ATOMIC_RELAXED),
+            __atomic_load_n(&st->frontiera_max, __ATOMIC_RELAXED));
+    uint64_t passi_annotati = __atomic_load_n(&st->passi_annotati, __ATOMIC_RELAXED);
+    if (passi_annotati) {
+        fprintf(fp, "Titoli in comune: %" PRIu64 " passi annotati, %.2f us per passo\n", passi_annotati,
+                __atomic_load_n(&st->ns_annotazioni, __ATOMIC_RELAXED) / 1e3 / passi_annotati);
+    }
+    fprintf(fp, "Lunghezze:");
+    for (int k = 0; k < STAT_LUNGHEZZE; ++k) {
+        uint64_t n = __atomic_load_n(&st->lunghezze[k], __ATOMIC_RELAXED);
+        if (n) fprintf(fp, " %d%s:%" PRIu64, k, k == STAT_LUNGHEZZE - 1 ? "+" : "", n);
+    }
+    fprintf(fp, "\n");
+    isto_stampa(fp, "Totale:", &st->totale);
+    isto_stampa(fp, "Servizio:", &st->servizio);
+    isto_stampa(fp, "CPU:", &st->cpu);
+}
+
+// Scrive le statistiche nel file di -T (sostituendolo per intero con una
+// rename, così chi lo legge non vede mai un file a metà) o su stderr.
+void statistiche_scarica(void) {
+    if (!S_FILE_STATISTICHE) {
+        statistiche_stampa(stderr);
+        return;
+    }
+    char temporaneo[PATH_MAX];
+    snprintf(temporaneo, sizeof(temporaneo), "%s.tmp", S_FILE_STATISTICHE);
+    FILE *fp = fopen(temporaneo, "w");
+    if (!fp) {
+        fprintf(stderr, "Errore: impossibile scrivere %s: %s\n", temporaneo, strerror(errno));
+        return;
+    }
+    statistiche_stampa(fp);
+    if (fclose(fp) != 0 || rename(temporaneo, S_FILE_STATISTICHE) != 0) {
+        fprintf(stderr, "Errore: impossibile scrivere %s: %s\n", S_FILE_STATISTICHE, strerror(errno));
+    }
+}
+
+
+// --- Thread Gestore Segnali ---
+void *signal_handler_thread_func(void *arg) {
+    (void)arg;
+
+    sigset_t set;
+    int sig;
+
+    char pid_str[32];
+    snprintf(pid_str, sizeof(pid_str), "%d\n", getpid());
+    write(STDOUT_FILENO, pid_str, strlen(pid_str));
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGHUP);
+
+    while (1) {
+        if (sigwait(&set, &sig) != 0) {
+            if (errno == EINTR) continue;
+            perror("sigwait fallito");
+            break;
+        }
+
+        if (sig == SIGUSR1) {
+            statistiche_scarica();
+        } else if (sig == SIGHUP) {
+            pthread_mutex_lock(&S_SELF_PIPE_MUTEX);
+            int fase = S_PROGRAM_PHASE;
+            if (fase == PHASE_PIPE_READING) {
+                // Il main avvia la ricarica del grafo (vedi "Ricarica a Caldo")
+                char ricarica = 'r';
+                if (write(S_SELF_PIPE_FD[1], &ricarica, 1) < 0) {
+                }
+            }
+            pthread_mutex_unlock(&S_SELF_PIPE_MUTEX);
+            if (fase == PHASE_GRAPH_CONSTRUCTION) {
+                const char *msg = "Costruzione del grafo in corso, SIGHUP ignorato\n";
+                write(STDOUT_FILENO, msg, strlen(msg));
+            }
+        } else if (sig == SIGINT) {
+            pthread_mutex_lock(&S_SELF_PIPE_MUTEX);
+            int fase = S_PROGRAM_PHASE;
+            if (fase == PHASE_PIPE_READING) {
+                S_SHUTDOWN_REQUEST = 1; // Sblocca il lettore se è fermo sul pool pieno
+                // Self-pipe trick: notifica al main di terminare scrivendo un byte.
+                char dummy = 'q'; 
+                if (write(S_SELF_PIPE_FD[1], &dummy, 1) < 0) {
+                }
+            }
+            pthread_mutex_unlock(&S_SELF_PIPE_MUTEX);
+            if (fase != PHASE_GRAPH_CONSTRUCTION) {
+                break; // In PHASE_TERMINATION il main sta già terminando
+            } else {
+                const char *msg = "Costruzione del grafo in corso\n";
+                write(STDOUT_FILENO, msg, strlen(msg));
+            }
+        }
+    }
+    return NULL;
+}
+
+
+// --- Caricamento Parallelo dei File di Testo ---
+// nomi.txt e grafo.txt vengono mappati in memoria e divisi in blocchi di righe
+// complete, uno per thread. Ogni file è letto in due passate parallele: la
+// prima conta (righe o coprotagonisti) per sapere dove scrivere, la seconda
+// analizza i numeri e scrive direttamente nella posizione finale, senza copie
+// delle righe né lock.
+
+// Divide [dati, dati + dim) in n blocchi che iniziano sempre a inizio riga:
+// il blocco i va da confini[i] a confini[i + 1].
+static void dividi_in_righe(const char *dati, size_t dim, int n, const char **confini) {
+    confini[0] = dati;
+    confini[n] = dati + dim;
+    for (int i = 1; i < n; ++i) {
+        const char *p = dati + dim / n * i;
+        if (p < confini[i - 1]) p = confini[i - 1];
+        const char *nl = p < dati + dim ? memchr(p, '\n', dati + dim - p) : NULL;
+        confini[i] = nl ? nl + 1 : dati + dim;
+    }
+}
+
+// Un thread di esegui_in_parallelo lanciato durante una ricarica: arma un proprio
+// punto di ripresa, perché siglongjmp non può tornare nel thread del chiamante.
+typedef struct {
+    pthread_t tid;
+    void *(*f)(void *);
+    void *arg;
+    int ripresa;                // il chiamante ha un punto di ripresa armato
+    int fallito;                // il thread è tornato al suo punto di ripresa
+} compito_parallelo_t;
+
+static void *compito_parallelo_func(void *arg) {
+    compito_parallelo_t *c = (compito_parallelo_t *)arg;
+    sigjmp_buf ripresa;
+    if (c->ripresa) {
+        if (sigsetjmp(ripresa, 1)) {
+            S_RIPRESA = NULL;
+            c->fallito = 1;
+            return NULL;
+        }
+        S_RIPRESA = &ripresa;
+    }
+    c->f(c->arg);
+    S_RIPRESA = NULL;
+    return NULL;
+}
+
+// Esegue f su n thread, il thread i con argomento args + i * dim_arg, e li attende.
+// Se un thread fallisce durante una ricarica, fallisce il chiamante dopo il join.
+static void esegui_in_parallelo(int n, void *(*f)(void *), void *args, size_t dim_arg) {
+    compito_parallelo_t *compiti = (compito_parallelo_t *)calloc(n, sizeof(compito_parallelo_t));
+    if (!compiti) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    int creati = 0, fallito = 0;
+    for (; creati < n; ++creati) {
+        compito_parallelo_t *c = &compiti[creati];
+        c->f = f;
+        c->arg = (char *)args + creati * dim_arg;
+        c->ripresa = S_RIPRESA != NULL;
+        if (pthread_create(&c->tid, NULL, compito_parallelo_func, c) != 0) {
+            perror("pthread_create per il caricamento fallito");
+            fallito = 1;
+            break;
+        }
+    }
+    for (int i = 0; i < creati; ++i) {
+        pthread_join(compiti[i].tid, NULL);
+        fallito |= compiti[i].fallito;
+    }
+    free(compiti);
+    if (fallito) fallisci();
+}
+
+// Legge da *pp il prossimo intero della riga, saltando spazi e tabulazioni, e
+// lascia *pp dopo il token. Come atoi, un token non numerico vale 0.
+// Restituisce 0 (senza avanzare oltre il '\n') se la riga è finita.
+static inline int scan_intero(const char **pp, const char *fine, int *valore) {
+    const char *p = *pp;
+    while (p < fine && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    if (p == fine || *p == '\n') {
+        *pp = p;
+        return 0;
+    }
+    int negativo = (*p == '-');
+    if (negativo) p++;
+    unsigned int v = 0;
+    unsigned int cifra;
+    while (p < fine && (cifra = (unsigned int)(*p - '0')) < 10) {
+        v = v * 10 + cifra;
+        p++;
+    }
+    while (p < fine && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+    *valore = negativo ? -(int)v : (int)v;
+    *pp = p;
+    return 1;
+}
+
+// Restituisce la fine della riga che contiene p (il '\n' o la fine del blocco).
+static inline const char *fine_riga(const char *p, const char *fine) {
+    const char *nl = memchr(p, '\n', fine - p);
+    return nl ? nl : fine;
+}
+
+// Restituisce l'inizio della riga successiva a quella che contiene p.
+static inline const char *prossima_riga(const char *p, const char *fine) {
+    const char *nl = memchr(p, '\n', fine - p);
+    return nl ? nl + 1 : fine;
+}
+
+// Trova i due tab della riga [p, fr): restituisce 1 se il nome tra i due non è vuoto.
+static inline int campi_nomi(const char *p, const char *fr, const char **tab1, const char **tab2) {
+    *tab1 = memchr(p, '\t', fr - p);
+    *tab2 = *tab1 ? memchr(*tab1 + 1, '\t', fr - *tab1 - 1) : NULL;
+    return *tab2 && *tab2 > *tab1 + 1;
+}
+
+// nomi.txt, passo 1: conta le righe del blocco e i byte dei loro nomi.
+static void *nomi_conta_thread_func(void *arg) {
+    blocco_testo_t *b = (blocco_testo_t *)arg;
+    int64_t righe = 0, byte_nomi = 0;
+    for (const char *p = b->inizio; p < b->fine; ) {
+        const char *fr = fine_riga(p, b->fine);
+        const char *tab1, *tab2;
+        if (campi_nomi(p, fr, &tab1, &tab2)) byte_nomi += tab2 - tab1;
+        righe++;
+        p = fr < b->fine ? fr + 1 : b->fine;
+    }
+    b->righe = righe;
+    b->byte_nomi = byte_nomi;
+    return NULL;
+}
+
+// nomi.txt, passo 2: ogni riga <codice>\t<nome>\t<anno> diventa un attore,
+// scritto a partire da attori[primo], con il nome copiato in g->nomi da
+// primo_byte in poi. Le righe malformate vengono saltate.
+static void *nomi_analizza_thread_func(void *arg) {
+    blocco_testo_t *b = (blocco_testo_t *)arg;
+    attore *out = (attore *)b->g->attori + b->primo;
+    char *nomi = (char *)b->g->nomi;
+    int64_t pos_nome = b->primo_byte;
+    int64_t validi = 0;
+    for (const char *p = b->inizio; p < b->fine; ) {
+        const char *fr = fine_riga(p, b->fine);
+        const char *tab1, *tab2;
+        int codice, anno;
+        const char *q = p;
+        if (campi_nomi(p, fr, &tab1, &tab2) && scan_intero(&q, tab1, &codice)) {
+            q = tab2 + 1;
+            if (scan_intero(&q, fr, &anno)) {
+                size_t dim = tab2 - tab1 - 1;
+                memcpy(nomi + pos_nome, tab1 + 1, dim);
+                nomi[pos_nome + dim] = '\0';
+                out[validi].codice = codice;
+                out[validi].anno = anno;
+                out[validi].nome = pos_nome;
+                pos_nome += dim + 1;
+                validi++;
+            }
+        }
+        p = fr < b->fine ? fr + 1 : b->fine;
+    }
+    b->validi = validi;
+    return NULL;
+}
+
+// grafo.txt, passo 1: per ogni riga <codice> <grado> <cop_1> ... registra in
+// prima_riga[id] l'inizio della riga, e il resto si salta con memchr. Se un
+// attore ha più righe vale la prima nel file, qualunque thread la trovi: il
+// minimo si aggiorna con una compare-and-swap.
+static void *grafo_conta_thread_func(void *arg) {
+    blocco_testo_t *b = (blocco_testo_t *)arg;
+    const grafo_t *g = b->g;
+    for (const char *p = b->inizio; p < b->fine; ) {
+        const char *riga = p;
+        int codice;
+        if (scan_intero(&p, b->fine, &codice)) {
+            int id = grafo_id(g, codice);
+            if (id >= 0) {
+                const char *vista = __atomic_load_n(&b->prima_riga[id], __ATOMIC_RELAXED);
+                while ((!vista || riga < vista) &&
+                       !__atomic_compare_exchange_n(&b->prima_riga[id], &vista, riga, 1,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                }
+            }
+        }
+        p = prossima_riga(p, b->fine);
+    }
+    return NULL;
+}
+
+// Tra i due passi: gradi[id] è il grado dichiarato nella riga prima_riga[id]
+// (0 senza riga o se negativo). Una riga non può elencare più valori di quanti
+// ne stanno nel resto del file, e il grado si limita a quello: un grado
+// sbagliato spreca al più spazio nella riga, che il passo 2 riempie solo con
+// i valori presenti.
+static void righe_dimensiona(const char **prima_riga, int n, const char *fine, int *gradi) {
+    for (int id = 0; id < n; ++id) {
+        const char *p = prima_riga[id];
+        int codice, grado;
+        gradi[id] = 0;
+        if (p && scan_intero(&p, fine, &codice) && scan_intero(&p, fine, &grado) && grado > 0) {
+            gradi[id] = (int64_t)grado <= (fine - p + 1) / 2 ? grado : (int)((fine - p + 1) / 2);
+        }
+    }
+}
+
+// grafo.txt, passo 2: converte i coprotagonisti in id densi e li scrive nella
+// riga CSR dell'attore, al più gradi[id]. Quelli assenti da nomi.txt non
+// sarebbero comunque raggiungibili e vengono scartati: scritti[id] può quindi
+// essere minore di gradi[id]. Le righe ripetute di un attore si saltano, così
+// ogni riga CSR ha un solo thread che la scrive.
+static void *grafo_analizza_thread_func(void *arg) {
+    blocco_testo_t *b = (blocco_testo_t *)arg;
+    const grafo_t *g = b->g;
+    int *vicini = (int *)g->vicini;
+    for (const char *p = b->inizio; p < b->fine; ) {
+        const char *inizio_riga = p;
+        int codice, valore;
+        if (scan_intero(&p, b->fine, &codice)) {
+            int id = grafo_id(g, codice);
+            if (id < 0) {
+                fprintf(stderr, "Attenzione: codice attore %d trovato in grafo.txt ma non in nomi.txt. Riga ignorata.\n", codice);
+            } else if (b->prima_riga[id] != inizio_riga) {
+                fprintf(stderr, "Attenzione: codice attore %d ripetuto in grafo.txt. Riga ignorata.\n", codice);
+            } else if (scan_intero(&p, b->fine, &valore)) { // grado
+                int *riga = vicini + g->offsets[id];
+                int num = 0;
+                while (num < b->gradi[id] && scan_intero(&p, b->fine, &valore)) {
+                    int id_cop = grafo_id(g, valore);
+                    if (id_cop >= 0) riga[num++] = id_cop;
+                }
+                b->scritti[id] = num;
+            }
+        }
+        p = prossima_riga(p, b->fine);
+    }
+    return NULL;
+}
+
+// Checksum di una sezione dello snapshot: FNV-1a applicato a parole da 64 bit
+// (la sezione è completata con zeri fino a un multiplo di 8 byte).
+static uint64_t snapshot_checksum(const void *dati, size_t dim) {
+    const unsigned char *p = (const unsigned char *)dati;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
+    }
+    if (i < dim) {
+        uint64_t w = 0;
+        memcpy(&w, p + i, dim - i);
+        h = (h ^ w) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Vero se la sezione [off, off + dim) è allineata a 8 byte e contenuta nel file,
+// dopo un'intestazione di dim_header byte.
+static int snapshot_sezione_valida(int64_t off, int64_t dim, size_t dim_header, size_t dim_file) {
+    return off >= (int64_t)dim_header && off % 8 == 0 && dim >= 0 &&
+           (uint64_t)off <= dim_file && (uint64_t)dim <= dim_file - (uint64_t)off;
+}
+
+// Mappa lo snapshot 'path' in sola lettura e ne ricava il grafo senza copiare
+// attori, offsets, vicini e nomi. Controlla sempre la struttura che costa una
+// passata sugli attori: offsets crescenti, codici ordinati (bsearch ci conta),
+// nomi ed etichette delle componenti nell'intervallo. Con 'verifica' controlla
+// anche i checksum delle sezioni e che ogni vicino sia un id valido, leggendo
+// l'intero file: serve per gli snapshot di provenienza non fidata. Restituisce
+// 0 se il grafo è pronto, -1 (con un messaggio su stderr) se lo snapshot manca
+// o non è valido.
+int grafo_carica_snapshot(grafo_t *g, const char *path, int verifica) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "Snapshot %s non disponibile: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(snapshot_header_t)) {
+        fprintf(stderr, "Snapshot %s troppo corto.\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t dim_file = (size_t)st.st_size;
+    void *mappa = mmap(NULL, dim_file, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // La mappatura resta valida anche dopo la chiusura
+    if (mappa == MAP_FAILED) {
+        perror("mmap dello snapshot fallita");
+        return -1;
+    }
+
+    const char *base = (const char *)mappa;
+    const snapshot_header_t *h = (const snapshot_header_t *)mappa;
+    const char *errore = NULL;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, 8) != 0) {
+        errore = "non è uno snapshot del grafo";
+    } else if (h->versione != SNAPSHOT_VERSIONE || h->dim_header != sizeof(snapshot_header_t)) {
+        errore = "versione non supportata";
+    } else if (snapshot_checksum(h, offsetof(snapshot_header_t, chk_header)) != h->chk_header) {
+        errore = "intestazione corrotta";
+    } else if (h->tota_attori <= 0 || h->tota_attori >= INT_MAX || h->num_vicini < 0 ||
+               !snapshot_sezione_valida(h->off_attori, h->tota_attori * (int64_t)sizeof(snapshot_attore_t), sizeof(*h), dim_file) ||
+               !snapshot_sezione_valida(h->off_offsets, (h->tota_attori + 1) * (int64_t)sizeof(int64_t), sizeof(*h), dim_file) ||
+               !snapshot_sezione_valida(h->off_vicini, h->num_vicini * (int64_t)sizeof(int32_t), sizeof(*h), dim_file) ||
+               !snapshot_sezione_valida(h->off_nomi, h->dim_nomi, sizeof(*h), dim_file) ||
+               !snapshot_sezione_valida(h->off_componenti, h->tota_attori * (int64_t)sizeof(int32_t), sizeof(*h), dim_file) ||
+               h->num_componenti <= 0 || h->num_componenti > h->tota_attori ||
+               h->dim_nomi <= 0 || base[h->off_nomi + h->dim_nomi - 1] != '\0') {
+        errore = "sezioni fuori dal file";
+    }
+
+    const snapshot_attore_t *rec = NULL;
+    const int64_t *offsets = NULL;
+    if (!errore) {
+        rec = (const snapshot_attore_t *)(base + h->off_attori);
+        offsets = (const int64_t *)(base + h->off_offsets);
+        if (offsets[0] != 0 || offsets[h->tota_attori] != h->num_vicini) {
+            errore = "offsets incoerenti";
+        } else if (verifica &&
+                   (snapshot_checksum(rec, h->tota_attori * sizeof(snapshot_attore_t)) != h->chk_attori ||
+                    snapshot_checksum(offsets, (h->tota_attori + 1) * sizeof(int64_t)) != h->chk_offsets ||
+                    snapshot_checksum(base + h->off_vicini, h->num_vicini * sizeof(int32_t)) != h->chk_vicini ||
+                    snapshot_checksum(base + h->off_nomi, h->dim_nomi) != h->chk_nomi ||
+                    snapshot_checksum(base + h->off_componenti, h->tota_attori * sizeof(int32_t)) != h->chk_componenti)) {
+            errore = "checksum delle sezioni errato";
+        }
+        // 'attori' si usa così com'è nella mappatura: ogni nome deve essere nella
+        // sezione, e i codici in ordine strettamente crescente
+        for (int64_t i = 0; !errore && i < h->tota_attori; ++i) {
+            if (rec[i].nome < 0 || rec[i].nome >= h->dim_nomi) errore = "nomi fuori dalla sezione";
+            else if (i > 0 && rec[i - 1].codice >= rec[i].codice) errore = "attori non ordinati per codice";
+        }
+        for (int64_t i = 0; !errore && i < h->tota_attori; ++i) {
+            if (offsets[i] > offsets[i + 1]) errore = "offsets non crescenti";
+        }
+        // Senza -k i vicini si leggono solo quando la BFS li visita. Il massimo
+        // senza segno scopre in una passata vettorizzabile anche i negativi.
+        if (!errore && verifica) {
+            const uint32_t *vicini = (const uint32_t *)(base + h->off_vicini);
+            uint32_t massimo = 0;
+            for (int64_t i = 0; i < h->num_vicini; ++i) {
+                if (vicini[i] > massimo) massimo = vicini[i];
+            }
+            if (h->num_vicini > 0 && massimo >= (uint64_t)h->tota_attori) errore = "vicini fuori intervallo";
+        }
+        // Le etichette delle componenti indicizzano array di num_componenti elementi
+        const int32_t *componenti = (const int32_t *)(base + h->off_componenti);
+        for (int64_t i = 0; !errore && i < h->tota_attori; ++i) {
+            if (componenti[i] < 0 || componenti[i] >= h->num_componenti) errore = "componenti fuori intervallo";
+        }
+    }
+    if (errore) {
+        fprintf(stderr, "Snapshot %s non valido: %s.\n", path, errore);
+        munmap(mappa, dim_file);
+        return -1;
+    }
+
+    g->arena = (arena_t){ 0 };
+    g->tota_attori = (int)h->tota_attori;
+    g->attori = (const attore *)rec;
+    g->nomi = base + h->off_nomi;
+    g->dim_nomi = h->dim_nomi;
+    g->per_nome = NULL;
+    g->per_codice = NULL;
+    g->offsets = offsets;
+    g->vicini = (const int *)(base + h->off_vicini);
+    g->componente = (const int *)(base + h->off_componenti);
+    g->num_componenti = (int)h->num_componenti;
+    g->snapshot = mappa;
+    g->dim_snapshot = dim_file;
+    g->compressi = NULL;
+    g->posizioni = NULL;
+    g->grado_max = 0;
+    return 0;
+}
+
+// Libera il grafo: una munmap per lo snapshot e una per regione dell'arena.
+void grafo_destroy(grafo_t *g) {
+    if (g->snapshot) munmap(g->snapshot, g->dim_snapshot);
+    arena_destroy(&g->arena);
+}
+
+// --- Componenti Connesse ---
+// Union-find senza lock: ogni unione collega la radice con id maggiore a quella
+// con id minore con una compare-and-swap, quindi la radice di una componente è
+// il suo attore con id minore e ogni puntatore punta sempre a un id minore o
+// uguale. La ricerca dimezza il cammino con CAS: un puntatore viene solo
+// spostato su un antenato, quindi i thread non possono rompersi a vicenda.
+
+typedef struct {
+    const grafo_t *g;
+    int *padre;
+    int da, a;                  // intervallo di attori del thread
+} blocco_componenti_t;
+
+static int uf_radice(int *padre, int v) {
+    for (;;) {
+        int p = __atomic_load_n(&padre[v], __ATOMIC_RELAXED);
+        if (p == v) return v;
+        int pp = __atomic_load_n(&padre[p], __ATOMIC_RELAXED);
+        if (pp != p) __atomic_compare_exchange_n(&padre[v], &p, pp, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        v = pp;
+    }
+}
+
+static void uf_unisci(int *padre, int a, int b) {
+    for (;;) {
+        a = uf_radice(padre, a);
+        b = uf_radice(padre, b);
+        if (a == b) return;
+        int alta = a > b ? a : b, bassa = a > b ? b : a;
+        // Fallisce solo se nel frattempo 'alta' è stata collegata: si riprova dalle nuove radici
+        if (__atomic_compare_exchange_n(&padre[alta], &alta, bassa, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return;
+    }
+}
+
+static void *componenti_thread_func(void *arg) {
+    blocco_componenti_t *b = (blocco_componenti_t *)arg;
+    const grafo_t *g = b->g;
+    for (int v = b->da; v < b->a; ++v) {
+        for (int64_t i = g->offsets[v]; i < g->offsets[v + 1]; ++i) {
+            int n = g->vicini[i];
+            if (n > v) uf_unisci(b->padre, v, n); // Ogni arco compare in entrambe le liste
+        }
+    }
+    return NULL;
+}
+
+// Calcola g->componente con 'num_thread' thread, per i grafi caricati dai file
+// di testo (lo snapshot la contiene già).
+void grafo_calcola_componenti(grafo_t *g, int num_thread) {
+    int n = g->tota_attori;
+    int *padre = (int *)arena_alloca(&g->arena, n * sizeof(int));
+    for (int v = 0; v < n; ++v) padre[v] = v;
+
+    // Blocchi con circa lo stesso numero di archi
+    blocco_componenti_t *blocchi = (blocco_componenti_t *)xmalloc(num_thread * sizeof(blocco_componenti_t));
+    int v = 0;
+    for (int i = 0; i < num_thread; ++i) {
+        int64_t limite = g->offsets[n] / num_thread * (i + 1);
+        blocchi[i].g = g;
+        blocchi[i].padre = padre;
+        blocchi[i].da = v;
+        while (v < n && (i == num_thread - 1 || g->offsets[v] < limite)) v++;
+        blocchi[i].a = v;
+    }
+    esegui_in_parallelo(num_thread, componenti_thread_func, blocchi, sizeof(blocco_componenti_t));
+    free(blocchi);
+
+    // Numerazione in ordine di id: padre[v] <= v, quindi quando si arriva a v
+    // padre[padre[v]] contiene già il numero della sua componente.
+    int k = 0;
+    for (v = 0; v < n; ++v) {
+        padre[v] = (padre[v] == v) ? k++ : padre[padre[v]];
+    }
+    g->componente = padre;
+    g->num_componenti = k;
+}
+
+// Riporta su 'fp' numero e dimensioni delle componenti; con 'dettaglio' anche
+// quante componenti cadono in ogni fascia di dimensione (potenze di 2).
+void grafo_stampa_componenti(const grafo_t *g, FILE *fp, int dettaglio) {
+    int *dimensione = (int *)calloc(g->num_componenti, sizeof(int));
+    if (!dimensione) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    for (int v = 0; v < g->tota_attori; ++v) {
+        if ((unsigned)g->componente[v] < (unsigned)g->num_componenti) dimensione[g->componente[v]]++;
+    }
+    int massima = 0, isolati = 0;
+    long fasce[32] = { 0 };
+    for (int c = 0; c < g->num_componenti; ++c) {
+        if (dimensione[c] > massima) massima = dimensione[c];
+        if (dimensione[c] == 1) isolati++;
+        int f = 0;
+        while ((2 << f) <= dimensione[c]) f++;
+        fasce[f]++;
+    }
+    fprintf(fp, "Componenti connesse: %d; la più grande ha %d attori (%.1f%%), %d attori isolati\n",
+            g->num_componenti, massima, 100.0 * massima / g->tota_attori, isolati);
+    for (int f = 0; dettaglio && f < 32; ++f) {
+        if (fasce[f]) fprintf(fp, "  %ld componenti da %d a %d attori\n", fasce[f], 1 << f, (2 << f) - 1);
+    }
+    free(dimensione);
+}
+
+// --- Riordino del Grafo ---
+// Gli id densi seguono l'ordine dei codici IMDb, che non ha niente a che fare
+// con la struttura del grafo: i vicini di un attore sono sparsi su tutto
+// l'intervallo degli id, e la BFS legge e scrive visitato/parent di ognuno in
+// una riga di cache diversa. Con -R gli attori vengono rinumerati dopo il
+// caricamento, così che attori collegati abbiano id vicini:
+//  - grado: per grado decrescente. Gli attori più collegati, che compaiono in
+//    quasi tutte le liste, finiscono nelle stesse poche righe di cache;
+//  - rcm: Reverse Cuthill-McKee, cioè l'ordine di una BFS che parte da un
+//    attore di grado minimo e accoda i vicini per grado crescente, rovesciato.
+//    I vicini di un attore ricevono id consecutivi;
+//  - gorder: come Gorder, si sceglie ogni volta l'attore non ancora numerato
+//    con più archi e più vicini in comune con gli ultimi RIORDINO_FINESTRA
+//    numerati. Le priorità cambiano di uno alla volta, quindi stanno in code
+//    per punteggio (unit heap) con aggiornamenti in tempo costante.
+// Il riordino avviene prima di indice dei nomi, partecipazioni, indice 2-hop e
+// compressione, che vedono solo il grafo riordinato. I codici restano in
+// 'attori': per le richieste si cercano con grafo_id attraverso per_codice.
+#define RIORDINO_FINESTRA 5         // attori della finestra di gorder
+#define RIORDINO_GRADO_HUB 64       // grado massimo degli attori che danno vicini in comune in gorder
+#define RIORDINO_ID_PER_LINEA 16    // elementi di visitato (uint32_t) in una riga di cache da 64 byte
+
+static const char *S_NOMI_RIORDINO[] = { "nessuno", "grado", "rcm", "gorder" };
+
+// Righe di cache di un array per attore (16 id per riga) toccate in media per
+// arco scorrendo tutte le liste di adiacenza: 1 se ogni vicino ne tocca una
+// nuova, tanto meno quanto più i vicini hanno id vicini. Le liste sono ordinate.
+static double grafo_righe_per_arco(const grafo_t *g) {
+    int64_t righe = 0;
+    for (int v = 0; v < g->tota_attori; ++v) {
+        int ultima = -1;
+        for (int64_t i = g->offsets[v]; i < g->offsets[v + 1]; ++i) {
+            int r = g->vicini[i] / RIORDINO_ID_PER_LINEA;
+            righe += r != ultima;
+            ultima = r;
+        }
+    }
+    return g->offsets[g->tota_attori] ? (double)righe / g->offsets[g->tota_attori] : 0.0;
+}
+
+static inline int grafo_grado(const grafo_t *g, int v) {
+    return (int)(g->offsets[v + 1] - g->offsets[v]);
+}
+
+// Id in ordine di grado decrescente e, a parità di grado, di id (counting sort).
+static void riordino_grado(const grafo_t *g, int *ordine, int crescente) {
+    int n = g->tota_attori, grado_max = 0;
+    for (int v = 0; v < n; ++v) {
+        if (grafo_grado(g, v) > grado_max) grado_max = grafo_grado(g, v);
+    }
+    int64_t *inizio = (int64_t *)calloc(grado_max + 2, sizeof(int64_t));
+    if (!inizio) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    for (int v = 0; v < n; ++v) {
+        int d = crescente ? grafo_grado(g, v) : grado_max - grafo_grado(g, v);
+        inizio[d + 1]++;
+    }
+    for (int d = 0; d <= grado_max; ++d) inizio[d + 1] += inizio[d];
+    for (int v = 0; v < n; ++v) {
+        int d = crescente ? grafo_grado(g, v) : grado_max - grafo_grado(g, v);
+        ordine[inizio[d]++] = v;
+    }
+    free(inizio);
+}
+
+static int confronta_per_grado(const void *a, const void *b, void *arg) {
+    const grafo_t *g = (const grafo_t *)arg;
+    int x = *(const int *)a, y = *(const int *)b;
+    int gx = grafo_grado(g, x), gy = grafo_grado(g, y);
+    if (gx != gy) return gx < gy ? -1 : 1;
+    return (x > y) - (x < y);
+}
+
+// Reverse Cuthill-McKee: ogni componente viene visitata partendo dal suo
+// attore di grado minimo (il primo in ordine di grado crescente).
+static void riordino_rcm(const grafo_t *g, int *ordine) {
+    int n = g->tota_attori;
+    int *per_grado = (int *)xmalloc(n * sizeof(int));
+    riordino_grado(g, per_grado, 1);
+    uint8_t *visto = (uint8_t *)calloc(n, 1);
+    if (!visto) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    int coda = 0, fine = 0; // 'ordine' fa da coda della BFS
+    for (int k = 0; k < n; ++k) {
+        int s = per_grado[k];
+        if (visto[s]) continue;
+        visto[s] = 1;
+        ordine[fine++] = s;
+        while (coda < fine) {
+            int u = ordine[coda++];
+            int primo = fine;
+            for (int64_t i = g->offsets[u]; i < g->offsets[u + 1]; ++i) {
+                int w = g->vicini[i];
+                if (!visto[w]) {
+                    visto[w] = 1;
+                    ordine[fine++] = w;
+                }
+            }
+            qsort_r(ordine + primo, fine - primo, sizeof(int), confronta_per_grado, (void *)g);
+        }
+    }
+    for (int i = 0, j = n - 1; i < j; ++i, --j) {
+        int t = ordine[i];
+        ordine[i] = ordine[j];
+        ordine[j] = t;
+    }
+    free(visto);
+    free(per_grado);
+}
+
+// Unit heap di gorder: gli attori non ancora numerati, in una lista doppia per
+// ogni punteggio. 'massimo' può essere più alto del vero massimo, e scende
+// all'estrazione.
+typedef struct {
+    int *punteggio, *prec, *succ;
+    int *testa;                 // primo attore di ogni punteggio, -1 se nessuno
+    int massimo;
+    uint8_t *numerato;
+} riordino_heap_t;
+
+static void heap_togli(riordino_heap_t *h, int v) {
+    if (h->prec[v] >= 0) h->succ[h->prec[v]] = h->succ[v];
+    else h->testa[h->punteggio[v]] = h->succ[v];
+    if (h->succ[v] >= 0) h->prec[h->succ[v]] = h->prec[v];
+}
+
+static void heap_metti(riordino_heap_t *h, int v) {
+    int p = h->punteggio[v];
+    h->prec[v] = -1;
+    h->succ[v] = h->testa[p];
+    if (h->testa[p] >= 0) h->prec[h->testa[p]] = v;
+    h->testa[p] = v;
+    if (p > h->massimo) h->massimo = p;
+}
+
+static inline void heap_aggiungi(riordino_heap_t *h, int v, int delta) {
+    if (h->numerato[v]) return;
+    heap_togli(h, v);
+    h->punteggio[v] += delta;
+    heap_metti(h, v);
+}
+
+// Un attore entra (delta = 1) o esce (delta = -1) dalla finestra: cambia il
+// punteggio dei vicini (un arco) e dei vicini dei vicini (un vicino in comune).
+// I vicini in comune si contano solo attraverso attori di grado al più
+// RIORDINO_GRADO_HUB: ognuno costa il quadrato del suo grado, e i più
+// collegati, vicini di quasi tutti, distinguerebbero poco tra i candidati.
+static void heap_finestra(riordino_heap_t *h, const grafo_t *g, int v, int delta) {
+    for (int64_t i = g->offsets[v]; i < g->offsets[v + 1]; ++i) {
+        int u = g->vicini[i];
+        heap_aggiungi(h, u, delta);
+        if (grafo_grado(g, u) > RIORDINO_GRADO_HUB) continue;
+        for (int64_t j = g->offsets[u]; j < g->offsets[u + 1]; ++j) {
+            if (g->vicini[j] != v) heap_aggiungi(h, g->vicini[j], delta);
+        }
+    }
+}
+
+static void riordino_gorder(const grafo_t *g, int *ordine) {
+    int n = g->tota_attori, grado_max = 0, inizio = 0;
+    for (int v = 0; v < n; ++v) {
+        if (grafo_grado(g, v) > grado_max) {
+            grado_max = grafo_grado(g, v);
+            inizio = v;
+        }
+    }
+    // Ogni attore della finestra dà al più 1 per l'arco e 1 per vicino in comune
+    int punteggio_max = RIORDINO_FINESTRA * (grado_max + 1);
+
+    riordino_heap_t h;
+    h.punteggio = (int *)calloc(n, sizeof(int));
+    h.numerato = (uint8_t *)calloc(n, 1);
+    h.prec = (int *)xmalloc(n * sizeof(int));
+    h.succ = (int *)xmalloc(n * sizeof(int));
+    h.testa = (int *)xmalloc((punteggio_max + 1) * sizeof(int));
+    if (!h.punteggio || !h.numerato) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    for (int p = 0; p <= punteggio_max; ++p) h.testa[p] = -1;
+    h.massimo = 0;
+    for (int v = n - 1; v >= 0; --v) heap_metti(&h, v); // A parità di punteggio esce l'id minore
+
+    for (int k = 0; k < n; ++k) {
+        int v = inizio;
+        if (k > 0) {
+            while (h.testa[h.massimo] < 0) h.massimo--;
+            v = h.testa[h.massimo];
+        }
+        heap_togli(&h, v);
+        h.numerato[v] = 1;
+        ordine[k] = v;
+        if (k >= RIORDINO_FINESTRA) heap_finestra(&h, g, ordine[k - RIORDINO_FINESTRA], -1);
+        heap_finestra(&h, g, v, 1);
+    }
+    free(h.punteggio);
+    free(h.numerato);
+    free(h.prec);
+    free(h.succ);
+    free(h.testa);
+}
+
+// Rinumera gli attori di g con la strategia data. Va chiamata subito dopo il
+// caricamento e il calcolo delle componenti, con 'attori' in ordine di codice.
+// Uno snapshot viene copiato in memoria: le sue sezioni non si possono permutare.
+void grafo_riordina(grafo_t *g, int strategia) {
+    uint64_t inizio = adesso_ns();
+    int n = g->tota_attori;
+    double righe_prima = grafo_righe_per_arco(g);
+    int *ordine = (int *)xmalloc(n * sizeof(int));
+    switch (strategia) {
+    case RIORDINO_GRADO: riordino_grado(g, ordine, 0); break;
+    case RIORDINO_RCM: riordino_rcm(g, ordine); break;
+    default: riordino_gorder(g, ordine); break;
+    }
+    int *nuovo = (int *)arena_alloca(&g->arena, n * sizeof(int));
+    for (int v = 0; v < n; ++v) nuovo[ordine[v]] = v;
+
+    attore *attori = (attore *)arena_alloca(&g->arena, n * sizeof(attore));
+    int64_t *offsets = (int64_t *)arena_alloca(&g->arena, (n + 1) * sizeof(int64_t));
+    int *vicini = (int *)arena_alloca(&g->arena, g->offsets[n] * sizeof(int));
+    int *componente = (int *)arena_alloca(&g->arena, n * sizeof(int));
+    int *numero = (int *)xmalloc(g->num_componenti * sizeof(int));
+    for (int c = 0; c < g->num_componenti; ++c) numero[c] = -1;
+    offsets[0] = 0;
+    int k = 0;
+    for (int v = 0; v < n; ++v) {
+        attori[v] = g->attori[ordine[v]];
+        offsets[v + 1] = offsets[v] + grafo_grado(g, ordine[v]);
+        // Componenti rinumerate nell'ordine del loro attore con id minore, come in grafo_calcola_componenti.
+        // Lo snapshot verifica le etichette al caricamento; una fuori intervallo resta comunque isolata.
+        int c = g->componente[ordine[v]];
+        if ((unsigned)c >= (unsigned)g->num_componenti) {
+            componente[v] = k++;
+            continue;
+        }
+        if (numero[c] < 0) numero[c] = k++;
+        componente[v] = numero[c];
+    }
+    free(numero);
+
+    // Liste già ordinate senza ordinarle: ogni arco compare in entrambe le
+    // liste, quindi scorrendo i nuovi id u in ordine crescente e aggiungendo u
+    // alla lista di ogni suo vicino, ogni lista riceve i suoi vicini in ordine.
+    // Se un arco manca da una delle due liste, le righe si rinumerano e si
+    // ordinano una per una.
+    int64_t *pos = (int64_t *)xmalloc(n * sizeof(int64_t));
+    memcpy(pos, offsets, n * sizeof(int64_t));
+    int simmetrico = 1;
+    for (int u = 0; u < n && simmetrico; ++u) {
+        int vecchio = ordine[u];
+        for (int64_t i = g->offsets[vecchio]; i < g->offsets[vecchio + 1]; ++i) {
+            int w = nuovo[g->vicini[i]];
+            if (pos[w] == offsets[w + 1]) {
+                simmetrico = 0;
+                break;
+            }
+            vicini[pos[w]++] = u;
+        }
+    }
+    for (int u = 0; u < n && simmetrico; ++u) simmetrico = pos[u] == offsets[u + 1];
+    for (int u = 0; u < n && !simmetrico; ++u) {
+        int vecchio = ordine[u];
+        int *riga = vicini + offsets[u];
+        int grado = grafo_grado(g, vecchio);
+        for (int i = 0; i < grado; ++i) riga[i] = nuovo[g->vicini[g->offsets[vecchio] + i]];
+        qsort(riga, grado, sizeof(int), confronta_int);
+    }
+    free(pos);
+    free(ordine);
+
+    if (g->snapshot) {
+        char *nomi = (char *)arena_alloca(&g->arena, g->dim_nomi);
+        memcpy(nomi, g->nomi, g->dim_nomi);
+        munmap(g->snapshot, g->dim_snapshot);
+        g->nomi = nomi;
+        g->snapshot = NULL;
+        g->dim_snapshot = 0;
+    } else {
+        arena_libera(&g->arena, g->attori);
+        arena_libera(&g->arena, g->offsets);
+        arena_libera(&g->arena, g->vicini);
+        arena_libera(&g->arena, g->componente);
+    }
+    g->attori = attori;
+    g->offsets = offsets;
+    g->vicini = vicini;
+    g->componente = componente;
+    // I vecchi id erano in ordine di codice: nuovo[] elenca quindi i nuovi id in ordine di codice
+    g->per_codice = nuovo;
+
+    fprintf(stderr, "Riordino %s: righe di cache per arco da %.3f a %.3f, in %.2f s\n",
+            S_NOMI_RIORDINO[strategia], righe_prima, grafo_righe_per_arco(g), (adesso_ns() - inizio) / 1e9);
+}
+
+// --- Indice dei Nomi ---
+// grafo_t.per_nome elenca gli id in ordine di nome (strcmp, cioè byte per byte
+// dell'UTF-8) e, a parità di nome, di id. Gli attori con un certo nome, o con
+// nomi che iniziano con un certo prefisso, occupano quindi un intervallo
+// contiguo, che si trova con due ricerche binarie.
+// L'indice si costruisce a ogni avvio, anche da snapshot: ogni thread ordina
+// una parte con qsort_r, poi le parti si fondono a coppie, con le fusioni di
+// uno stesso livello in parallelo.
+#define NOMI_MAX_CANDIDATI 4096     // omonimi (o nomi con il prefisso) esaminati al più da nomi_risolvi
+#define NOMI_MAX_TESTO 1016         // byte al più del testo di una richiesta per nome
+
+static int confronta_per_nome(const void *a, const void *b, void *arg) {
+    const grafo_t *g = (const grafo_t *)arg;
+    int x = *(const int *)a, y = *(const int *)b;
+    int c = strcmp(grafo_nome(g, x), grafo_nome(g, y));
+    return c ? c : (x > y) - (x < y);
+}
+
+typedef struct {
+    const grafo_t *g;
+    const int *da;
+    int *a;
+    int64_t inizio, meta, fine;     // fonde da[inizio, meta) e da[meta, fine) in a[inizio, fine)
+} fusione_nomi_t;
+
+static void *nomi_ordina_thread_func(void *arg) {
+    fusione_nomi_t *f = (fusione_nomi_t *)arg;
+    qsort_r(f->a + f->inizio, f->fine - f->inizio, sizeof(int), confronta_per_nome, (void *)f->g);
+    return NULL;
+}
+
+static void *nomi_fondi_thread_func(void *arg) {
+    fusione_nomi_t *f = (fusione_nomi_t *)arg;
+    int64_t i = f->inizio, j = f->meta, k = f->inizio;
+    while (i < f->meta && j < f->fine) {
+        f->a[k++] = confronta_per_nome(&f->da[j], &f->da[i], (void *)f->g) < 0 ? f->da[j++] : f->da[i++];
+    }
+    while (i < f->meta) f->a[k++] = f->da[i++];
+    while (j < f->fine) f->a[k++] = f->da[j++];
+    return NULL;
+}
+
+// Costruisce g->per_nome con num_thread thread.
+void grafo_indicizza_nomi(grafo_t *g, int num_thread) {
+    uint64_t inizio = adesso_ns();
+    int64_t n = g->tota_attori;
+    if (num_thread > n) num_thread = 1;
+    int *ordine = (int *)arena_alloca(&g->arena, n * sizeof(int));
+    int *appoggio = (int *)arena_alloca(&g->arena, n * sizeof(int));
+    for (int64_t i = 0; i < n; ++i) ordine[i] = (int)i;
+
+    int64_t *confini = (int64_t *)xmalloc((num_thread + 1) * sizeof(int64_t));
+    fusione_nomi_t *parti = (fusione_nomi_t *)xmalloc(num_thread * sizeof(fusione_nomi_t));
+    for (int i = 0; i <= num_thread; ++i) confini[i] = n * i / num_thread;
+    for (int i = 0; i < num_thread; ++i) {
+        parti[i] = (fusione_nomi_t){ g, NULL, ordine, confini[i], confini[i], confini[i + 1] };
+    }
+    esegui_in_parallelo(num_thread, nomi_ordina_thread_func, parti, sizeof(fusione_nomi_t));
+
+    // Al livello con passo p le parti ordinate iniziano a confini[0], confini[p], confini[2p], ...
+    for (int passo = 1; passo < num_thread; passo *= 2) {
+        int num = 0;
+        for (int i = 0; i < num_thread; i += 2 * passo) {
+            int64_t meta = confini[i + passo < num_thread ? i + passo : num_thread];
+            int64_t fine = confini[i + 2 * passo < num_thread ? i + 2 * passo : num_thread];
+            parti[num++] = (fusione_nomi_t){ g, ordine, appoggio, confini[i], meta, fine };
+        }
+        esegui_in_parallelo(num, nomi_fondi_thread_func, parti, sizeof(fusione_nomi_t));
+        int *t = ordine;
+        ordine = appoggio;
+        appoggio = t;
+    }
+    arena_libera(&g->arena, appoggio);
+    free(parti);
+    free(confini);
+    g->per_nome = ordine;
+    fprintf(stderr, "Indice dei nomi: %d attori, %.1f MB di nomi, ordinati in %.1f ms\n",
+            g->tota_attori, g->dim_nomi / (1024.0 * 1024.0), (adesso_ns() - inizio) / 1e6);
+}
+
+// Confronta il nome 's' con la chiave di 'dim' byte: 0 se coincide, o con
+// 'prefisso' se 's' inizia con la chiave.
+static int confronta_chiave(const char *s, const char *chiave, size_t dim, int prefisso) {
+    int c = strncmp(s, chiave, dim);
+    if (c != 0 || prefisso) return c;
+    return s[dim] != '\0'; // 's' è più lungo della chiave: viene dopo
+}
+
+// Intervallo [*primo, *ultimo) di per_nome con i nomi uguali alla chiave, o che
+// iniziano con la chiave se 'prefisso'.
+void nomi_cerca(const grafo_t *g, const char *chiave, size_t dim, int prefisso, int64_t *primo, int64_t *ultimo) {
+    int64_t lo = 0, hi = g->tota_attori;
+    while (lo < hi) {
+        int64_t m = lo + (hi - lo) / 2;
+        if (confronta_chiave(grafo_nome(g, g->per_nome[m]), chiave, dim, prefisso) < 0) lo = m + 1;
+        else hi = m;
+    }
+    *primo = lo;
+    hi = g->tota_attori;
+    while (lo < hi) {
+        int64_t m = lo + (hi - lo) / 2;
+        if (confronta_chiave(grafo_nome(g, g->per_nome[m]), chiave, dim, prefisso) <= 0) lo = m + 1;
+        else hi = m;
+    }
+    *ultimo = lo;
+}
+
+// Chiave di ricerca scritta da un client: un nome esatto, o un prefisso se
+// termina con '*'. Restituisce in *dim la lunghezza senza l'asterisco.
+static int chiave_prefisso(const char *chiave, size_t *dim) {
+    if (*dim > 0 && chiave[*dim - 1] == '*') {
+        (*dim)--;
+        return 1;
+    }
+    return 0;
+}
+
+// Risolve un estremo di una richiesta per nome: un codice se composto solo di
+// cifre, altrimenti una chiave come in chiave_prefisso. Tra più attori con
+// quel nome (o prefisso) sceglie quello con più coprotagonisti, guardando i
+// primi NOMI_MAX_CANDIDATI in ordine di nome. Restituisce l'id, -1 se non c'è.
+int nomi_risolvi(const grafo_t *g, const char *chiave, size_t dim) {
+    size_t cifre = 0;
+    while (cifre < dim && chiave[cifre] >= '0' && chiave[cifre] <= '9') cifre++;
+    if (cifre > 0 && cifre == dim && cifre < 10) {
+        return grafo_id(g, atoi(chiave));
+    }
+    int prefisso = chiave_prefisso(chiave, &dim);
+    int64_t primo, ultimo;
+    nomi_cerca(g, chiave, dim, prefisso, &primo, &ultimo);
+    if (ultimo - primo > NOMI_MAX_CANDIDATI) ultimo = primo + NOMI_MAX_CANDIDATI;
+    int scelto = -1;
+    int64_t grado_scelto = -1;
+    for (int64_t i = primo; i < ultimo; ++i) {
+        int id = g->per_nome[i];
+        int64_t grado = g->offsets[id + 1] - g->offsets[id];
+        if (grado > grado_scelto) {
+            scelto = id;
+            grado_scelto = grado;
+        }
+    }
+    return scelto;
+}
+
+// --- Indice 2-hop (Pruned Landmark Labeling) ---
+// Costruzione: per ogni hub r, in ordine di rango, una BFS da r aggiunge (r, d)
+// all'etichetta di ogni nodo raggiunto a distanza d, ma si ferma (pota) nei
+// nodi per cui le etichette già presenti danno una distanza <= d. Le prime BFS,
+// dagli attori di grado più alto, coprono quasi tutte le coppie e le
+// successive potano quasi subito.
+//
+// In parallelo i thread eseguono insieme le BFS di un gruppo di hub
+// consecutivi, potando solo con le etichette dei gruppi già completati; le
+// nuove etichette vengono aggiunte in ordine di rango alla fine del gruppo.
+// Potare meno del possibile lascia solo qualche etichetta in più: le distanze
+// restano esatte. Con un solo thread si ottiene la PLL sequenziale.
+
+// Etichetta in costruzione di un nodo
+typedef struct {
+    int32_t *hub;
+    uint8_t *dist;
+    int num, cap;
+} pll_etichetta_t;
+
+// Un nodo raggiunto dalla BFS di un hub, da aggiungere alla sua etichetta
+typedef struct {
+    int id;
+    uint8_t dist;
+} pll_nuova_t;
+
+typedef struct pll_costruzione pll_costruzione_t;
+
+// Stato di un thread della costruzione
+typedef struct {
+    pll_costruzione_t *c;
+    int indice;
+    uint8_t *t;                 // t[rango] = distanza dall'hub corrente, PLL_INFINITO se assente
+    uint8_t *d;                 // distanze della BFS corrente
+    int *coda;
+    pll_nuova_t *nuove;         // etichette prodotte dalla BFS corrente
+    int64_t num_nuove, cap_nuove;
+    int errore;                 // distanza oltre PLL_INFINITO - 1
+    int senza_memoria;          // realloc di 'nuove' fallita, BFS interrotta
+} pll_lavoratore_t;
+
+struct pll_costruzione {
+    const grafo_t *g;
+    int num_thread;
+    int *ordine;                // ordine[rango] = id dell'hub
+    pll_etichetta_t *etichette;
+    pll_lavoratore_t *lavoratori;
+    pthread_barrier_t inizio, fine;
+    int primo_rango;            // primo hub del gruppo corrente
+    int termina;
+};
+
+// Restituisce -1 se manca la memoria: l'etichetta resta valida com'era.
+static int pll_etichetta_aggiungi(pll_etichetta_t *e, int32_t hub, uint8_t dist) {
+    if (e->num == e->cap) {
+        int cap = e->cap ? e->cap * 2 : 4;
+        int32_t *h = (int32_t *)realloc(e->hub, cap * sizeof(int32_t));
+        if (h) e->hub = h;
+        uint8_t *d = h ? (uint8_t *)realloc(e->dist, cap * sizeof(uint8_t)) : NULL;
+        if (!d) {
+            perror("realloc fallita nell'indice 2-hop");
+            return -1;
+        }
+        e->dist = d;
+        e->cap = cap;
+    }
+    e->hub[e->num] = hub;
+    e->dist[e->num] = dist;
+    e->num++;
+    return 0;
+}
+
+// BFS potata dall'hub di rango 'rango'; le etichette trovate restano in w->nuove.
+static void pll_bfs_potata(pll_lavoratore_t *w, int rango) {
+    const grafo_t *g = w->c->g;
+    const pll_etichetta_t *etichette = w->c->etichette;
+    int r = w->c->ordine[rango];
+    w->num_nuove = 0;
+
+    const pll_etichetta_t *er = &etichette[r];
+    for (int i = 0; i < er->num; ++i) w->t[er->hub[i]] = er->dist[i];
+
+    int head = 0, tail = 0;
+    w->coda[tail++] = r;
+    w->d[r] = 0;
+    while (head < tail) {
+        int u = w->coda[head++];
+        uint8_t du = w->d[u];
+
+        // Potatura: le etichette già complete danno una distanza <= du?
+        const pll_etichetta_t *eu = &etichette[u];
+        int potato = 0;
+        for (int i = 0; i < eu->num; ++i) {
+            if ((int)w->t[eu->hub[i]] + eu->dist[i] <= du) {
+                potato = 1;
+                break;
+            }
+        }
+        if (potato) continue;
+
+        if (w->num_nuove == w->cap_nuove) {
+            // Niente fallisci() qui: gli altri thread aspettano alla barriera
+            int64_t cap = w->cap_nuove ? w->cap_nuove * 2 : 1024;
+            pll_nuova_t *nuove = (pll_nuova_t *)realloc(w->nuove, cap * sizeof(pll_nuova_t));
+            if (!nuove) {
+                perror("realloc fallita nell'indice 2-hop");
+                w->senza_memoria = 1;
+                break;
+            }
+            w->nuove = nuove;
+            w->cap_nuove = cap;
+        }
+        w->nuove[w->num_nuove].id = u;
+        w->nuove[w->num_nuove].dist = du;
+        w->num_nuove++;
+
+        if (du + 1 >= PLL_INFINITO) {
+            w->errore = 1;
+            continue;
+        }
+        for (int64_t i = g->offsets[u]; i < g->offsets[u + 1]; ++i) {
+            int n = g->vicini[i];
+            if (w->d[n] == PLL_INFINITO) {
+                w->d[n] = du + 1;
+                w->coda[tail++] = n;
+            }
+        }
+    }
+
+    // Ripristino di t e d per la prossima BFS
+    for (int i = 0; i < er->num; ++i) w->t[er->hub[i]] = PLL_INFINITO;
+    for (int i = 0; i < tail; ++i) w->d[w->coda[i]] = PLL_INFINITO;
+}
+
+static void *pll_thread_func(void *arg) {
+    pll_lavoratore_t *w = (pll_lavoratore_t *)arg;
+    pll_costruzione_t *c = w->c;
+    while (1) {
+        pthread_barrier_wait(&c->inizio);
+        if (c->termina) break;
+        int rango = c->primo_rango + w->indice;
+        if (rango < c->g->tota_attori) pll_bfs_potata(w, rango);
+        else w->num_nuove = 0;
+        pthread_barrier_wait(&c->fine);
+    }
+    return NULL;
+}
+
+static int confronta_grado_decrescente(const void *a, const void *b, void *arg) {
+    const grafo_t *g = (const grafo_t *)arg;
+    int x = *(const int *)a, y = *(const int *)b;
+    int64_t gx = g->offsets[x + 1] - g->offsets[x], gy = g->offsets[y + 1] - g->offsets[y];
+    if (gx != gy) return gx > gy ? -1 : 1;
+    return (x > y) - (x < y);
+}
+
+// Costruisce l'indice del grafo con num_thread thread. Restituisce NULL se una
+// distanza supera il massimo rappresentabile.
+pll_indice_t *pll_costruisci(const grafo_t *g, int num_thread) {
+    int n = g->tota_attori;
+    if (num_thread > n) num_thread = n;
+    pll_costruzione_t c;
+    c.g = g;
+    c.num_thread = num_thread;
+    c.ordine = (int *)xmalloc(n * sizeof(int));
+    for (int i = 0; i < n; ++i) c.ordine[i] = i;
+    qsort_r(c.ordine, n, sizeof(int), confronta_grado_decrescente, (void *)g);
+    c.etichette = (pll_etichetta_t *)calloc(n, sizeof(pll_etichetta_t));
+    c.lavoratori = (pll_lavoratore_t *)calloc(num_thread, sizeof(pll_lavoratore_t));
+    if (!c.etichette || !c.lavoratori) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    c.primo_rango = 0;
+    c.termina = 0;
+    if (pthread_barrier_init(&c.inizio, NULL, num_thread) != 0 ||
+        pthread_barrier_init(&c.fine, NULL, num_thread) != 0) {
+        perror("pthread_barrier_init per l'indice 2-hop fallita");
+        fallisci();
+    }
+
+    pthread_t *tids = (pthread_t *)xmalloc(num_thread * sizeof(pthread_t));
+    for (int i = 0; i < num_thread; ++i) {
+        pll_lavoratore_t *w = &c.lavoratori[i];
+        w->c = &c;
+        w->indice = i;
+        w->t = (uint8_t *)xmalloc(n);
+        w->d = (uint8_t *)xmalloc(n);
+        memset(w->t, PLL_INFINITO, n);
+        memset(w->d, PLL_INFINITO, n);
+        w->coda = (int *)xmalloc(n * sizeof(int));
+        // Il thread 0 è il chiamante
+        if (i > 0 && pthread_create(&tids[i], NULL, pll_thread_func, w) != 0) {
+            perror("pthread_create per l'indice 2-hop fallito");
+            fallisci();
+        }
+    }
+
+    int errore = 0, senza_memoria = 0;
+    for (c.primo_rango = 0; c.primo_rango < n; c.primo_rango += num_thread) {
+        pthread_barrier_wait(&c.inizio);
+        pll_bfs_potata(&c.lavoratori[0], c.primo_rango);
+        pthread_barrier_wait(&c.fine);
+        // Fuori dalle barriere nessuno legge le etichette: si aggiungono in ordine di rango
+        for (int i = 0; i < num_thread && !senza_memoria; ++i) {
+            pll_lavoratore_t *w = &c.lavoratori[i];
+            errore |= w->errore;
+            senza_memoria |= w->senza_memoria;
+            for (int64_t k = 0; k < w->num_nuove && !senza_memoria; ++k) {
+                if (pll_etichetta_aggiungi(&c.etichette[w->nuove[k].id], c.primo_rango + i, w->nuove[k].dist) != 0)
+                    senza_memoria = 1;
+            }
+        }
+        if (errore || senza_memoria) break;
+    }
+    c.termina = 1;
+    pthread_barrier_wait(&c.inizio);
+    for (int i = 1; i < num_thread; ++i) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+    for (int i = 0; i < num_thread; ++i) {
+        free(c.lavoratori[i].t);
+        free(c.lavoratori[i].d);
+        free(c.lavoratori[i].coda);
+        free(c.lavoratori[i].nuove);
+    }
+    free(c.lavoratori);
+    pthread_barrier_destroy(&c.inizio);
+    pthread_barrier_destroy(&c.fine);
+    free(c.ordine);
+
+    // Compattazione delle etichette in tre array contigui
+    pll_indice_t *x = NULL;
+    if (!errore && !senza_memoria) {
+        x = (pll_indice_t *)xmalloc(sizeof(pll_indice_t));
+        int64_t *offsets = (int64_t *)xmalloc((n + 1) * sizeof(int64_t));
+        offsets[0] = 0;
+        for (int v = 0; v < n; ++v) offsets[v + 1] = offsets[v] + c.etichette[v].num;
+        int32_t *hub = (int32_t *)xmalloc((offsets[n] > 0 ? offsets[n] : 1) * sizeof(int32_t));
+        uint8_t *dist = (uint8_t *)xmalloc(offsets[n] > 0 ? offsets[n] : 1);
+        for (int v = 0; v < n; ++v) {
+            memcpy(hub + offsets[v], c.etichette[v].hub, c.etichette[v].num * sizeof(int32_t));
+            memcpy(dist + offsets[v], c.etichette[v].dist, c.etichette[v].num);
+        }
+        x->tota_attori = n;
+        x->num_etichette = offsets[n];
+        x->offsets = offsets;
+        x->hub = hub;
+        x->dist = dist;
+        x->mappa = NULL;
+        x->dim_mappa = 0;
+    }
+    for (int v = 0; v < n; ++v) {
+        free(c.etichette[v].hub);
+        free(c.etichette[v].dist);
+    }
+    free(c.etichette);
+    if (senza_memoria) fallisci(); // I thread sono già stati attesi
+    return x;
+}
+
+void pll_destroy(pll_indice_t *x) {
+    if (!x) return;
+    if (x->mappa) {
+        munmap(x->mappa, x->dim_mappa);
+    } else {
+        free((int64_t *)x->offsets);
+        free((int32_t *)x->hub);
+        free((uint8_t *)x->dist);
+    }
+    free(x);
+}
+
+// Distanza tra s e t secondo le etichette, PLL_INFINITO se non collegati.
+static int pll_distanza(const pll_indice_t *x, int s, int t) {
+    int64_t i = x->offsets[s], fi = x->offsets[s + 1];
+    int64_t j = x->offsets[t], fj = x->offsets[t + 1];
+    int migliore = PLL_INFINITO;
+    while (i < fi && j < fj) {
+        if (x->hub[i] == x->hub[j]) {
+            int d = x->dist[i] + x->dist[j];
+            if (d < migliore) migliore = d;
+            i++;
+            j++;
+        } else if (x->hub[i] < x->hub[j]) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+    return migliore;
+}
+
+// Cammino minimo da s a t guidato dalle etichette: a ogni passo si sceglie un
+// vicino che le etichette danno a distanza esattamente inferiore di uno da t.
+// L'etichetta di t viene espansa in sc->dist_hub, così ogni vicino si controlla
+// con una sola scansione della sua etichetta, che si ferma al primo hub utile.
+// Scrive il cammino in sc->coda e restituisce il numero di nodi, 0 se non esiste.
+int pll_cerca_cammino(const pll_indice_t *x, const grafo_t *g, bfs_scratch_t *sc, int s, int t) {
+    int distanza = pll_distanza(x, s, t);
+    if (distanza >= PLL_INFINITO) return 0;
+    if (!sc->dist_hub) {
+        sc->dist_hub = (uint8_t *)arena_alloca(&sc->arena, x->tota_attori);
+        memset(sc->dist_hub, PLL_INFINITO, x->tota_attori);
+    }
+    uint8_t *dt = sc->dist_hub;
+    for (int64_t j = x->offsets[t]; j < x->offsets[t + 1]; ++j) dt[x->hub[j]] = x->dist[j];
+
+    int *path = sc->coda;
+    path[0] = s;
+    int cur = s;
+    for (int k = 1; k <= distanza && cur >= 0; ++k) {
+        int resto = distanza - k;
+        int prossimo = -1;
+        int64_t grado = g->offsets[cur + 1] - g->offsets[cur];
+        const int *vicini = grafo_vicini(g, cur, sc->vicini);
+        for (int64_t i = 0; i < grado && prossimo < 0; ++i) {
+            int n = vicini[i];
+            for (int64_t j = x->offsets[n]; j < x->offsets[n + 1]; ++j) {
+                if (x->dist[j] + dt[x->hub[j]] <= resto) {
+                    prossimo = n;
+                    break;
+                }
+            }
+        }
+        path[k] = cur = prossimo; // -1 solo se l'indice non è coerente con il grafo
+    }
+
+    for (int64_t j = x->offsets[t]; j < x->offsets[t + 1]; ++j) dt[x->hub[j]] = PLL_INFINITO;
+    return cur == t ? distanza + 1 : 0;
+}
+
+// Impronta del grafo, salvata nell'indice per riconoscere un file costruito su un altro grafo.
+static uint64_t grafo_impronta(const grafo_t *g) {
+    return snapshot_checksum(g->offsets, (g->tota_attori + 1) * sizeof(int64_t)) * 0x100000001b3ULL ^
+           snapshot_checksum(g->vicini, g->offsets[g->tota_attori] * sizeof(int));
+}
+
+// Scrive l'indice in '<path>.tmp', lo porta su disco e lo sostituisce a 'path'
+// con una rename, come CreaGrafo con grafo.bin: una versione in servizio che ha
+// mappato il vecchio indice lo conserva intatto, anche durante una ricarica.
+// Restituisce 0 se riesce, -1 altrimenti.
+int pll_salva(const pll_indice_t *x, const grafo_t *g, const char *path) {
+    pll_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PLL_MAGIC, 8);
+    h.versione = PLL_VERSIONE;
+    h.dim_header = sizeof(pll_header_t);
+    h.tota_attori = x->tota_attori;
+    h.num_etichette = x->num_etichette;
+    h.impronta_grafo = grafo_impronta(g);
+    size_t dim_offsets = (x->tota_attori + 1) * sizeof(int64_t);
+    size_t dim_hub = x->num_etichette * sizeof(int32_t);
+    h.off_offsets = sizeof(pll_header_t);
+    h.off_hub = h.off_offsets + dim_offsets;
+    h.off_dist = h.off_hub + ((dim_hub + 7) & ~(size_t)7);
+    h.chk_offsets = snapshot_checksum(x->offsets, dim_offsets);
+    h.chk_hub = snapshot_checksum(x->hub, dim_hub);
+    h.chk_dist = snapshot_checksum(x->dist, x->num_etichette);
+    h.chk_header = snapshot_checksum(&h, offsetof(pll_header_t, chk_header));
+
+    char temporaneo[PATH_MAX];
+    if (snprintf(temporaneo, sizeof(temporaneo), "%s.tmp", path) >= (int)sizeof(temporaneo)) {
+        fprintf(stderr, "Percorso dell'indice troppo lungo: %s\n", path);
+        return -1;
+    }
+    FILE *fp = fopen(temporaneo, "wb");
+    if (!fp) {
+        perror(temporaneo);
+        return -1;
+    }
+    static const char zeri[8] = { 0 };
+    int ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+             fwrite(x->offsets, 1, dim_offsets, fp) == dim_offsets &&
+             fwrite(x->hub, 1, dim_hub, fp) == dim_hub &&
+             fwrite(zeri, 1, h.off_dist - h.off_hub - dim_hub, fp) == (size_t)(h.off_dist - h.off_hub - dim_hub) &&
+             fwrite(x->dist, 1, x->num_etichette, fp) == (size_t)x->num_etichette;
+    if (ok && (fflush(fp) != 0 || fsync(fileno(fp)) != 0)) ok = 0;
+    if (fclose(fp) != 0) ok = 0;
+    if (ok && rename(temporaneo, path) != 0) ok = 0;
+    if (!ok) {
+        perror(temporaneo);
+        unlink(temporaneo);
+        return -1;
+    }
+    return 0;
+}
+
+// Mappa l'indice salvato in 'path', se esiste ed è stato costruito su questo grafo.
+// Con 'verifica' controlla anche i checksum delle sezioni. NULL se non utilizzabile.
+pll_indice_t *pll_carica(const grafo_t *g, const char *path, int verifica) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL; // Nessun indice salvato: verrà costruito
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(pll_header_t)) {
+        close(fd);
+        fprintf(stderr, "Indice %s non valido: troppo corto.\n", path);
+        return NULL;
+    }
+    size_t dim_file = (size_t)st.st_size;
+    void *mappa = mmap(NULL, dim_file, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mappa == MAP_FAILED) {
+        perror("mmap dell'indice fallita");
+        return NULL;
+    }
+
+    const char *base = (const char *)mappa;
+    const pll_header_t *h = (const pll_header_t *)mappa;
+    const char *errore = NULL;
+    if (memcmp(h->magic, PLL_MAGIC, 8) != 0 || h->versione != PLL_VERSIONE || h->dim_header != sizeof(pll_header_t)) {
+        errore = "formato non riconosciuto";
+    } else if (snapshot_checksum(h, offsetof(pll_header_t, chk_header)) != h->chk_header) {
+        errore = "intestazione corrotta";
+    } else if (h->tota_attori != g->tota_attori || h->impronta_grafo != grafo_impronta(g)) {
+        errore = "costruito su un grafo diverso";
+    } else if (h->num_etichette < 0 ||
+               !snapshot_sezione_valida(h->off_offsets, (h->tota_attori + 1) * (int64_t)sizeof(int64_t), sizeof(*h), dim_file) ||
+               !snapshot_sezione_valida(h->off_hub, h->num_etichette * (int64_t)sizeof(int32_t), sizeof(*h), dim_file) ||
+               !snapshot_sezione_valida(h->off_dist, h->num_etichette, sizeof(*h), dim_file)) {
+        errore = "sezioni fuori dal file";
+    } else if (verifica &&
+               (snapshot_checksum(base + h->off_offsets, (h->tota_attori + 1) * sizeof(int64_t)) != h->chk_offsets ||
+                snapshot_checksum(base + h->off_hub, h->num_etichette * sizeof(int32_t)) != h->chk_hub ||
+                snapshot_checksum(base + h->off_dist, h->num_etichette) != h->chk_dist)) {
+        errore = "checksum delle sezioni errato";
+    }
+    const int64_t *offsets = (const int64_t *)(base + h->off_offsets);
+    if (!errore && (offsets[0] != 0 || offsets[h->tota_attori] != h->num_etichette)) {
+        errore = "offsets incoerenti";
+    }
+    if (errore) {
+        fprintf(stderr, "Indice %s non valido: %s.\n", path, errore);
+        munmap(mappa, dim_file);
+        return NULL;
+    }
+
+    pll_indice_t *x = (pll_indice_t *)xmalloc(sizeof(pll_indice_t));
+    x->tota_attori = (int)h->tota_attori;
+    x->num_etichette = h->num_etichette;
+    x->offsets = offsets;
+    x->hub = (const int32_t *)(base + h->off_hub);
+    x->dist = (const uint8_t *)(base + h->off_dist);
+    x->mappa = mappa;
+    x->dim_mappa = dim_file;
+    return x;
+}
+
+// Carica l'indice da 'path' o, se manca o non è valido, lo costruisce e lo salva.
+// Riporta su stderr tempo e dimensione. NULL se non è stato possibile costruirlo.
+pll_indice_t *pll_prepara(const grafo_t *g, const char *path, int num_thread, int verifica) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pll_indice_t *x = pll_carica(g, path, verifica);
+    const char *origine = "caricato da";
+    if (!x) {
+        x = pll_costruisci(g, num_thread);
+        if (!x) {
+            fprintf(stderr, "Indice 2-hop non costruito: distanze oltre %d. Le query useranno la BFS.\n", PLL_INFINITO - 1);
+            return NULL;
+        }
+        origine = pll_salva(x, g, path) == 0 ? "costruito e salvato in" : "costruito (non salvato) per";
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secondi = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr, "Indice 2-hop %s %s in %.2f s: %" PRId64 " etichette (%.1f per attore, %.1f MB).\n",
+            origine, path, secondi, x->num_etichette, (double)x->num_etichette / x->tota_attori,
+            (x->num_etichette * 5.0 + (x->tota_attori + 1) * 8.0) / (1024.0 * 1024.0));
+    return x;
+}
+
+// --- Cache dei Risultati ---
+// Due livelli, entrambi entro il limite di memoria dato con -C:
+//  - cammini: tabella hash divisa in CACHE_SHARD parti, ognuna con il proprio
+//    mutex e la propria lista LRU. La chiave è la coppia non ordinata {s, t}:
+//    il cammino è salvato da min(s, t) a max(s, t) e restituito rovesciato
+//    quando serve, quindi una coppia chiesta nei due versi occupa una sola voce.
+//    Si salvano anche gli esiti "nessun cammino".
+//  - alberi: l'albero BFS completo (parent di ogni nodo) delle sorgenti chieste
+//    più spesso. Qualunque richiesta che ha una di queste sorgenti come partenza
+//    o come arrivo si risolve risalendo i parent, senza BFS.
+// Ogni versione del grafo (vedi "Ricarica a Caldo") ha la propria cache, che
+// nasce vuota: gli id densi di una versione non valgono per le altre.
+#define CACHE_SHARD 64
+#define CACHE_MAX_ALBERI 64
+// Richieste oltre le quali una sorgente merita un albero. Una BFS completa costa
+// quanto molte query bidirezionali o dall'indice: in quei casi la soglia è più alta.
+#define CACHE_SOGLIA_SORGENTE 4
+#define CACHE_SOGLIA_SORGENTE_VELOCE 64
+
+typedef struct voce_cache {
+    int a, b;                       // id densi, a < b
+    int lunghezza;                  // nodi del cammino da a a b, 0 se non esiste
+    struct voce_cache *succ_hash;
+    struct voce_cache *prec_lru, *succ_lru;
+    int cammino[];
+} voce_cache_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    voce_cache_t **bucket;
+    size_t num_bucket, num_voci;
+    voce_cache_t *lru_testa, *lru_coda;  // in testa la voce usata più di recente
+    size_t memoria;
+} shard_cache_t;
+
+typedef struct {
+    int sorgente;                   // -1 se il posto è libero
+    int pronto;                     // 0 mentre un worker lo sta costruendo
+    int riferimenti;                // worker che lo stanno leggendo o costruendo
+    int *parent;                    // parent[v], -1 se non raggiunto; parent[sorgente] = sorgente
+} albero_cache_t;
+
+struct cache {
+    shard_cache_t shard[CACHE_SHARD];
+    size_t limite_shard;            // byte di cammini per shard
+    int tota_attori;
+    uint32_t *richieste_sorgente;   // richieste per attore, come partenza o arrivo (atomico)
+    pthread_mutex_t mutex_alberi;
+    albero_cache_t alberi[CACHE_MAX_ALBERI];
+    int max_alberi;
+    uint32_t soglia_albero;
+    // Statistiche (atomiche)
+    uint64_t ricerche, hit_cammini, hit_alberi, alberi_costruiti;
+};
+
+static inline uint64_t cache_hash(int a, int b) {
+    uint64_t h = ((uint64_t)(uint32_t)a << 32) | (uint32_t)b;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Crea una cache di al più 'mb' MB: fino a metà per gli alberi BFS, il resto per i cammini.
+cache_t *cache_create(long mb, int tota_attori, uint32_t soglia_albero) {
+    cache_t *c = (cache_t *)calloc(1, sizeof(cache_t));
+    if (!c) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    size_t limite = (size_t)mb * 1024 * 1024;
+    size_t dim_albero = (size_t)tota_attori * sizeof(int);
+    c->max_alberi = (int)((limite / 2) / dim_albero);
+    if (c->max_alberi > CACHE_MAX_ALBERI) c->max_alberi = CACHE_MAX_ALBERI;
+    c->limite_shard = (limite - c->max_alberi * dim_albero) / CACHE_SHARD;
+    c->tota_attori = tota_attori;
+    c->soglia_albero = soglia_albero;
+    c->richieste_sorgente = (uint32_t *)calloc(tota_attori, sizeof(uint32_t));
+    if (!c->richieste_sorgente) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    for (int i = 0; i < CACHE_SHARD; ++i) {
+        shard_cache_t *sh = &c->shard[i];
+        sh->num_bucket = 1024;
+        sh->bucket = (voce_cache_t **)calloc(sh->num_bucket, sizeof(voce_cache_t *));
+        if (!sh->bucket || pthread_mutex_init(&sh->mutex, NULL) != 0) {
+            perror("inizializzazione della cache fallita");
+            fallisci();
+        }
+    }
+    for (int i = 0; i < CACHE_MAX_ALBERI; ++i) c->alberi[i].sorgente = -1;
+    if (pthread_mutex_init(&c->mutex_alberi, NULL) != 0) {
+        perror("pthread_mutex_init per la cache fallita");
+        fallisci();
+    }
+    return c;
+}
+
+static void shard_stacca_lru(shard_cache_t *sh, voce_cache_t *v) {
+    if (v->prec_lru) v->prec_lru->succ_lru = v->succ_lru;
+    else sh->lru_testa = v->succ_lru;
+    if (v->succ_lru) v->succ_lru->prec_lru = v->prec_lru;
+    else sh->lru_coda = v->prec_lru;
+}
+
+static void shard_metti_in_testa(shard_cache_t *sh, voce_cache_t *v) {
+    v->prec_lru = NULL;
+    v->succ_lru = sh->lru_testa;
+    if (sh->lru_testa) sh->lru_testa->prec_lru = v;
+    sh->lru_testa = v;
+    if (!sh->lru_coda) sh->lru_coda = v;
+}
+
+// Toglie dallo shard la voce usata meno di recente. Chiamata con il mutex dello shard.
+static void shard_scarta_lru(shard_cache_t *sh) {
+    voce_cache_t *v = sh->lru_coda;
+    voce_cache_t **pp = &sh->bucket[cache_hash(v->a, v->b) & (sh->num_bucket - 1)];
+    while (*pp != v) pp = &(*pp)->succ_hash;
+    *pp = v->succ_hash;
+    shard_stacca_lru(sh, v);
+    sh->memoria -= sizeof(voce_cache_t) + v->lunghezza * sizeof(int);
+    sh->num_voci--;
+    free(v);
+}
+
+// Raddoppia i bucket quando le voci li superano. Chiamata con il mutex dello shard.
+static void shard_cresci(shard_cache_t *sh) {
+    size_t nuovi = sh->num_bucket * 2;
+    voce_cache_t **bucket = (voce_cache_t **)calloc(nuovi, sizeof(voce_cache_t *));
+    if (!bucket) return; // Si continua con catene più lunghe
+    for (size_t i = 0; i < sh->num_bucket; ++i) {
+        voce_cache_t *v = sh->bucket[i];
+        while (v) {
+            voce_cache_t *succ = v->succ_hash;
+            size_t k = cache_hash(v->a, v->b) & (nuovi - 1);
+            v->succ_hash = bucket[k];
+            bucket[k] = v;
+            v = succ;
+        }
+    }
+    free(sh->bucket);
+    sh->bucket = bucket;
+    sh->num_bucket = nuovi;
+}
+
+// Copia in 'path' il cammino da s a t dell'albero di sorgente 'radice' (s o t).
+static int albero_cammino(const albero_cache_t *al, int s, int t, int *path) {
+    int altro = (al->sorgente == s) ? t : s;
+    if (al->parent[altro] < 0) return 0;
+    int n = 0;
+    for (int v = altro; ; v = al->parent[v]) {
+        path[n++] = v;
+        if (v == al->sorgente) break;
+    }
+    // La risalita va da 'altro' alla sorgente: è già nel verso giusto se la sorgente è t
+    if (al->sorgente == s) {
+        for (int i = 0, j = n - 1; i < j; ++i, --j) {
+            int tmp = path[i]; path[i] = path[j]; path[j] = tmp;
+        }
+    }
+    return n;
+}
+
+// BFS completa dalla sorgente dell'albero, usando sc->coda come coda.
+static void albero_costruisci(const grafo_t *g, bfs_scratch_t *sc, albero_cache_t *al) {
+    memset(al->parent, 0xff, g->tota_attori * sizeof(int));
+    int head = 0, tail = 0;
+    sc->coda[tail++] = al->sorgente;
+    al->parent[al->sorgente] = al->sorgente;
+    while (head < tail) {
+        int u = sc->coda[head++];
+        int64_t grado = g->offsets[u + 1] - g->offsets[u];
+        const int *vicini = grafo_vicini(g, u, sc->vicini);
+        for (int64_t i = 0; i < grado; ++i) {
+            int n = vicini[i];
+            if (al->parent[n] < 0) {
+                al->parent[n] = u;
+                sc->coda[tail++] = n;
+            }
+        }
+    }
+}
+
+// Cerca il risultato della richiesta s -> t (s != t) nella cache. Restituisce
+// il numero di nodi del cammino scritto in sc->coda (0 se non esiste), oppure
+// -1 se la cache non lo conosce. Se s o t è ormai una sorgente frequente e
+// c'è posto, costruisce il suo albero BFS e risponde da lì.
+int cache_cerca(cache_t *c, const grafo_t *g, bfs_scratch_t *sc, int s, int t) {
+    __atomic_add_fetch(&c->ricerche, 1, __ATOMIC_RELAXED);
+    int *path = sc->coda;
+
+    // 1. Cammini già calcolati, in entrambi i versi
+    int a = s < t ? s : t, b = s < t ? t : s;
+    uint64_t h = cache_hash(a, b);
+    shard_cache_t *sh = &c->shard[h >> 58]; // 6 bit alti: CACHE_SHARD == 64
+    int trovato = -1;
+    pthread_mutex_lock(&sh->mutex);
+    for (voce_cache_t *v = sh->bucket[h & (sh->num_bucket - 1)]; v; v = v->succ_hash) {
+        if (v->a == a && v->b == b) {
+            trovato = v->lunghezza;
+            if (s == a) {
+                memcpy(path, v->cammino, v->lunghezza * sizeof(int));
+            } else {
+                for (int i = 0; i < v->lunghezza; ++i) path[i] = v->cammino[v->lunghezza - 1 - i];
+            }
+            shard_stacca_lru(sh, v);
+            shard_metti_in_testa(sh, v);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sh->mutex);
+    if (trovato >= 0) {
+        __atomic_add_fetch(&c->hit_cammini, 1, __ATOMIC_RELAXED);
+        return trovato;
+    }
+    if (c->max_alberi == 0) return -1;
+
+    // 2. Alberi delle sorgenti frequenti
+    uint32_t freq_s = __atomic_add_fetch(&c->richieste_sorgente[s], 1, __ATOMIC_RELAXED);
+    uint32_t freq_t = __atomic_add_fetch(&c->richieste_sorgente[t], 1, __ATOMIC_RELAXED);
+    albero_cache_t *al = NULL;
+    int da_costruire = 0;
+    pthread_mutex_lock(&c->mutex_alberi);
+    for (int i = 0; i < c->max_alberi && !al; ++i) {
+        albero_cache_t *x = &c->alberi[i];
+        if (x->pronto && (x->sorgente == s || x->sorgente == t)) al = x;
+    }
+    if (!al && (freq_s >= c->soglia_albero || freq_t >= c->soglia_albero)) {
+        // 3. Nuovo albero per la più frequente delle due: in un posto libero o al
+        // posto dell'albero non in uso con la sorgente meno richiesta, se lo è meno.
+        int sorgente = freq_s >= freq_t ? s : t;
+        uint32_t freq = freq_s >= freq_t ? freq_s : freq_t;
+        int in_costruzione = 0;
+        for (int i = 0; i < c->max_alberi; ++i) {
+            if (c->alberi[i].sorgente == sorgente) in_costruzione = 1;
+        }
+        for (int i = 0; i < c->max_alberi && !in_costruzione; ++i) {
+            albero_cache_t *x = &c->alberi[i];
+            if (x->sorgente < 0) {
+                al = x;
+                break;
+            }
+            if (x->riferimenti == 0 &&
+                __atomic_load_n(&c->richieste_sorgente[x->sorgente], __ATOMIC_RELAXED) < freq &&
+                (!al || __atomic_load_n(&c->richieste_sorgente[x->sorgente], __ATOMIC_RELAXED) <
+                        __atomic_load_n(&c->richieste_sorgente[al->sorgente], __ATOMIC_RELAXED))) {
+                al = x;
+            }
+        }
+        if (al) {
+            al->sorgente = sorgente;
+            al->pronto = 0;
+            da_costruire = 1;
+        }
+    }
+    if (al) al->riferimenti++;
+    pthread_mutex_unlock(&c->mutex_alberi);
+    if (!al) return -1;
+
+    if (da_costruire) {
+        // Il posto è riservato (riferimenti > 0, pronto == 0): nessun altro lo tocca
+        if (!al->parent) al->parent = (int *)xmalloc(g->tota_attori * sizeof(int));
+        albero_costruisci(g, sc, al);
+        __atomic_add_fetch(&c->alberi_costruiti, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_add_fetch(&c->hit_alberi, 1, __ATOMIC_RELAXED);
+    }
+    int lunghezza = albero_cammino(al, s, t, path);
+
+    pthread_mutex_lock(&c->mutex_alberi);
+    al->pronto = 1;
+    al->riferimenti--;
+    pthread_mutex_unlock(&c->mutex_alberi);
+    return lunghezza;
+}
+
+// Registra il risultato della richiesta s -> t (path_len nodi in path, 0 se
+// non esiste), scartando le voci meno recenti se lo shard supera il limite.
+void cache_registra(cache_t *c, int s, int t, const int *path, int path_len) {
+    size_t dim = sizeof(voce_cache_t) + path_len * sizeof(int);
+    if (s == t || dim > c->limite_shard) return;
+    int a = s < t ? s : t, b = s < t ? t : s;
+    voce_cache_t *nuova = (voce_cache_t *)xmalloc(dim);
+    nuova->a = a;
+    nuova->b = b;
+    nuova->lunghezza = path_len;
+    if (s == a) {
+        memcpy(nuova->cammino, path, path_len * sizeof(int));
+    } else {
+        for (int i = 0; i < path_len; ++i) nuova->cammino[i] = path[path_len - 1 - i];
+    }
+
+    uint64_t h = cache_hash(a, b);
+    shard_cache_t *sh = &c->shard[h >> 58];
+    pthread_mutex_lock(&sh->mutex);
+    voce_cache_t *v = sh->bucket[h & (sh->num_bucket - 1)];
+    while (v && !(v->a == a && v->b == b)) v = v->succ_hash;
+    if (v) { // Già registrata da un altro worker nel frattempo
+        pthread_mutex_unlock(&sh->mutex);
+        free(nuova);
+        return;
+    }
+    while (sh->lru_coda && sh->memoria + dim > c->limite_shard) shard_scarta_lru(sh);
+    if (sh->num_voci >= sh->num_bucket) shard_cresci(sh);
+    size_t k = h & (sh->num_bucket - 1);
+    nuova->succ_hash = sh->bucket[k];
+    sh->bucket[k] = nuova;
+    shard_metti_in_testa(sh, nuova);
+    sh->memoria += dim;
+    sh->num_voci++;
+    pthread_mutex_unlock(&sh->mutex);
+}
+
+// Svuota la cache (cammini, alberi e frequenze), ad esempio dopo un
+// ricaricamento del grafo. Non deve essere chiamata con richieste in corso.
+void cache_invalida(cache_t *c) {
+    for (int i = 0; i < CACHE_SHARD; ++i) {
+        shard_cache_t *sh = &c->shard[i];
+        pthread_mutex_lock(&sh->mutex);
+        while (sh->lru_coda) shard_scarta_lru(sh);
+        pthread_mutex_unlock(&sh->mutex);
+    }
+    pthread_mutex_lock(&c->mutex_alberi);
+    for (int i = 0; i < c->max_alberi; ++i) {
+        c->alberi[i].sorgente = -1;
+        c->alberi[i].pronto = 0;
+    }
+    memset(c->richieste_sorgente, 0, c->tota_attori * sizeof(uint32_t));
+    pthread_mutex_unlock(&c->mutex_alberi);
+}
+
+// Stampa su 'fp' hit rate e memoria occupata dalla cache.
+void cache_stampa_statistiche(cache_t *c, FILE *fp) {
+    size_t memoria = 0, voci = 0;
+    for (int i = 0; i < CACHE_SHARD; ++i) {
+        pthread_mutex_lock(&c->shard[i].mutex);
+        memoria += c->shard[i].memoria;
+        voci += c->shard[i].num_voci;
+        pthread_mutex_unlock(&c->shard[i].mutex);
+    }
+    int alberi = 0;
+    pthread_mutex_lock(&c->mutex_alberi);
+    for (int i = 0; i < c->max_alberi; ++i) {
+        if (c->alberi[i].parent) alberi++;
+    }
+    pthread_mutex_unlock(&c->mutex_alberi);
+    uint64_t ricerche = __atomic_load_n(&c->ricerche, __ATOMIC_RELAXED);
+    uint64_t hit_cammini = __atomic_load_n(&c->hit_cammini, __ATOMIC_RELAXED);
+    uint64_t hit_alberi = __atomic_load_n(&c->hit_alberi, __ATOMIC_RELAXED);
+    double perc = ricerche ? 100.0 / ricerche : 0;
+    fprintf(fp, "Cache: %" PRIu64 " ricerche, %.1f%% dai cammini, %.1f%% dagli alberi BFS "
+                "(%" PRIu64 " alberi costruiti); %zu cammini in %.1f MB, %d alberi in %.1f MB\n",
+            ricerche, hit_cammini * perc, hit_alberi * perc,
+            __atomic_load_n(&c->alberi_costruiti, __ATOMIC_RELAXED), voci, memoria / (1024.0 * 1024.0),
+            alberi, alberi * (double)c->tota_attori * sizeof(int) / (1024.0 * 1024.0));
+}
+
+void cache_destroy(cache_t *c) {
+    if (!c) return;
+    cache_invalida(c);
+    for (int i = 0; i < CACHE_SHARD; ++i) {
+        pthread_mutex_destroy(&c->shard[i].mutex);
+        free(c->shard[i].bucket);
+    }
+    for (int i = 0; i < CACHE_MAX_ALBERI; ++i) free(c->alberi[i].parent);
+    pthread_mutex_destroy(&c->mutex_alberi);
+    free(c->richieste_sorgente);
+    free(c);
+}
+
+// --- Scrittore Asincrono dei Risultati ---
+// Con -o i worker non creano un file per richiesta: accodano un record nel
+// buffer attivo dello scrittore e proseguono. Il thread dello scrittore scambia
+// il buffer attivo con il proprio e lo scrive con una sola write, quindi sotto
+// carico i record arrivati durante una scrittura partono tutti insieme nella
+// successiva. Oltre SCRITTORE_LIMITE byte in attesa i worker si fermano.
+//
+// Ogni record è un record_esito_t seguito da 'dim' byte: lo stesso testo che
+// altrimenti andrebbe nel file <start>.<end>. Un log viene aperto in append; una
+// FIFO viene aperta quando compare un lettore, e se il lettore chiude il resto
+// della scrittura in corso viene scartato, così il successivo riparte da un record intero.
+#define SCRITTORE_LIMITE (8 * 1024 * 1024)
+
+typedef struct {
+    uint32_t dim;               // byte di testo che seguono
+    int32_t start_codice;
+    int32_t end_codice;
+} record_esito_t;
+
+// Buffer di byte che cresce a richiesta
+typedef struct {
+    char *dati;
+    size_t dim, cap;
+} buffer_t;
+
+static void buffer_riserva(buffer_t *b, size_t extra) {
+    if (b->dim + extra <= b->cap) return;
+    size_t cap = b->cap ? b->cap : 256;
+    while (cap < b->dim + extra) cap *= 2;
+    char *dati = (char *)realloc(b->dati, cap);
+    if (!dati) {
+        perror("realloc fallita");
+        fallisci();
+    }
+    b->dati = dati;
+    b->cap = cap;
+}
+
+static void buffer_aggiungi(buffer_t *b, const void *dati, size_t dim) {
+    buffer_riserva(b, dim);
+    memcpy(b->dati + b->dim, dati, dim);
+    b->dim += dim;
+}
+
+static void buffer_printf(buffer_t *b, const char *formato, ...) {
+    va_list ap;
+    va_start(ap, formato);
+    int n = vsnprintf(b->dati + b->dim, b->cap - b->dim, formato, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if ((size_t)n >= b->cap - b->dim) {
+        buffer_riserva(b, n + 1);
+        va_start(ap, formato);
+        vsnprintf(b->dati + b->dim, b->cap - b->dim, formato, ap);
+        va_end(ap);
+    }
+    b->dim += n;
+}
+
+struct scrittore {
+    const char *path;
+    int fifo;
+    int fd;                     // -1 se la FIFO non ha ancora un lettore
+    long fsync_ms;
+    pthread_t tid;
+    pthread_mutex_t mutex;      // protegge i campi seguenti
+    pthread_cond_t dati;        // il buffer attivo non è vuoto, o si termina
+    pthread_cond_t spazio;      // il buffer attivo è sceso sotto il limite
+    buffer_t attivo;            // riempito dai worker
+    int termina;
+    // Statistiche, lette da scrittore_destroy dopo il join: record è contato dai
+    // worker in scrittore_accoda, sotto il mutex; le altre solo dal thread dello scrittore
+    uint64_t record, byte, scritture, sincronizzazioni, scartati;
+};
+
+// Apre la FIFO senza bloccarsi finché non c'è un lettore; rinuncia se si termina.
+static int scrittore_apri_fifo(scrittore_t *w) {
+    for (;;) {
+        int fd = open(w->path, O_WRONLY | O_NONBLOCK);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+            return fd;
+        }
+        if (errno != ENXIO) {
+            perror("apertura della FIFO dei risultati fallita");
+            return -1;
+        }
+        pthread_mutex_lock(&w->mutex);
+        int termina = w->termina;
+        pthread_mutex_unlock(&w->mutex);
+        if (termina) return -1;
+        usleep(100 * 1000);
+    }
+}
+
+static void scrittore_scrivi(scrittore_t *w, const char *dati, size_t dim) {
+    if (w->fd < 0 && w->fifo) w->fd = scrittore_apri_fifo(w);
+    if (w->fd < 0) {
+        w->scartati += dim;
+        return;
+    }
+    size_t scritti = 0;
+    while (scritti < dim) {
+        ssize_t n = write(w->fd, dati + scritti, dim - scritti);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            perror("scrittura dei risultati fallita");
+            w->scartati += dim - scritti;
+            if (w->fifo) { // Il lettore ha chiuso: si aspetterà il prossimo
+                close(w->fd);
+                w->fd = -1;
+            }
+            break;
+        }
+        scritti += n;
+    }
+    w->byte += scritti;
+    w->scritture++;
+}
+
+static void scrittore_sincronizza(scrittore_t *w, struct timespec *ultima) {
+    if (w->fd >= 0 && !w->fifo && fdatasync(w->fd) == 0) w->sincronizzazioni++;
+    clock_gettime(CLOCK_REALTIME, ultima);
+}
+
+static void *scrittore_thread_func(void *arg) {
+    scrittore_t *w = (scrittore_t *)arg;
+    buffer_t mio = { NULL, 0, 0 };
+    struct timespec ultima;
+    clock_gettime(CLOCK_REALTIME, &ultima);
+    int da_sincronizzare = 0;
+
+    pthread_mutex_lock(&w->mutex);
+    for (;;) {
+        while (w->attivo.dim == 0 && !w->termina) {
+            if (da_sincronizzare && w->fsync_ms > 0) {
+                // Dati non ancora su disco: si attende al più fino alla scadenza dell'fsync
+                struct timespec scadenza = ultima;
+                scadenza.tv_sec += w->fsync_ms / 1000;
+                scadenza.tv_nsec += (w->fsync_ms % 1000) * 1000000L;
+                if (scadenza.tv_nsec >= 1000000000L) {
+                    scadenza.tv_sec++;
+                    scadenza.tv_nsec -= 1000000000L;
+                }
+                if (pthread_cond_timedwait(&w->dati, &w->mutex, &scadenza) == ETIMEDOUT) break;
+            } else {
+                pthread_cond_wait(&w->dati, &w->mutex);
+            }
+        }
+        if (w->attivo.dim == 0 && w->termina) break;
+
+        // Scambio dei buffer: i worker ripartono subito su quello vuoto
+        buffer_t pieno = w->attivo;
+        w->attivo = mio;
+        w->attivo.dim = 0;
+        pthread_cond_broadcast(&w->spazio);
+        pthread_mutex_unlock(&w->mutex);
+
+        if (pieno.dim > 0) {
+            scrittore_scrivi(w, pieno.dati, pieno.dim);
+            da_sincronizzare = 1;
+        }
+        mio = pieno;
+        if (da_sincronizzare && w->fsync_ms >= 0) {
+            struct timespec ora;
+            clock_gettime(CLOCK_REALTIME, &ora);
+            long trascorsi_ms = (ora.tv_sec - ultima.tv_sec) * 1000 + (ora.tv_nsec - ultima.tv_nsec) / 1000000;
+            if (trascorsi_ms >= w->fsync_ms) {
+                scrittore_sincronizza(w, &ultima);
+                da_sincronizzare = 0;
+            }
+        }
+        pthread_mutex_lock(&w->mutex);
+    }
+    pthread_mutex_unlock(&w->mutex);
+    if (da_sincronizzare && w->fsync_ms >= 0) scrittore_sincronizza(w, &ultima);
+    free(mio.dati);
+    return NULL;
+}
+
+// Crea lo scrittore per 'path': se è una FIFO esistente i risultati vanno al
+// suo lettore, altrimenti vengono aggiunti in coda al file (creato se manca).
+// 'fsync_ms' come in opzioni_t.
+scrittore_t *scrittore_create(const char *path, long fsync_ms) {
+    scrittore_t *w = (scrittore_t *)calloc(1, sizeof(scrittore_t));
+    if (!w) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    struct stat st;
+    w->path = path;
+    w->fifo = stat(path, &st) == 0 && S_ISFIFO(st.st_mode);
+    w->fsync_ms = fsync_ms;
+    w->fd = -1;
+    if (!w->fifo) {
+        w->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (w->fd == -1) {
+            perror("apertura del log dei risultati fallita");
+            fallisci();
+        }
+    }
+    if (pthread_mutex_init(&w->mutex, NULL) != 0 ||
+        pthread_cond_init(&w->dati, NULL) != 0 ||
+        pthread_cond_init(&w->spazio, NULL) != 0) {
+        perror("inizializzazione dello scrittore fallita");
+        fallisci();
+    }
+    if (pthread_create(&w->tid, NULL, scrittore_thread_func, w) != 0) {
+        perror("pthread_create per lo scrittore fallito");
+        fallisci();
+    }
+    return w;
+}
+
+// Accoda il record di una richiesta; attende se lo scrittore è indietro di
+// oltre SCRITTORE_LIMITE byte.
+void scrittore_accoda(scrittore_t *w, const richiesta_t *req, const char *testo, size_t dim) {
+    record_esito_t rec = { (uint32_t)dim, req->start_codice, req->end_codice };
+    pthread_mutex_lock(&w->mutex);
+    while (w->attivo.dim > 0 && w->attivo.dim + sizeof(rec) + dim > SCRITTORE_LIMITE) {
+        pthread_cond_wait(&w->spazio, &w->mutex);
+    }
+    buffer_aggiungi(&w->attivo, &rec, sizeof(rec));
+    buffer_aggiungi(&w->attivo, testo, dim);
+    w->record++;
+    pthread_cond_signal(&w->dati);
+    pthread_mutex_unlock(&w->mutex);
+}
+
+// Scrive i record rimasti, applica l'ultimo fsync e libera lo scrittore.
+// I worker devono aver già terminato.
+void scrittore_destroy(scrittore_t *w) {
+    if (!w) return;
+    pthread_mutex_lock(&w->mutex);
+    w->termina = 1;
+    pthread_cond_signal(&w->dati);
+    pthread_mutex_unlock(&w->mutex);
+    pthread_join(w->tid, NULL);
+
+    fprintf(stderr, "Risultati: %" PRIu64 " record, %.1f MB in %" PRIu64 " scritture, %" PRIu64 " fsync",
+            w->record, w->byte / (1024.0 * 1024.0), w->scritture, w->sincronizzazioni);
+    if (w->scartati) fprintf(stderr, ", %" PRIu64 " byte scartati", w->scartati);
+    fprintf(stderr, "\n");
+
+    if (w->fd >= 0) close(w->fd);
+    pthread_mutex_destroy(&w->mutex);
+    pthread_cond_destroy(&w->dati);
+    pthread_cond_destroy(&w->spazio);
+    free(w->attivo.dati);
+    free(w);
+}
+
+// --- Connessioni dei Client su Socket ---
+// Con -S i client si collegano a un socket Unix e inviano le richieste con lo
+// stesso protocollo di cammini.pipe, anche molte alla volta senza attendere le
+// risposte. Ogni risposta torna sulla connessione che l'ha chiesta, come record
+// record_esito_t (lo stesso formato di -o), nell'ordine in cui i worker le
+// completano: start ed end del record permettono al client di abbinarle.
+//
+// Il main legge le connessioni nel suo ciclo epoll; i worker scrivono le
+// risposte direttamente sul socket, senza bloccarsi: quello che il socket non
+// accetta resta in 'uscita' e il main lo completa quando il socket torna
+// scrivibile (EPOLLOUT). Solo il main chiude e libera una connessione, e solo
+// quando non ha più richieste in corso, quindi un worker non trova mai un
+// descrittore chiuso o riusato.
+#define CONNESSIONE_LIMITE_USCITA (4 * 1024 * 1024) // oltre, si smette di leggere il client
+
+struct connessione {
+    int fd;
+    int epoll_fd;
+    pthread_mutex_t mutex;      // protegge i campi seguenti, usati anche dai worker
+    buffer_t uscita;            // risposte non ancora accettate dal socket
+    size_t inviati;             // byte di 'uscita' già scritti
+    int in_corso;               // richieste accodate e non ancora risposte
+    int fine_richieste;         // il client ha chiuso in scrittura, o la connessione è rotta
+    int rotta;                  // errore sul socket: le risposte vengono scartate
+    int in_pausa;               // lettura sospesa finché 'uscita' non si svuota
+    uint32_t eventi;            // eventi registrati in epoll
+    int registrata;             // il descrittore è in epoll
+    // Usati solo dal main
+    char resto[8 + NOMI_MAX_TESTO]; // byte di una parola o di una richiesta per nome incompleta
+    size_t dim_resto;
+    uint32_t rimaste;           // coppie ancora attese del batch corrente
+    struct connessione *prec, *succ;
+};
+
+// Scrive sul socket quanto possibile di 'uscita'. Chiamata con il mutex.
+static void connessione_scrivi(connessione_t *c) {
+    while (!c->rotta && c->inviati < c->uscita.dim) {
+        ssize_t n = send(c->fd, c->uscita.dati + c->inviati, c->uscita.dim - c->inviati,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0) {
+            c->rotta = 1;
+            c->fine_richieste = 1;
+            break;
+        }
+        c->inviati += n;
+    }
+    if (c->rotta || c->inviati == c->uscita.dim) {
+        c->uscita.dim = 0;
+        c->inviati = 0;
+    } else if (c->inviati > c->uscita.dim / 2) {
+        // Si recupera lo spazio già inviato
+        memmove(c->uscita.dati, c->uscita.dati + c->inviati, c->uscita.dim - c->inviati);
+        c->uscita.dim -= c->inviati;
+        c->inviati = 0;
+    }
+}
+
+// La connessione può essere chiusa dal main. Chiamata con il mutex.
+static int connessione_finita(const connessione_t *c) {
+    return c->fine_richieste && c->in_corso == 0 && c->uscita.dim == 0;
+}
+
+// Allinea gli eventi registrati in epoll allo stato. Chiamata con il mutex.
+static void connessione_aggiorna_eventi(connessione_t *c) {
+    if (c->rotta && c->in_corso > 0) {
+        // EPOLLHUP verrebbe segnalato di continuo: si torna in epoll solo quando
+        // l'ultima risposta in corso è stata scartata
+        if (c->registrata) epoll_ctl(c->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+        c->registrata = 0;
+        return;
+    }
+    uint32_t eventi = 0;
+    if (!c->fine_richieste && !c->in_pausa) eventi |= EPOLLIN;
+    // EPOLLOUT anche per far chiudere al main una connessione finita
+    if (c->uscita.dim > 0 || connessione_finita(c)) eventi |= EPOLLOUT;
+    if (c->registrata && eventi == c->eventi) return;
+    struct epoll_event ev = { .events = eventi };
+    ev.data.ptr = c;
+    epoll_ctl(c->epoll_fd, c->registrata ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, c->fd, &ev);
+    c->eventi = eventi;
+    c->registrata = 1;
+}
+
+// Chiamata da un worker: consegna la risposta a una richiesta della connessione.
+void connessione_invia(connessione_t *c, const richiesta_t *req, const char *testo, size_t dim) {
+    record_esito_t rec = { (uint32_t)dim, req->start_codice, req->end_codice };
+    pthread_mutex_lock(&c->mutex);
+    if (!c->rotta) {
+        buffer_aggiungi(&c->uscita, &rec, sizeof(rec));
+        buffer_aggiungi(&c->uscita, testo, dim);
+        connessione_scrivi(c);
+    }
+    c->in_corso--;
+    if (c->uscita.dim < CONNESSIONE_LIMITE_USCITA / 2) c->in_pausa = 0;
+    connessione_aggiorna_eventi(c);
+    pthread_mutex_unlock(&c->mutex);
+}
+
+// --- Titoli in Comune ---
+// Con -P ogni cammino scritto è seguito, passo per passo, dai titoli in cui i
+// due attori hanno recitato insieme, nel formato di collaborazioni.py, che non
+// serve più rilanciare sull'output. partecipazioni.txt diventa un CSR sugli id
+// densi del grafo, caricato in due passate parallele come grafo.txt; i titoli
+// di ogni attore sono già in ordine (CreaGrafo li scrive così), quindi i titoli
+// in comune sono l'intersezione di due righe ordinate:
+//  - righe di lunghezza simile: blocchi di 4 contro 4 con SSE2, confrontando
+//    ogni elemento con i quattro dell'altro blocco ruotato, e avanzando il
+//    blocco con l'ultimo elemento minore;
+//  - una riga molto più corta dell'altra: per ogni suo titolo una ricerca a
+//    galoppo (passi che raddoppiano, poi binaria) nella riga lunga.
+// Con -t i titoli hanno anche un nome: da title.basics.tsv si tengono solo
+// quelli dei titoli presenti nelle partecipazioni.
+#define TITOLI_MAX_PER_PASSO 32     // titoli elencati al più per ogni passo del cammino
+#define TITOLI_GALOPPO 16           // rapporto tra le lunghezze oltre il quale si galoppa
+
+// partecipazioni.txt, passo 2: come grafo_analizza_thread_func, ma i valori
+// sono codici di titoli e restano tali. Le righe di attori assenti da
+// nomi.txt e quelle ripetute si saltano in silenzio.
+static void *partecipazioni_analizza_thread_func(void *arg) {
+    blocco_testo_t *b = (blocco_testo_t *)arg;
+    const grafo_t *g = b->g;
+    for (const char *p = b->inizio; p < b->fine; ) {
+        const char *inizio_riga = p;
+        int codice, valore;
+        if (scan_intero(&p, b->fine, &codice)) {
+            int id = grafo_id(g, codice);
+            if (id >= 0 && b->prima_riga[id] == inizio_riga && scan_intero(&p, b->fine, &valore)) { // numero di titoli
+                int32_t *riga = b->part->titoli + b->part->inizio[id];
+                int num = 0;
+                while (num < b->gradi[id] && scan_intero(&p, b->fine, &valore)) riga[num++] = valore;
+                b->scritti[id] = num;
+            }
+        }
+        p = prossima_riga(p, b->fine);
+    }
+    return NULL;
+}
+
+// Riga [p, fr) di title.basics.tsv (tconst, titleType, primaryTitle, ...):
+// restituisce la posizione del titolo in part->codici e il suo nome, o -1 se
+// il titolo non compare nelle partecipazioni o la riga è malformata.
+static int64_t titoli_riga(const partecipazioni_t *part, const char *p, const char *fr,
+                           const char **nome, size_t *dim) {
+    const char *tab1 = memchr(p, '\t', fr - p);
+    const char *tab2 = tab1 ? memchr(tab1 + 1, '\t', fr - tab1 - 1) : NULL;
+    const char *tab3 = tab2 ? memchr(tab2 + 1, '\t', fr - tab2 - 1) : NULL;
+    if (!tab3 || tab1 - p < 3 || p[0] != 't' || p[1] != 't') return -1; // Anche l'intestazione
+    const char *q = p + 2;
+    int codice;
+    if (!scan_intero(&q, tab1, &codice)) return -1;
+    const int32_t *trovato = (const int32_t *)bsearch(&codice, part->codici, part->num_codici,
+                                                      sizeof(int32_t), confronta_int);
+    if (!trovato) return -1;
+    *nome = tab2 + 1;
+    *dim = tab3 - tab2 - 1;
+    return trovato - part->codici;
+}
+
+// title.basics.tsv, passo 1: byte dei nomi (con '\0') dei titoli delle partecipazioni.
+static void *titoli_conta_thread_func(void *arg) {
+    blocco_testo_t *b = (blocco_testo_t *)arg;
+    int64_t byte_nomi = 0;
+    for (const char *p = b->inizio; p < b->fine; ) {
+        const char *fr = fine_riga(p, b->fine);
+        const char *nome;
+        size_t dim;
+        if (titoli_riga(b->part, p, fr, &nome, &dim) >= 0) byte_nomi += dim + 1;
+        p = fr < b->fine ? fr + 1 : b->fine;
+    }
+    b->byte_nomi = byte_nomi;
+    return NULL;
+}
+
+// title.basics.tsv, passo 2: copia i nomi in part->nomi da primo_byte in poi.
+// Ogni codice compare in una sola riga, quindi i blocchi scrivono in pos_nomi
+// posizioni diverse.
+static void *titoli_analizza_thread_func(void *arg) {
+    blocco_testo_t *b = (blocco_testo_t *)arg;
+    int64_t pos = b->primo_byte;
+    for (const char *p = b->inizio; p < b->fine; ) {
+        const char *fr = fine_riga(p, b->fine);
+        const char *nome;
+        size_t dim;
+        int64_t k = titoli_riga(b->part, p, fr, &nome, &dim);
+        if (k >= 0) {
+            memcpy(b->part->nomi + pos, nome, dim);
+            b->part->nomi[pos + dim] = '\0';
+            b->part->pos_nomi[k] = pos;
+            pos += dim + 1;
+        }
+        p = fr < b->fine ? fr + 1 : b->fine;
+    }
+    return NULL;
+}
+
+// Carica le partecipazioni degli attori di 'g' da 'path' e, se path_titoli
+// non è NULL, i nomi dei loro titoli.
+partecipazioni_t *partecipazioni_carica(const grafo_t *g, const char *path, const char *path_titoli, int num_thread) {
+    uint64_t inizio_ns = adesso_ns();
+    int n = g->tota_attori;
+    partecipazioni_t *part = (partecipazioni_t *)calloc(1, sizeof(partecipazioni_t));
+    blocco_testo_t *blocchi = (blocco_testo_t *)calloc(num_thread, sizeof(blocco_testo_t));
+    int *num_titoli = (int *)calloc(n, sizeof(int));
+    int *scritti = (int *)calloc(n, sizeof(int));
+    const char **prima_riga = (const char **)calloc(n, sizeof(char *));
+    if (!part || !blocchi || !num_titoli || !scritti || !prima_riga) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    const char **confini = (const char **)xmalloc((num_thread + 1) * sizeof(char *));
+
+    // Stesse due passate di grafo.txt: quanti titoli per attore, poi i titoli al loro posto
+    size_t dim;
+    const char *testo = xmappa_file(path, &dim);
+    dividi_in_righe(testo, dim, num_thread, confini);
+    for (int i = 0; i < num_thread; ++i) {
+        blocchi[i].inizio = confini[i];
+        blocchi[i].fine = confini[i + 1];
+        blocchi[i].g = (grafo_t *)g;
+        blocchi[i].prima_riga = prima_riga;
+        blocchi[i].gradi = num_titoli;
+        blocchi[i].scritti = scritti;
+        blocchi[i].part = part;
+    }
+    esegui_in_parallelo(num_thread, grafo_conta_thread_func, blocchi, sizeof(blocco_testo_t));
+    righe_dimensiona(prima_riga, n, testo ? testo + dim : NULL, num_titoli);
+    part->inizio = (int64_t *)arena_alloca(&part->arena, (n + 1) * sizeof(int64_t));
+    part->inizio[0] = 0;
+    for (int v = 0; v < n; ++v) part->inizio[v + 1] = part->inizio[v] + num_titoli[v];
+    int64_t totale = part->inizio[n];
+    part->titoli = (int32_t *)arena_alloca(&part->arena, totale * sizeof(int32_t));
+    esegui_in_parallelo(num_thread, partecipazioni_analizza_thread_func, blocchi, sizeof(blocco_testo_t));
+    if (testo) munmap((void *)testo, dim);
+    // Righe con meno titoli di quelli dichiarati: si avvicinano come in grafo_carica_testo
+    int64_t scrittura = 0;
+    for (int v = 0; v < n; ++v) {
+        int64_t lettura = part->inizio[v];
+        part->inizio[v] = scrittura;
+        if (scrittura != lettura) {
+            memmove(part->titoli + scrittura, part->titoli + lettura, scritti[v] * sizeof(int32_t));
+        }
+        scrittura += scritti[v];
+    }
+    part->inizio[n] = scrittura;
+    free(num_titoli);
+    free(scritti);
+    free(prima_riga);
+
+    // CreaGrafo scrive i titoli già in ordine: si ordina solo una riga che non lo è
+    int32_t codice_max = -1;
+    for (int v = 0; v < n; ++v) {
+        int32_t *riga = part->titoli + part->inizio[v];
+        int64_t num = part->inizio[v + 1] - part->inizio[v];
+        for (int64_t k = 1; k < num; ++k) {
+            if (riga[k - 1] >= riga[k]) {
+                qsort(riga, num, sizeof(int32_t), confronta_int);
+                break;
+            }
+        }
+        if (num > 0 && riga[num - 1] > codice_max) codice_max = riga[num - 1];
+    }
+
+    int64_t con_nome = 0;
+    if (path_titoli) {
+        // Codici distinti dei titoli, in ordine, da una bitmap dei presenti
+        size_t parole = ((size_t)codice_max + 64) / 64;
+        uint64_t *presenti = (uint64_t *)calloc(parole, sizeof(uint64_t));
+        if (!presenti) {
+            perror("calloc fallita");
+            fallisci();
+        }
+        for (int64_t k = 0; k < totale; ++k) {
+            if (part->titoli[k] >= 0) presenti[part->titoli[k] >> 6] |= 1ULL << (part->titoli[k] & 63);
+        }
+        for (size_t w = 0; w < parole; ++w) part->num_codici += __builtin_popcountll(presenti[w]);
+        part->codici = (int32_t *)arena_alloca(&part->arena, part->num_codici * sizeof(int32_t));
+        part->pos_nomi = (int64_t *)arena_alloca(&part->arena, part->num_codici * sizeof(int64_t));
+        int64_t k = 0;
+        for (size_t w = 0; w < parole; ++w) {
+            for (uint64_t x = presenti[w]; x; x &= x - 1) {
+                part->codici[k] = (int32_t)(w * 64 + __builtin_ctzll(x));
+                part->pos_nomi[k++] = -1;
+            }
+        }
+        free(presenti);
+
+        const char *tsv = xmappa_file(path_titoli, &dim);
+        dividi_in_righe(tsv, dim, num_thread, confini);
+        for (int i = 0; i < num_thread; ++i) {
+            blocchi[i].inizio = confini[i];
+            blocchi[i].fine = confini[i + 1];
+        }
+        esegui_in_parallelo(num_thread, titoli_conta_thread_func, blocchi, sizeof(blocco_testo_t));
+        int64_t byte_nomi = 0;
+        for (int i = 0; i < num_thread; ++i) {
+            blocchi[i].primo_byte = byte_nomi;
+            byte_nomi += blocchi[i].byte_nomi;
+        }
+        part->nomi = (char *)arena_alloca(&part->arena, byte_nomi);
+        esegui_in_parallelo(num_thread, titoli_analizza_thread_func, blocchi, sizeof(blocco_testo_t));
+        if (tsv) munmap((void *)tsv, dim);
+        for (int64_t j = 0; j < part->num_codici; ++j) con_nome += part->pos_nomi[j] >= 0;
+    }
+    free(confini);
+    free(blocchi);
+    fprintf(stderr, "Partecipazioni: %" PRId64 " titoli di %d attori, %" PRId64 " nomi di titoli, in %.2f s\n",
+            totale, n, con_nome, (adesso_ns() - inizio_ns) / 1e9);
+    return part;
+}
+
+void partecipazioni_destroy(partecipazioni_t *part) {
+    if (!part) return;
+    arena_destroy(&part->arena);
+    free(part);
+}
+
+// Nome del titolo 'codice', NULL se non è noto.
+static const char *titoli_nome(const partecipazioni_t *part, int32_t codice) {
+    if (!part->nomi) return NULL;
+    const int32_t *trovato = (const int32_t *)bsearch(&codice, part->codici, part->num_codici,
+                                                      sizeof(int32_t), confronta_int);
+    if (!trovato || part->pos_nomi[trovato - part->codici] < 0) return NULL;
+    return part->nomi + part->pos_nomi[trovato - part->codici];
+}
+
+// Prima posizione i >= da di a (n elementi, ordinati) con a[i] >= x: passi
+// che raddoppiano da 'da', poi una ricerca binaria nell'ultimo passo.
+static int64_t titoli_galoppa(const int32_t *a, int64_t da, int64_t n, int32_t x) {
+    if (da >= n || a[da] >= x) return da;
+    int64_t basso = da, passo = 1; // a[basso] < x
+    while (basso + passo < n && a[basso + passo] < x) {
+        basso += passo;
+        passo *= 2;
+    }
+    int64_t alto = basso + passo < n ? basso + passo : n; // a[alto] >= x, o alto == n
+    while (alto - basso > 1) {
+        int64_t m = basso + (alto - basso) / 2;
+        if (a[m] < x) basso = m;
+        else alto = m;
+    }
+    return alto;
+}
+
+// Scrive in 'out' (almeno min(na, nb) posti) i titoli comuni alle righe
+// ordinate a e b, in ordine; restituisce quanti sono.
+static int64_t titoli_interseca(const int32_t *a, int64_t na, const int32_t *b, int64_t nb, int32_t *out) {
+    if (na > nb) {
+        const int32_t *t = a; a = b; b = t;
+        int64_t tn = na; na = nb; nb = tn;
+    }
+    int64_t k = 0;
+    if (na == 0) return 0;
+    if (nb / na >= TITOLI_GALOPPO) {
+        int64_t j = 0;
+        for (int64_t i = 0; i < na && j < nb; ++i) {
+            j = titoli_galoppa(b, j, nb, a[i]);
+            if (j < nb && b[j] == a[i]) out[k++] = a[i];
+        }
+        return k;
+    }
+    int64_t i = 0, j = 0;
+#if defined(__SSE2__)
+    while (i + 4 <= na && j + 4 <= nb) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+        __m128i uguali = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4E)), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93))));
+        for (int maschera = _mm_movemask_ps(_mm_castsi128_ps(uguali)); maschera; maschera &= maschera - 1) {
+            out[k++] = a[i + __builtin_ctz(maschera)];
+        }
+        int32_t ultimo_a = a[i + 3], ultimo_b = b[j + 3];
+        if (ultimo_a <= ultimo_b) i += 4;
+        if (ultimo_b <= ultimo_a) j += 4;
+    }
+#endif
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            out[k++] = a[i];
+            i++;
+            j++;
+        }
+    }
+    return k;
+}
+
+// Aggiunge a 'out', per ogni passo del cammino 'path' (path_len attori), i
+// titoli in comune tra i due attori, come collaborazioni.py:
+//   <codice1>.<codice2>: <n> collaborazioni:
+//    <titolo> <nome>
+// e una riga vuota. Si elencano al più TITOLI_MAX_PER_PASSO titoli per passo;
+// senza -t solo i codici.
+void titoli_annota(const partecipazioni_t *part, const grafo_t *g, const int *path, int path_len, buffer_t *out) {
+    uint64_t inizio = adesso_ns();
+    int64_t max_comuni = 1;
+    for (int i = 0; i + 1 < path_len; ++i) {
+        int64_t na = part->inizio[path[i] + 1] - part->inizio[path[i]];
+        int64_t nb = part->inizio[path[i + 1] + 1] - part->inizio[path[i + 1]];
+        int64_t m = na < nb ? na : nb;
+        if (m > max_comuni) max_comuni = m;
+    }
+    int32_t *comuni = (int32_t *)xmalloc(max_comuni * sizeof(int32_t));
+    for (int i = 0; i + 1 < path_len; ++i) {
+        int u = path[i], v = path[i + 1];
+        int64_t num = titoli_interseca(part->titoli + part->inizio[u], part->inizio[u + 1] - part->inizio[u],
+                                       part->titoli + part->inizio[v], part->inizio[v + 1] - part->inizio[v], comuni);
+        if (num == 0) {
+            buffer_printf(out, "%d.%d nessuna collaborazione\n\n", g->attori[u].codice, g->attori[v].codice);
+            continue;
+        }
+        buffer_printf(out, "%d.%d: %" PRId64 " collaborazioni:\n", g->attori[u].codice, g->attori[v].codice, num);
+        for (int64_t k = 0; k < num && k < TITOLI_MAX_PER_PASSO; ++k) {
+            const char *nome = titoli_nome(part, comuni[k]);
+            if (!part->nomi) {
+                buffer_printf(out, " %d\n", comuni[k]);
+            } else {
+                buffer_printf(out, " %d %s\n", comuni[k], nome ? nome : "Titolo Sconosciuto");
+            }
+        }
+        if (num > TITOLI_MAX_PER_PASSO) buffer_printf(out, " ... e altri %" PRId64 "\n", num - TITOLI_MAX_PER_PASSO);
+        buffer_aggiungi(out, "\n", 1);
+    }
+    free(comuni);
+    statistiche_annotazione(path_len - 1, adesso_ns() - inizio);
+}
+
+// --- Calcolo Cammino Minimo (BFS) ---
+// Scrive l'esito di una richiesta: il cammino (path_len nodi, 0 se non esiste)
+// nel file <start>.<end>, o un record per lo scrittore con -o, e una riga di
+// riepilogo su stdout. Le richieste da socket ricevono il record sulla loro connessione.
+// Il tempo di elaborazione è la CPU del worker da 'm->cpu_inizio': con times()
+// sarebbe quella dell'intero processo, falsata dalle altre richieste in corso.
+// Per un membro di un batch vi si aggiunge la sua quota della MS-BFS condivisa.
+void scrivi_esito(const bfs_pool_t *pool, const versione_t *versione, const richiesta_t *req, int start_id, int end_id,
+                  const int *path, int path_len, const metriche_t *m) {
+    const grafo_t *g = &versione->grafo;
+
+    buffer_t testo = { NULL, 0, 0 };
+    buffer_riserva(&testo, 256);
+    if (start_id < 0) {
+        buffer_printf(&testo, "codice %d non valido\n", req->start_codice);
+    } else if (end_id < 0) {
+        buffer_printf(&testo, "codice %d non valido\n", req->end_codice);
+    } else if (path_len > 0) {
+        // Stampa il cammino (in ordine corretto)
+        for (int i = 0; i < path_len; ++i) {
+            const attore *actor_on_path = &g->attori[path[i]];
+            buffer_printf(&testo, "%d\t%s\t%d\n", actor_on_path->codice, grafo_nome(g, path[i]), actor_on_path->anno);
+        }
+        if (versione->partecipazioni) titoli_annota(versione->partecipazioni, g, path, path_len, &testo);
+    } else {
+        buffer_printf(&testo, "non esistono cammini da %d a %d\n", req->start_codice, req->end_codice);
+    }
+
+    int riepilogo = start_id >= 0 && end_id >= 0;
+    if (req->conn) {
+        // La risposta torna sulla connessione: nessun riepilogo su stdout
+        connessione_invia(req->conn, req, testo.dati, testo.dim);
+        riepilogo = 0;
+    } else if (pool->scrittore) {
+        scrittore_accoda(pool->scrittore, req, testo.dati, testo.dim);
+    } else {
+        char output_filename[256];
+        sprintf(output_filename, "%d.%d", req->start_codice, req->end_codice);
+
+        FILE *out_fp = fopen(output_filename, "w");
+        if (!out_fp) {
+            fprintf(stderr, "Errore: impossibile creare file di output %s per %d-%d\n",
+                    output_filename, req->start_codice, req->end_codice);
+            // Stampa su stdout che c'è stato un errore
+            printf("%d.%d: Errore creazione file output. Tempo di elaborazione 0.00 secondi\n",
+                   req->start_codice, req->end_codice);
+            riepilogo = 0;
+        } else {
+            fwrite(testo.dati, 1, testo.dim, out_fp);
+            fclose(out_fp);
+        }
+    }
+    free(testo.dati);
+
+    struct timespec cpu_fine, fine;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_fine);
+    clock_gettime(CLOCK_MONOTONIC, &fine);
+    uint64_t cpu_ns = ns_da_timespec(&cpu_fine) - ns_da_timespec(&m->cpu_inizio) + m->cpu_quota_ns;
+    uint64_t servizio_ns = ns_da_timespec(&fine) - ns_da_timespec(&m->inizio) + m->servizio_quota_ns;
+    int valida = start_id >= 0 && end_id >= 0;
+    statistiche_richiesta(req, m, valida ? path_len : -1, cpu_ns, servizio_ns, ns_da_timespec(&fine));
+    if (pool->opzioni->verbose && valida) {
+        fprintf(stderr, "%d.%d: CPU %.3f ms, reale %.3f ms, in coda %.3f ms, nodi espansi %ld, "
+                "archi esaminati %ld, frontiera massima %ld\n", req->start_codice, req->end_codice,
+                cpu_ns / 1e6, servizio_ns / 1e6,
+                req->arrivo_ns ? (ns_da_timespec(&m->inizio) - req->arrivo_ns) / 1e6 : 0.0,
+                m->bfs.nodi_espansi, m->bfs.archi_esaminati, m->bfs.frontiera_max);
+    }
+
+    if (riepilogo) {
+        double elapsed_sec = cpu_ns / 1e9;
+        if (path_len > 0) {
+            printf("%d.%d: Lunghezza minima %d. Tempo di elaborazione %.2f secondi\n",
+                   req->start_codice, req->end_codice, path_len - 1, elapsed_sec);
+        } else {
+            printf("%d.%d: Nessun cammino. Tempo di elaborazione %.2f secondi\n",
+                   req->start_codice, req->end_codice, elapsed_sec);
+        }
+    }
+    fflush(stdout); // Assicura che l'output su stdout sia visibile immediatamente
+}
+
+// Inizio delle misure di una richiesta o di un batch.
+static void metriche_inizia(metriche_t *m, int via) {
+    memset(m, 0, sizeof(*m));
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &m->cpu_inizio);
+    clock_gettime(CLOCK_MONOTONIC, &m->inizio);
+    m->via = via;
+}
+
+// CPU e tempo reale trascorsi dall'inizio delle misure.
+static void metriche_trascorso(const metriche_t *m, uint64_t *cpu_ns, uint64_t *servizio_ns) {
+    struct timespec cpu, reale;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    clock_gettime(CLOCK_MONOTONIC, &reale);
+    *cpu_ns = ns_da_timespec(&cpu) - ns_da_timespec(&m->cpu_inizio);
+    *servizio_ns = ns_da_timespec(&reale) - ns_da_timespec(&m->inizio);
+}
+
+// Risponde a una singola richiesta con una versione del grafo. 'sc' è la
+// memoria di lavoro del worker chiamante, dimensionata per quella versione.
+void esegui_richiesta(const bfs_pool_t *pool, const versione_t *versione, bfs_scratch_t *sc, const richiesta_t *req) {
+    metriche_t m;
+    metriche_inizia(&m, VIA_NON_VALIDA);
+
+    const grafo_t *g = &versione->grafo;
+    int start_id = grafo_id(g, req->start_codice);
+    int end_id = grafo_id(g, req->end_codice);
+    int path_len = 0;
+    int da_cache = start_id >= 0 && end_id >= 0 && start_id != end_id && versione->cache;
+
+    if (start_id >= 0 && end_id >= 0 && g->componente[start_id] != g->componente[end_id]) {
+        // Componenti diverse: nessun cammino, senza visitare nulla
+        da_cache = 0;
+        m.via = VIA_COMPONENTI;
+        if (pool->opzioni->verbose) {
+            fprintf(stderr, "%d.%d: componenti connesse diverse\n", req->start_codice, req->end_codice);
+        }
+    } else if (da_cache && (path_len = cache_cerca(versione->cache, g, sc, start_id, end_id)) >= 0) {
+        // Risultato già noto, o ricavato dall'albero BFS di una sorgente frequente
+        da_cache = 0;
+        m.via = VIA_CACHE;
+        if (pool->opzioni->verbose) {
+            fprintf(stderr, "%d.%d: dalla cache\n", req->start_codice, req->end_codice);
+        }
+    } else if (start_id >= 0 && end_id >= 0 && versione->indice) {
+        // Con l'indice 2-hop nessuna BFS: distanza e cammino dalle etichette
+        m.via = VIA_INDICE;
+        struct timespec t0, t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int distanza = pool->opzioni->verbose ? pll_distanza(versione->indice, start_id, end_id) : 0;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        path_len = pll_cerca_cammino(versione->indice, g, sc, start_id, end_id);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        if (pool->opzioni->verbose) {
+            fprintf(stderr, "%d.%d: distanza %d dalle etichette in %.1f us, cammino in %.1f us\n",
+                    req->start_codice, req->end_codice, distanza < PLL_INFINITO ? distanza : -1,
+                    (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3,
+                    (t2.tv_sec - t1.tv_sec) * 1e6 + (t2.tv_nsec - t1.tv_nsec) / 1e3);
+        }
+    } else if (start_id >= 0 && end_id >= 0) {
+        // La BFS lavora interamente sugli id densi, con la memoria di lavoro
+        // del worker: nessuna allocazione per nodo visitato.
+        m.via = VIA_BFS;
+        path_len = bfs_cerca_cammino(g, sc, versione->team, pool->opzioni->modalita_bfs, start_id, end_id, &m.bfs);
+    }
+    if (da_cache) cache_registra(versione->cache, start_id, end_id, sc->coda, path_len);
+    scrivi_esito(pool, versione, req, start_id, end_id, sc->coda, path_len, &m);
+}
+
+// --- BFS Multi-Sorgente (MS-BFS) ---
+// Risponde insieme fino a MSBFS_MAX richieste con un'unica visita del grafo:
+// per ogni nodo 'seen' e 'visit' sono parole da 64 bit, il bit i indica
+// rispettivamente se la ricerca i ha già raggiunto il nodo e se il nodo è
+// nella sua frontiera. Ogni lista di adiacenza viene quindi letta una volta
+// per livello per tutte le ricerche, invece che una volta per ricerca.
+//
+// Per ricostruire i cammini si registrano, livello per livello, i nodi appena
+// raggiunti con la maschera delle ricerche che li hanno raggiunti (in ordine
+// di id). Il predecessore sul cammino della ricerca i di un nodo al livello k
+// è un suo vicino presente nel registro del livello k-1 con il bit i acceso.
+static int64_t msbfs_cerca_voce(const msbfs_voce_t *voci, int64_t da, int64_t a, int v) {
+    while (da < a) {
+        int64_t m = da + (a - da) / 2;
+        if (voci[m].id < v) da = m + 1;
+        else a = m;
+    }
+    return da;
+}
+
+static void msbfs_registra(msbfs_scratch_t *ms, int v, uint64_t maschera) {
+    if (ms->num_voci == ms->cap_voci) {
+        ms->cap_voci = ms->cap_voci ? ms->cap_voci * 2 : 1024;
+        msbfs_voce_t *nuove = realloc(ms->voci, ms->cap_voci * sizeof(msbfs_voce_t));
+        if (!nuove) {
+            perror("realloc fallita nel registro MS-BFS");
+            fallisci();
+        }
+        ms->voci = nuove;
+    }
+    ms->voci[ms->num_voci].id = v;
+    ms->voci[ms->num_voci].maschera = maschera;
+    ms->num_voci++;
+}
+
+// Segna in inizio_livello la posizione del registro da cui parte il livello dato.
+static void msbfs_inizia_livello(msbfs_scratch_t *ms, int livello) {
+    if (livello >= ms->cap_livelli) {
+        ms->cap_livelli = ms->cap_livelli ? ms->cap_livelli * 2 : 64;
+        int64_t *nuovi = realloc(ms->inizio_livello, ms->cap_livelli * sizeof(int64_t));
+        if (!nuovi) {
+            perror("realloc fallita nel registro MS-BFS");
+            fallisci();
+        }
+        ms->inizio_livello = nuovi;
+    }
+    ms->inizio_livello[livello] = ms->num_voci;
+}
+
+msbfs_scratch_t *msbfs_scratch_create(int tota_attori) {
+    msbfs_scratch_t *ms = (msbfs_scratch_t *)xmalloc(sizeof(msbfs_scratch_t));
+    ms->arena = (arena_t){ 0 };
+    ms->seen = (uint64_t *)arena_alloca(&ms->arena, tota_attori * sizeof(uint64_t));
+    ms->visit = (uint64_t *)arena_alloca(&ms->arena, tota_attori * sizeof(uint64_t));
+    ms->visit_next = (uint64_t *)arena_alloca(&ms->arena, tota_attori * sizeof(uint64_t));
+    ms->voci = NULL;
+    ms->num_voci = ms->cap_voci = 0;
+    ms->inizio_livello = NULL;
+    ms->cap_livelli = 0;
+    return ms;
+}
+
+void msbfs_scratch_destroy(msbfs_scratch_t *ms) {
+    if (!ms) return;
+    arena_destroy(&ms->arena);
+    free(ms->voci);
+    free(ms->inizio_livello);
+    free(ms);
+}
+
+// Risponde alle num_req richieste di 'reqs' (al più MSBFS_MAX) con una MS-BFS.
+// Ogni richiesta misura la propria ricostruzione e scrittura; il costo della
+// MS-BFS, senza le risposte dalla cache, si divide in parti uguali tra le
+// richieste che vi hanno partecipato.
+void esegui_batch(const bfs_pool_t *pool, const versione_t *versione, msbfs_scratch_t *ms, bfs_scratch_t *sc,
+                  const richiesta_t *reqs, int num_req) {
+    const grafo_t *g = &versione->grafo;
+    metriche_t m, condivise;
+    metriche_inizia(&condivise, VIA_BATCH);
+    uint64_t cpu_esclusa_ns = 0, servizio_escluso_ns = 0; // Risposte dalla cache durante la preparazione
+
+    int start_id[MSBFS_MAX], end_id[MSBFS_MAX], distanza[MSBFS_MAX];
+    uint64_t attive = 0, dalla_cache = 0, nella_bfs = 0;
+
+    memset(ms->seen, 0, g->tota_attori * sizeof(uint64_t));
+    for (int i = 0; i < num_req; ++i) {
+        start_id[i] = grafo_id(g, reqs[i].start_codice);
+        end_id[i] = grafo_id(g, reqs[i].end_codice);
+        distanza[i] = -1;
+        if (start_id[i] < 0 || end_id[i] < 0) continue;
+        if (g->componente[start_id[i]] != g->componente[end_id[i]]) continue; // Nessun cammino
+        uint64_t bit = 1ULL << i;
+        if (versione->cache && start_id[i] != end_id[i]) {
+            // Le richieste che la cache conosce non entrano nella BFS
+            metriche_inizia(&m, VIA_CACHE);
+            int path_len = cache_cerca(versione->cache, g, sc, start_id[i], end_id[i]);
+            if (path_len >= 0) {
+                scrivi_esito(pool, versione, &reqs[i], start_id[i], end_id[i], sc->coda, path_len, &m);
+                uint64_t cpu_ns, servizio_ns;
+                metriche_trascorso(&m, &cpu_ns, &servizio_ns);
+                cpu_esclusa_ns += cpu_ns;
+                servizio_escluso_ns += servizio_ns;
+                dalla_cache |= bit;
+                continue;
+            }
+        }
+        nella_bfs |= bit;
+        ms->seen[start_id[i]] |= bit;
+        ms->visit[start_id[i]] |= bit;
+        if (start_id[i] == end_id[i]) {
+            distanza[i] = 0;
+        } else {
+            attive |= bit;
+        }
+    }
+
+    // Livello 0: le sorgenti, registrate in ordine di id
+    ms->num_voci = 0;
+    msbfs_inizia_livello(ms, 0);
+    for (int v = 0; v < g->tota_attori; ++v) {
+        if (ms->visit[v]) msbfs_registra(ms, v, ms->visit[v]);
+    }
+    int livello = 0;
+    long nodi_espansi = 0, archi_esaminati = 0, frontiera_max = 0;
+
+    while (attive) {
+        // Espansione: ogni nodo in frontiera propaga ai vicini le ricerche ancora attive
+        long dim_frontiera = 0;
+        for (int v = 0; v < g->tota_attori; ++v) {
+            uint64_t mask = ms->visit[v] & attive;
+            ms->visit[v] = 0;
+            if (!mask) continue;
+            dim_frontiera++;
+            int64_t grado = g->offsets[v + 1] - g->offsets[v];
+            const int *vicini = grafo_vicini(g, v, sc->vicini);
+            archi_esaminati += grado;
+            for (int64_t i = 0; i < grado; ++i) {
+                int n = vicini[i];
+                uint64_t d = mask & ~ms->seen[n];
+                if (d) ms->visit_next[n] |= d;
+            }
+        }
+
+        nodi_espansi += dim_frontiera;
+        if (dim_frontiera > frontiera_max) frontiera_max = dim_frontiera;
+
+        // Consolidamento del livello e registro dei nodi appena raggiunti
+        livello++;
+        msbfs_inizia_livello(ms, livello);
+        for (int v = 0; v < g->tota_attori; ++v) {
+            uint64_t nuovi = ms->visit_next[v];
+            if (!nuovi) continue;
+            ms->seen[v] |= nuovi;
+            msbfs_registra(ms, v, nuovi);
+        }
+        uint64_t *tmp = ms->visit;
+        ms->visit = ms->visit_next;
+        ms->visit_next = tmp;
+
+        for (int i = 0; i < num_req; ++i) {
+            uint64_t bit = 1ULL << i;
+            if ((attive & bit) && (ms->seen[end_id[i]] & bit)) {
+                distanza[i] = livello;
+                attive &= ~bit;
+            }
+        }
+        if (ms->num_voci == ms->inizio_livello[livello]) break; // Nessun nodo nuovo: le ricerche attive non hanno cammino
+    }
+    msbfs_inizia_livello(ms, livello + 1);
+    // La frontiera non espansa va azzerata per il prossimo batch
+    memset(ms->visit, 0, g->tota_attori * sizeof(uint64_t));
+    statistiche_visita(nodi_espansi, archi_esaminati, frontiera_max);
+    uint64_t cpu_bfs_ns, servizio_bfs_ns;
+    metriche_trascorso(&condivise, &cpu_bfs_ns, &servizio_bfs_ns);
+    cpu_bfs_ns = cpu_bfs_ns > cpu_esclusa_ns ? cpu_bfs_ns - cpu_esclusa_ns : 0;
+    servizio_bfs_ns = servizio_bfs_ns > servizio_escluso_ns ? servizio_bfs_ns - servizio_escluso_ns : 0;
+    int partecipanti = __builtin_popcountll(nella_bfs);
+
+    // Ricostruzione a ritroso e scrittura dei risultati
+    for (int i = 0; i < num_req; ++i) {
+        if (dalla_cache & (1ULL << i)) continue;
+        metriche_inizia(&m, VIA_BATCH);
+        if (nella_bfs & (1ULL << i)) {
+            m.cpu_quota_ns = cpu_bfs_ns / partecipanti;
+            m.servizio_quota_ns = servizio_bfs_ns / partecipanti;
+        }
+        int path_len = 0;
+        if (distanza[i] >= 0) {
+            uint64_t bit = 1ULL << i;
+            int *path = sc->coda;
+            path_len = distanza[i] + 1;
+            path[distanza[i]] = end_id[i];
+            for (int k = distanza[i] - 1; k >= 0; --k) {
+                int cur = path[k + 1];
+                int64_t da = ms->inizio_livello[k], a = ms->inizio_livello[k + 1];
+                path[k] = -1;
+                int64_t grado = g->offsets[cur + 1] - g->offsets[cur];
+                const int *vicini = grafo_vicini(g, cur, sc->vicini);
+                for (int64_t j = 0; j < grado && path[k] < 0; ++j) {
+                    int u = vicini[j];
+                    int64_t pos = msbfs_cerca_voce(ms->voci, da, a, u);
+                    if (pos < a && ms->voci[pos].id == u && (ms->voci[pos].maschera & bit)) {
+                        path[k] = u;
+                    }
+                }
+            }
+        }
+        if (versione->cache && start_id[i] >= 0 && end_id[i] >= 0) {
+            cache_registra(versione->cache, start_id[i], end_id[i], sc->coda, path_len);
+        }
+        if (start_id[i] < 0 || end_id[i] < 0) {
+            m.via = VIA_NON_VALIDA;
+        } else if (g->componente[start_id[i]] != g->componente[end_id[i]]) {
+            m.via = VIA_COMPONENTI;
+        } else {
+            m.via = VIA_BATCH;
+        }
+        scrivi_esito(pool, versione, &reqs[i], start_id[i], end_id[i], sc->coda, path_len, &m);
     }
-    if (pthread_cond_init(&lb->not_full, NULL) != 0) {
-        perror("pthread_cond_init not_full for line_buffer"); exit(EXIT_FAILURE);
+    if (pool->opzioni->verbose) {
+        fprintf(stderr, "batch MS-BFS di %d richieste: livelli %d, nodi espansi %ld, archi esaminati %ld, "
+                "frontiera massima %ld\n", num_req, livello, nodi_espansi, archi_esaminati, frontiera_max);
     }
-    return lb;
 }
 
-void line_buffer_put(line_buffer_t *lb, char *line) {
-    pthread_mutex_lock(&lb->mutex);
-    while (lb->count == lb->capacity && !lb->done_producing) {
-        pthread_cond_wait(&lb->not_full, &lb->mutex);
-    }
-    if (lb->count < lb->capacity) {
-        lb->buffer[lb->tail] = line;
-        lb->tail = (lb->tail + 1) % lb->capacity;
-        lb->count++;
-        pthread_cond_signal(&lb->not_empty);
-    } else {
-        fprintf(stderr, "Attenzione: buffer linee pieno, linea scartata. Aumentare capacità.\n");
-        free(line);
+// --- Pool di Worker BFS ---
+// Preleva dalla coda 'c': dalla testa se è il proprietario, dalla fine se sta rubando.
+static int coda_worker_pop(coda_worker_t *c, int dalla_fine, richiesta_t *out) {
+    int ok = 0;
+    pthread_mutex_lock(&c->mutex);
+    if (c->count > 0) {
+        if (dalla_fine) {
+            *out = c->buffer[(c->head + c->count - 1) % c->capacity];
+        } else {
+            *out = c->buffer[c->head];
+            c->head = (c->head + 1) % c->capacity;
+        }
+        c->count--;
+        ok = 1;
     }
-    pthread_mutex_unlock(&lb->mutex);
+    pthread_mutex_unlock(&c->mutex);
+    return ok;
 }
 
-char* line_buffer_get(line_buffer_t *lb) {
-    pthread_mutex_lock(&lb->mutex);
-    while (lb->count == 0 && !lb->done_producing) {
-        pthread_cond_wait(&lb->not_empty, &lb->mutex);
-    }
-    char *line = NULL;
-    if (lb->count > 0) {
-        line = lb->buffer[lb->head];
-        lb->head = (lb->head + 1) % lb->capacity;
-        lb->count--;
-        pthread_cond_signal(&lb->not_full);
-    } else if (lb->done_producing && lb->count == 0) {
-        line = NULL;
+// Prende la versione corrente del grafo e la annuncia nel posto 'posto' di
+// in_uso, finché non la rilascia. Dopo l'annuncio la versione si rilegge: se
+// nel frattempo è stata sostituita, chi l'ha sostituita potrebbe non aver
+// visto l'annuncio e la libererebbe, quindi si riprova con quella nuova.
+static versione_t *versione_acquisisci(bfs_pool_t *pool, int posto) {
+    versione_t *v = __atomic_load_n(&pool->versione, __ATOMIC_SEQ_CST);
+    while (1) {
+        __atomic_store_n(&pool->in_uso[posto], v, __ATOMIC_SEQ_CST);
+        versione_t *attuale = __atomic_load_n(&pool->versione, __ATOMIC_SEQ_CST);
+        if (attuale == v) return v;
+        v = attuale;
     }
-    pthread_mutex_unlock(&lb->mutex);
-    return line;
 }
 
-void line_buffer_set_done(line_buffer_t *lb) {
-    pthread_mutex_lock(&lb->mutex);
-    lb->done_producing = 1;
-    pthread_cond_broadcast(&lb->not_empty);
-    pthread_mutex_unlock(&lb->mutex);
+static void versione_rilascia(bfs_pool_t *pool, int posto) {
+    __atomic_store_n(&pool->in_uso[posto], NULL, __ATOMIC_RELEASE);
 }
 
-void line_buffer_destroy(line_buffer_t *lb) {
-    pthread_mutex_destroy(&lb->mutex);
-    pthread_cond_destroy(&lb->not_empty);
-    pthread_cond_destroy(&lb->not_full);
-    free(lb->buffer);
-    free(lb);
-}
+void *worker_thread_func(void *arg) {
+    worker_args_t *wa = (worker_args_t *)arg;
+    bfs_pool_t *pool = wa->pool;
+    // Memorie di lavoro dimensionate per la versione 'numero', ricreate quando cambia
+    bfs_scratch_t *sc = NULL;
+    msbfs_scratch_t *ms = NULL; // Creata al primo batch
+    uint64_t numero = 0;
+    int min_batch = pool->opzioni->file_indice ? 0 : pool->opzioni->min_batch; // Con l'indice i batch non servono
+    richiesta_t reqs[MSBFS_MAX];
 
-// --- Funzioni Coda FIFO (per BFS) ---
-fifo_queue_t* fifo_queue_create() {
-    fifo_queue_t *q = (fifo_queue_t*)xmalloc(sizeof(fifo_queue_t));
-    q->head = q->tail = NULL;
-    return q;
-}
+    while (1) {
+        // Attende che ci sia almeno una richiesta e se ne assegna una; se la
+        // coda è abbastanza piena se ne assegna fino a MSBFS_MAX in un colpo.
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->disponibili == 0 && !pool->chiusura) {
+            pthread_cond_wait(&pool->not_empty, &pool->mutex);
+        }
+        if (pool->disponibili == 0) { // Chiusura e nessuna richiesta residua
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+        int num_req = 1;
+        if (min_batch > 0 && pool->disponibili >= min_batch) {
+            num_req = pool->disponibili < MSBFS_MAX ? pool->disponibili : MSBFS_MAX;
+        }
+        pool->disponibili -= num_req;
+        pthread_mutex_unlock(&pool->mutex);
 
-void fifo_queue_enqueue(fifo_queue_t *q, int codice) {
-    q_node_t *newNode = (q_node_t*)xmalloc(sizeof(q_node_t));
-    newNode->codice = codice;
-    newNode->next = NULL;
-    if (q->tail == NULL) {
-        q->head = q->tail = newNode;
-    } else {
-        q->tail->next = newNode;
-        q->tail = newNode;
+        // Le richieste assegnate si trovano di sicuro nelle code: prima la
+        // propria, poi quelle degli altri worker (work stealing).
+        for (int r = 0; r < num_req; ++r) {
+            int trovata = coda_worker_pop(&pool->code[wa->indice], 0, &reqs[r]);
+            for (int i = 1; !trovata; ++i) {
+                trovata = coda_worker_pop(&pool->code[(wa->indice + i) % pool->num_worker], 1, &reqs[r]);
+            }
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->posti_occupati -= num_req;
+        pthread_cond_broadcast(&pool->not_full);
+        pthread_mutex_unlock(&pool->mutex);
+
+        // La versione si tiene solo per la durata delle richieste prelevate
+        versione_t *v = versione_acquisisci(pool, wa->indice);
+        if (v->numero != numero) {
+            if (sc) bfs_scratch_destroy(sc);
+            msbfs_scratch_destroy(ms);
+            sc = bfs_scratch_create(&v->grafo);
+            ms = NULL;
+            numero = v->numero;
+        }
+        if (num_req == 1) {
+            esegui_richiesta(pool, v, sc, &reqs[0]);
+        } else {
+            if (!ms) ms = msbfs_scratch_create(v->grafo.tota_attori);
+            esegui_batch(pool, v, ms, sc, reqs, num_req);
+        }
+        versione_rilascia(pool, wa->indice);
     }
+
+    msbfs_scratch_destroy(ms);
+    if (sc) bfs_scratch_destroy(sc);
+    free(wa);
+    return NULL;
 }
 
-int fifo_queue_dequeue(fifo_queue_t *q, int *codice_out) {
-    if (q->head == NULL) return 0;
-    q_node_t *temp = q->head;
-    *codice_out = temp->codice;
-    q->head = q->head->next;
-    if (q->head == NULL) {
-        q->tail = NULL;
+bfs_pool_t *bfs_pool_create(int num_worker, int capacity, versione_t *versione,
+                            scrittore_t *scrittore, const opzioni_t *opzioni) {
+    bfs_pool_t *pool = (bfs_pool_t *)xmalloc(sizeof(bfs_pool_t));
+    pool->num_worker = num_worker;
+    pool->capacity = capacity;
+    pool->posti_occupati = 0;
+    pool->disponibili = 0;
+    pool->chiusura = 0;
+    pool->prossima_coda = 0;
+    pool->versione = versione;
+    pool->in_uso = (versione_t **)calloc(num_worker + 1, sizeof(versione_t *));
+    if (!pool->in_uso) {
+        perror("calloc fallita");
+        fallisci();
     }
-    free(temp);
-    return 1;
+    pool->scrittore = scrittore;
+    pool->opzioni = opzioni;
+    if (pthread_mutex_init(&pool->mutex, NULL) != 0 ||
+        pthread_cond_init(&pool->not_empty, NULL) != 0 ||
+        pthread_cond_init(&pool->not_full, NULL) != 0) {
+        perror("inizializzazione sincronizzazione del pool fallita");
+        fallisci();
+    }
+
+    // Ogni coda può contenere da sola tutte le richieste ammesse
+    pool->code = (coda_worker_t *)xmalloc(num_worker * sizeof(coda_worker_t));
+    for (int i = 0; i < num_worker; ++i) {
+        pool->code[i].buffer = (richiesta_t *)xmalloc(capacity * sizeof(richiesta_t));
+        pool->code[i].capacity = capacity;
+        pool->code[i].count = 0;
+        pool->code[i].head = 0;
+        if (pthread_mutex_init(&pool->code[i].mutex, NULL) != 0) {
+            perror("pthread_mutex_init for coda_worker"); fallisci();
+        }
+    }
+
+    pool->tids = (pthread_t *)xmalloc(num_worker * sizeof(pthread_t));
+    for (int i = 0; i < num_worker; ++i) {
+        worker_args_t *wa = (worker_args_t *)xmalloc(sizeof(worker_args_t));
+        wa->pool = pool;
+        wa->indice = i;
+        if (pthread_create(&pool->tids[i], NULL, worker_thread_func, wa) != 0) {
+            perror("pthread_create per worker_thread fallito");
+            fallisci();
+        }
+    }
+    return pool;
 }
 
-int fifo_queue_is_empty(fifo_queue_t *q) {
-    return q->head == NULL;
+// Accoda 'n' richieste. Se il pool è pieno attende che un worker liberi dei
+// posti (backpressure sul lettore della pipe); i posti liberi vengono presi
+// tutti insieme e le richieste distribuite a turno, con un lock per coda.
+// Restituisce quante richieste sono state accodate: meno di 'n' solo se nel
+// frattempo è stata chiesta la terminazione e le altre sono state scartate.
+int bfs_pool_submit_molte(bfs_pool_t *pool, const richiesta_t *reqs, int n) {
+    int fatte = 0;
+    while (fatte < n) {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->posti_occupati == pool->capacity) {
+            // Attesa a tempo: il SIGINT arriva al thread dei segnali, non a questa condition.
+            struct timespec scadenza;
+            clock_gettime(CLOCK_REALTIME, &scadenza);
+            scadenza.tv_nsec += 200 * 1000000L;
+            if (scadenza.tv_nsec >= 1000000000L) {
+                scadenza.tv_sec++;
+                scadenza.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&pool->not_full, &pool->mutex, &scadenza);
+            if (S_SHUTDOWN_REQUEST) {
+                pthread_mutex_unlock(&pool->mutex);
+                return fatte;
+            }
+        }
+        int k = pool->capacity - pool->posti_occupati;
+        if (k > n - fatte) k = n - fatte;
+        pool->posti_occupati += k;
+        pthread_mutex_unlock(&pool->mutex);
+
+        for (int q = 0; q < pool->num_worker && q < k; ++q) {
+            coda_worker_t *c = &pool->code[(pool->prossima_coda + q) % pool->num_worker];
+            pthread_mutex_lock(&c->mutex);
+            for (int j = q; j < k; j += pool->num_worker) {
+                c->buffer[(c->head + c->count) % c->capacity] = reqs[fatte + j];
+                c->count++;
+            }
+            pthread_mutex_unlock(&c->mutex);
+        }
+        pool->prossima_coda = (pool->prossima_coda + k) % pool->num_worker;
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->disponibili += k;
+        if (k == 1) {
+            pthread_cond_signal(&pool->not_empty);
+        } else {
+            pthread_cond_broadcast(&pool->not_empty);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+        fatte += k;
+    }
+    return fatte;
 }
 
-void fifo_queue_destroy(fifo_queue_t *q) {
-    int temp_codice;
-    while (fifo_queue_dequeue(q, &temp_codice));
-    free(q);
+// Accoda una richiesta; restituisce 0 se è stata scartata per la terminazione.
+int bfs_pool_submit(bfs_pool_t *pool, const richiesta_t *req) {
+    return bfs_pool_submit_molte(pool, req, 1);
 }
 
-// --- Funzioni ABR (per BFS) ---
-abr_node_t* abr_insert(abr_node_t **root_ptr, int shuffled_key, int original_key, int parent_key) {
-    if (*root_ptr == NULL) {
-        *root_ptr = (abr_node_t*)xmalloc(sizeof(abr_node_t));
-        (*root_ptr)->shuffled_codice = shuffled_key;
-        (*root_ptr)->original_codice = original_key;
-        (*root_ptr)->parent_codice = parent_key;
-        (*root_ptr)->left = (*root_ptr)->right = NULL;
-        return *root_ptr;
-    }
-    if (shuffled_key < (*root_ptr)->shuffled_codice) {
-        return abr_insert(&((*root_ptr)->left), shuffled_key, original_key, parent_key);
-    } else if (shuffled_key > (*root_ptr)->shuffled_codice) {
-        return abr_insert(&((*root_ptr)->right), shuffled_key, original_key, parent_key);
+// Mette in servizio la versione 'nuova' e restituisce la precedente quando
+// nessun worker (né il main) la usa più: le richieste già prelevate finiscono
+// con la versione con cui sono iniziate, le successive usano la nuova.
+versione_t *bfs_pool_sostituisci_versione(bfs_pool_t *pool, versione_t *nuova) {
+    versione_t *vecchia = __atomic_exchange_n(&pool->versione, nuova, __ATOMIC_SEQ_CST);
+    for (int i = 0; i <= pool->num_worker; ++i) {
+        while (__atomic_load_n(&pool->in_uso[i], __ATOMIC_SEQ_CST) == vecchia) {
+            struct timespec attesa = { 0, 1000000L };
+            nanosleep(&attesa, NULL);
+        }
     }
-    return *root_ptr;
+    return vecchia;
 }
 
-abr_node_t* abr_search(abr_node_t *root, int shuffled_key) {
-    if (root == NULL || root->shuffled_codice == shuffled_key) {
-        return root;
+// Completa le richieste già accodate, poi termina e attende tutti i worker.
+void bfs_pool_destroy(bfs_pool_t *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->chiusura = 1;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 0; i < pool->num_worker; ++i) {
+        pthread_join(pool->tids[i], NULL);
     }
-    if (shuffled_key < root->shuffled_codice) {
-        return abr_search(root->left, shuffled_key);
-    } else {
-        return abr_search(root->right, shuffled_key);
+    for (int i = 0; i < pool->num_worker; ++i) {
+        pthread_mutex_destroy(&pool->code[i].mutex);
+        free(pool->code[i].buffer);
     }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_cond_destroy(&pool->not_full);
+    free(pool->code);
+    free(pool->tids);
+    free(pool->in_uso);
+    free(pool);
 }
 
-void abr_free(abr_node_t *root) {
-    if (root == NULL) return;
-    abr_free(root->left);
-    abr_free(root->right);
-    free(root);
-}
-
+// --- Protocollo di cammini.pipe ---
+// Il flusso è una sequenza di parole da 8 byte (due int32 little-endian):
+//  - una coppia nuda <start, end>, come nel protocollo originale;
+//  - un'intestazione_batch_t, riconoscibile perché il primo int32 è negativo
+//    (nessun codice lo è), seguita da 'num_coppie' coppie.
+// Un batch fino a PIPE_BUF byte (511 coppie) scritto con una sola write arriva
+// intero anche con più client contemporanei; batch più grandi vanno bene con un
+// solo client. Le letture possono spezzare le parole in qualunque punto: i byte
+// di una parola incompleta restano da parte fino alla lettura successiva.
+//  - una richiesta per nome: un'intestazione_batch_t con PROTOCOLLO_NOMI al
+//    posto della versione e in 'num_coppie' la lunghezza di un testo, che segue
+//    completato con '\0' fino a un multiplo di 8 byte (vedi lettore_nomi).
+// Le connessioni del socket (-S) usano lo stesso protocollo.
+#define PROTOCOLLO_MAGIC 0xCA3B0000u      // 16 bit alti di intestazione_batch_t.magic
+#define PROTOCOLLO_VERSIONE 1             // 16 bit bassi
+#define PROTOCOLLO_NOMI 0x4E              // 16 bit bassi di una richiesta per nome ('N')
+#define PROTOCOLLO_MAX_RISULTATI 32       // attori elencati al più in risposta a una ricerca
+#define DIM_BUFFER_PIPE (64 * 1024)
+#define DIM_LETTURA (8 + NOMI_MAX_TESTO + DIM_BUFFER_PIPE)
 
-// --- Thread Gestore Segnali ---
-void *signal_handler_thread_func(void *arg) {
-    (void)arg;
+typedef struct {
+    uint32_t magic;             // PROTOCOLLO_MAGIC | PROTOCOLLO_VERSIONE
+    uint32_t num_coppie;
+} intestazione_batch_t;
 
-    sigset_t set;
-    int sig;
+// Buffer di lettura del main, condiviso da cammini.pipe e dalle connessioni
+typedef struct {
+    bfs_pool_t *pool;           // la sua versione del grafo serve alle richieste per nome
+    int posto;                  // posto del main in pool->in_uso
+    char dati[DIM_LETTURA];     // resto della lettura precedente + nuova lettura
+    richiesta_t richieste[DIM_LETTURA / 8];
+    buffer_t testo;             // risposta a una ricerca per nome
+    // Statistiche
+    uint64_t coppie, batch, letture, scartati;
+    uint64_t nomi, nomi_non_trovati, ns_nomi; // chiavi risolte o cercate, e loro tempo
+} lettore_t;
 
-    char pid_str[32];
-    snprintf(pid_str, sizeof(pid_str), "%d\n", getpid());
-    write(STDOUT_FILENO, pid_str, strlen(pid_str));
+// Aggiunge a 'out' una riga <codice>\t<nome>\t<anno>\t<coprotagonisti> per
+// ognuno dei primi PROTOCOLLO_MAX_RISULTATI attori della chiave, in ordine di nome.
+// Restituisce quanti attori corrispondono in tutto.
+int64_t nomi_elenca(const grafo_t *g, const char *chiave, size_t dim, buffer_t *out) {
+    int prefisso = chiave_prefisso(chiave, &dim);
+    int64_t primo, ultimo;
+    nomi_cerca(g, chiave, dim, prefisso, &primo, &ultimo);
+    for (int64_t i = primo; i < ultimo && i < primo + PROTOCOLLO_MAX_RISULTATI; ++i) {
+        int id = g->per_nome[i];
+        buffer_printf(out, "%d\t%s\t%d\t%" PRId64 "\n", g->attori[id].codice, grafo_nome(g, id),
+                      g->attori[id].anno, g->offsets[id + 1] - g->offsets[id]);
+    }
+    return ultimo - primo;
+}
 
-    sigemptyset(&set);
-    sigaddset(&set, SIGINT);
 
-    while (1) {
-        if (sigwait(&set, &sig) != 0) {
-            if (errno == EINTR) continue;
-            perror("sigwait fallito");
-            break;
-        }
+// Richiesta per nome di 'dim' byte in 'testo':
+//  - "<start>\t<end>": cammino minimo tra due attori indicati ciascuno da un
+//    codice o da una chiave di nomi_risolvi. Diventa una richiesta normale, con
+//    i codici scelti (-1 se una chiave non corrisponde a nessuno), e come tale
+//    aggiunta in l->richieste[*n].
+//  - "<chiave>": ricerca. Risponde subito con l'elenco di nomi_elenca: sulla
+//    connessione, come record con start -1 ed end il numero di attori trovati,
+//    o su stdout per cammini.pipe.
+static void lettore_nomi(lettore_t *l, const grafo_t *g, const char *testo, size_t dim, connessione_t *conn,
+                         uint64_t arrivo_ns, int *n) {
+    const char *tab = memchr(testo, '\t', dim);
+    if (tab) {
+        int start_id = nomi_risolvi(g, testo, tab - testo);
+        int end_id = nomi_risolvi(g, tab + 1, testo + dim - tab - 1);
+        l->nomi += 2;
+        l->nomi_non_trovati += (start_id < 0) + (end_id < 0);
+        l->richieste[*n].start_codice = start_id >= 0 ? g->attori[start_id].codice : -1;
+        l->richieste[*n].end_codice = end_id >= 0 ? g->attori[end_id].codice : -1;
+        l->richieste[*n].conn = conn;
+        l->richieste[*n].arrivo_ns = arrivo_ns;
+        (*n)++;
+        return;
+    }
+    l->testo.dim = 0;
+    int64_t trovati = nomi_elenca(g, testo, dim, &l->testo);
+    l->nomi++;
+    l->nomi_non_trovati += trovati == 0;
+    if (conn) {
+        richiesta_t risposta = { -1, trovati < INT_MAX ? (int)trovati : INT_MAX, conn, arrivo_ns };
+        pthread_mutex_lock(&conn->mutex);
+        conn->in_corso++; // connessione_invia la considera una richiesta completata
+        pthread_mutex_unlock(&conn->mutex);
+        connessione_invia(conn, &risposta, l->testo.dati, l->testo.dim);
+    } else {
+        // Intestazione ed elenco restano contigui: i worker scrivono intanto i loro riepiloghi
+        flockfile(stdout);
+        printf("Ricerca \"%.*s\": %" PRId64 " attori\n", (int)dim, testo, trovati);
+        fwrite(l->testo.dati, 1, l->testo.dim, stdout);
+        fflush(stdout);
+        funlockfile(stdout);
+    }
+}
 
-        if (sig == SIGINT) {
-            if (S_PROGRAM_PHASE == PHASE_PIPE_READING) {
-                // Self-pipe trick: notifica al main di terminare scrivendo un byte.
-                char dummy = 'q'; 
-                if (write(S_SELF_PIPE_FD[1], &dummy, 1) < 0) {
+// Legge da 'fd' in coda al resto della lettura precedente e scompone le parole
+// complete in l->richieste, destinate a 'conn'. Restituisce il risultato della
+// read e in *num il numero di richieste.
+static ssize_t lettore_leggi(lettore_t *l, int fd, char *resto, size_t *dim_resto, uint32_t *rimaste,
+                             connessione_t *conn, const char *nome, int *num) {
+    *num = 0;
+    memcpy(l->dati, resto, *dim_resto);
+    ssize_t letti = read(fd, l->dati + *dim_resto, DIM_BUFFER_PIPE);
+    if (letti <= 0) return letti;
+    l->letture++;
+    uint64_t arrivo_ns = adesso_ns();
+    size_t dim = *dim_resto + letti, pos = 0;
+    int n = 0;
+    while (dim - pos >= 8) {
+        int32_t parola[2];
+        memcpy(parola, l->dati + pos, 8);
+        pos += 8;
+        if (*rimaste == 0 && ((uint32_t)parola[0] & 0xFFFF0000u) == PROTOCOLLO_MAGIC) {
+            uint32_t versione = (uint32_t)parola[0] & 0xFFFFu;
+            if (versione == PROTOCOLLO_NOMI && (uint32_t)parola[1] <= NOMI_MAX_TESTO) {
+                size_t dim_testo = (uint32_t)parola[1];
+                size_t dim_frame = (dim_testo + 7) & ~(size_t)7;
+                if (dim - pos < dim_frame) {
+                    pos -= 8; // Testo incompleto: resta, con l'intestazione, per la prossima lettura
+                    break;
                 }
+                // La versione si tiene solo qui: le richieste diventano codici,
+                // validi con qualunque versione, e l'accodamento può attendere.
+                uint64_t t0 = adesso_ns();
+                versione_t *v = versione_acquisisci(l->pool, l->posto);
+                lettore_nomi(l, &v->grafo, l->dati + pos, dim_testo, conn, arrivo_ns, &n);
+                versione_rilascia(l->pool, l->posto);
+                l->ns_nomi += adesso_ns() - t0;
+                pos += dim_frame;
+                continue;
+            }
+            if (versione != PROTOCOLLO_VERSIONE) {
+                // Non si può sapere dove finisce il batch: si scarta il resto della lettura
+                if (versione == PROTOCOLLO_NOMI) {
+                    fprintf(stderr, "%s: richiesta per nome di %u byte troppo lunga, %zu byte scartati\n",
+                            nome, (uint32_t)parola[1], dim - pos);
+                } else {
+                    fprintf(stderr, "%s: batch di versione %u non supportato, %zu byte scartati\n",
+                            nome, versione, dim - pos);
+                }
+                l->scartati += dim - pos;
+                pos = dim;
                 break;
-            } else {
-                const char *msg = "Costruzione del grafo in corso\n";
-                write(STDOUT_FILENO, msg, strlen(msg));
             }
+            *rimaste = (uint32_t)parola[1];
+            l->batch++;
+            continue;
         }
+        if (*rimaste > 0) (*rimaste)--;
+        l->richieste[n].start_codice = parola[0];
+        l->richieste[n].end_codice = parola[1];
+        l->richieste[n].conn = conn;
+        l->richieste[n].arrivo_ns = arrivo_ns;
+        n++;
     }
-    return NULL;
+    // I byte di una parola o di una richiesta per nome incompleta restano per la prossima lettura
+    *dim_resto = dim - pos;
+    memcpy(resto, l->dati + pos, *dim_resto);
+    l->coppie += n;
+    *num = n;
+    return letti;
 }
 
+// Fine di un flusso: una parola o un batch incompleti non arriveranno più.
+static void lettore_fine_flusso(lettore_t *l, size_t *dim_resto, uint32_t *rimaste, const char *nome) {
+    if (*dim_resto > 0 || *rimaste > 0) {
+        fprintf(stderr, "%s: flusso chiuso a metà (%zu byte, %u coppie del batch mancanti)\n",
+                nome, *dim_resto, *rimaste);
+        l->scartati += *dim_resto;
+    }
+    *dim_resto = 0;
+    *rimaste = 0;
+}
 
-// --- Thread Consumatore (per leggere grafo.txt) ---
-void *consumer_thread_func(void *arg) {
-    consumer_args_t *args = (consumer_args_t *)arg;
-    char *line;
-    char *saveptr; // Puntatore di stato per strtok_r
-
-    // Continua a prendere linee dal buffer finché non ce ne sono più
-    // e il produttore non ha finito.
-    while ((line = line_buffer_get(args->buffer)) != NULL) {
-        
-        // strtok_r modifica la stringa, quindi lavoriamo direttamente su 'line'
-        // che verrà liberata alla fine di ogni iterazione del ciclo.
-        
-        // 1. Estrai il primo token: il codice dell'attore principale
-        char *token = strtok_r(line, " \t\n", &saveptr);
-        if (token == NULL) { // Riga vuota o con solo spazi
-            free(line);
-            continue;
-        }
+// --- Server su Socket Unix ---
+typedef struct {
+    int fd;                     // socket in ascolto
+    const char *path;
+    int epoll_fd;
+    connessione_t *connessioni; // lista delle connessioni aperte
+    // Statistiche
+    uint64_t accettate, richieste;
+} server_socket_t;
 
-        int codice_attore = atoi(token);
-        
-        // 2. Cerca l'attore nell'array principale usando la ricerca binaria
-        attore *current_actor = find_attore_by_codice(codice_attore, args->attori_arr, args->tota_attori);
+// Crea il socket in ascolto su 'path' e lo registra in epoll con 'tag'.
+server_socket_t *server_socket_create(const char *path, int epoll_fd, void *tag) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Errore: percorso del socket troppo lungo: %s\n", path);
+        fallisci();
+    }
+    strcpy(addr.sun_path, path);
+    server_socket_t *srv = (server_socket_t *)calloc(1, sizeof(server_socket_t));
+    if (!srv) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    srv->path = path;
+    srv->epoll_fd = epoll_fd;
+    srv->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (srv->fd == -1 || bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(srv->fd, SOMAXCONN) == -1) {
+        perror("creazione del socket del server fallita");
+        fallisci();
+    }
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.ptr = tag;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, srv->fd, &ev) == -1) {
+        perror("epoll_ctl per il socket fallito");
+        fallisci();
+    }
+    return srv;
+}
 
-        if (current_actor == NULL) {
-            // Se l'attore non è nel nostro file nomi.txt, ignoriamo la riga.
-            fprintf(stderr, "Attenzione: codice attore %d trovato in grafo.txt ma non in nomi.txt. Riga ignorata.\n", codice_attore);
-            free(line);
+// Accetta tutte le connessioni in attesa.
+void server_socket_accetta(server_socket_t *srv) {
+    for (;;) {
+        int fd = accept4(srv->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept fallita");
+            return;
+        }
+        connessione_t *c = (connessione_t *)calloc(1, sizeof(connessione_t));
+        if (!c || pthread_mutex_init(&c->mutex, NULL) != 0) {
+            perror("creazione della connessione fallita");
+            fallisci();
+        }
+        c->fd = fd;
+        c->epoll_fd = srv->epoll_fd;
+        c->eventi = EPOLLIN;
+        c->registrata = 1;
+        struct epoll_event ev = { .events = EPOLLIN };
+        ev.data.ptr = c;
+        if (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            perror("epoll_ctl per la connessione fallito");
+            close(fd);
+            pthread_mutex_destroy(&c->mutex);
+            free(c);
             continue;
         }
+        c->succ = srv->connessioni;
+        if (srv->connessioni) srv->connessioni->prec = c;
+        srv->connessioni = c;
+        srv->accettate++;
+    }
+}
 
-        // 3. Inizializza i dati dei coprotagonisti per questo attore.
-        // È fondamentale per prepararsi a un nuovo popolamento.
-        current_actor->numcop = 0;
-        current_actor->cop = NULL; // Partiamo con un puntatore nullo
-        int capacity = 0;      // e una capacità allocata di 0.
-
-        // 4. Cicla su tutti i token rimanenti (i coprotagonisti)
-        token = strtok_r(NULL, " \t\n", &saveptr);
-        while (token != NULL) {
-            
-            // 5. Gestione dinamica dell'array 'cop'
-            // Se abbiamo riempito l'array (o se è la prima volta), dobbiamo allocare più memoria.
-            if (current_actor->numcop == capacity) {
-                // Strategia di crescita esponenziale per efficienza (riduce le chiamate a realloc)
-                capacity = (capacity == 0) ? 8 : capacity * 2;
-                int *new_cop_ptr = realloc(current_actor->cop, capacity * sizeof(int));
-                
-                // Gestione di un errore critico di memoria
-                if (new_cop_ptr == NULL) {
-                    perror("realloc fallita nel thread consumatore");
-                    free(line);
-                    exit(EXIT_FAILURE); 
-                }
-                current_actor->cop = new_cop_ptr;
-            }
-
-            // 6. Aggiungi il nuovo coprotagonista all'array
-            current_actor->cop[current_actor->numcop] = atoi(token);
-            current_actor->numcop++;
+static void server_socket_chiudi_connessione(server_socket_t *srv, connessione_t *c) {
+    if (c->prec) c->prec->succ = c->succ;
+    else srv->connessioni = c->succ;
+    if (c->succ) c->succ->prec = c->prec;
+    close(c->fd); // La rimuove anche da epoll
+    pthread_mutex_destroy(&c->mutex);
+    free(c->uscita.dati);
+    free(c);
+}
 
-            // Prendi il token successivo
-            token = strtok_r(NULL, " \t\n", &saveptr);
-        }
-        
-        
-        if (current_actor->numcop > 0 && current_actor->numcop < capacity) {
-            int *final_cop_ptr = realloc(current_actor->cop, current_actor->numcop * sizeof(int));
-            if (final_cop_ptr != NULL) {
-                current_actor->cop = final_cop_ptr;
+// Gestisce gli eventi di una connessione: nuove richieste, risposte da
+// completare, chiusura. Restituisce 0 se il pool ha scartato delle richieste
+// per la terminazione.
+int server_socket_evento(server_socket_t *srv, connessione_t *c, uint32_t eventi,
+                         lettore_t *l, bfs_pool_t *pool) {
+    int ok = 1;
+    if (eventi & EPOLLIN) {
+        int num;
+        ssize_t letti = lettore_leggi(l, c->fd, c->resto, &c->dim_resto, &c->rimaste, c, srv->path, &num);
+        if (num > 0) {
+            // in_corso prima di accodare: un worker può rispondere subito
+            pthread_mutex_lock(&c->mutex);
+            c->in_corso += num;
+            pthread_mutex_unlock(&c->mutex);
+            int accodate = bfs_pool_submit_molte(pool, l->richieste, num);
+            srv->richieste += accodate;
+            if (accodate < num) {
+                pthread_mutex_lock(&c->mutex);
+                c->in_corso -= num - accodate;
+                pthread_mutex_unlock(&c->mutex);
+                ok = 0;
             }
-           
         }
+        if (letti == 0 || (letti < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            lettore_fine_flusso(l, &c->dim_resto, &c->rimaste, srv->path);
+            pthread_mutex_lock(&c->mutex);
+            c->fine_richieste = 1;
+            if (letti < 0) c->rotta = 1;
+            pthread_mutex_unlock(&c->mutex);
+        }
+    }
+    pthread_mutex_lock(&c->mutex);
+    if (eventi & (EPOLLERR | EPOLLHUP)) {
+        c->rotta = 1;
+        c->fine_richieste = 1;
+    }
+    connessione_scrivi(c);
+    if (c->uscita.dim > CONNESSIONE_LIMITE_USCITA) {
+        c->in_pausa = 1; // Il client non legge le risposte: si smette di leggere le sue richieste
+    } else if (c->uscita.dim < CONNESSIONE_LIMITE_USCITA / 2) {
+        c->in_pausa = 0;
+    }
+    if (connessione_finita(c) || (c->rotta && c->in_corso == 0)) {
+        pthread_mutex_unlock(&c->mutex);
+        server_socket_chiudi_connessione(srv, c);
+        return ok;
+    }
+    connessione_aggiorna_eventi(c);
+    pthread_mutex_unlock(&c->mutex);
+    return ok;
+}
 
-
-        // 7. Libera la memoria della linea letta dal file, pronta per la prossima.
-        free(line);
+// Chiude tutte le connessioni e il socket. I worker devono aver già terminato:
+// le risposte rimaste vengono scritte se il socket le accetta subito.
+void server_socket_destroy(server_socket_t *srv) {
+    if (!srv) return;
+    while (srv->connessioni) {
+        connessione_t *c = srv->connessioni;
+        connessione_scrivi(c);
+        server_socket_chiudi_connessione(srv, c);
     }
-    
-    return NULL;
+    close(srv->fd);
+    unlink(srv->path);
+    fprintf(stderr, "Socket %s: %" PRIu64 " connessioni, %" PRIu64 " richieste\n",
+            srv->path, srv->accettate, srv->richieste);
+    free(srv);
 }
 
-// --- Thread Calcolo Cammino Minimo (BFS) ---
-void *bfs_thread_func(void *arg) {
-    bfs_args_t *args = (bfs_args_t *)arg;
-    pthread_detach(pthread_self());
+// Costruisce il grafo dai file di testo nomi.txt e grafo.txt, mappati in
+// memoria e analizzati in parallelo da num_thread thread.
+void grafo_carica_testo(grafo_t *g, const char *filenomi_path, const char *filegrafo_path, int num_thread) {
+    blocco_testo_t *blocchi = (blocco_testo_t *)calloc(num_thread, sizeof(blocco_testo_t));
+    const char **confini = (const char **)xmalloc((num_thread + 1) * sizeof(char *));
+    if (!blocchi) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    g->snapshot = NULL;
+    g->dim_snapshot = 0;
+    g->arena = (arena_t){ 0 };
+    g->per_nome = NULL;
+    g->per_codice = NULL;
+    g->compressi = NULL;
+    g->posizioni = NULL;
+    g->grado_max = 0;
 
-    struct tms t_start, t_end;
-    long ticks_per_sec = sysconf(_SC_CLK_TCK);
-    if (ticks_per_sec <= 0) ticks_per_sec = 100; 
+    // nomi.txt: conteggio delle righe, poi analisi direttamente nella posizione finale
+    size_t dim_nomi;
+    const char *nomi = xmappa_file(filenomi_path, &dim_nomi);
+    dividi_in_righe(nomi, dim_nomi, num_thread, confini);
+    for (int i = 0; i < num_thread; ++i) {
+        blocchi[i].inizio = confini[i];
+        blocchi[i].fine = confini[i + 1];
+        blocchi[i].g = g;
+    }
+    esegui_in_parallelo(num_thread, nomi_conta_thread_func, blocchi, sizeof(blocco_testo_t));
+    int64_t tot_righe = 0, tot_byte_nomi = 0;
+    for (int i = 0; i < num_thread; ++i) {
+        blocchi[i].primo = tot_righe;
+        blocchi[i].primo_byte = tot_byte_nomi;
+        tot_righe += blocchi[i].righe;
+        tot_byte_nomi += blocchi[i].byte_nomi;
+    }
+    if (tot_righe >= INT_MAX) {
+        fprintf(stderr, "Errore: %s contiene troppi attori.\n", filenomi_path);
+        fallisci();
+    }
+    // Un'unica area per tutti i nomi, invece di un'allocazione per attore: ogni
+    // blocco scrive i suoi da primo_byte, nell'ordine delle righe
+    attore *attori = (attore *)arena_alloca(&g->arena, tot_righe * sizeof(attore));
+    g->attori = attori;
+    g->nomi = (char *)arena_alloca(&g->arena, tot_byte_nomi);
+    g->dim_nomi = tot_byte_nomi;
+    esegui_in_parallelo(num_thread, nomi_analizza_thread_func, blocchi, sizeof(blocco_testo_t));
+    if (nomi) munmap((void *)nomi, dim_nomi);
 
-    times(&t_start); // Inizio misurazione tempo
+    // I blocchi con righe scartate lasciano dei buchi: si compatta in ordine.
+    // Nell'area dei nomi restano solo pochi byte inutilizzati.
+    int tota_attori = 0;
+    for (int i = 0; i < num_thread; ++i) {
+        memmove(attori + tota_attori, attori + blocchi[i].primo, blocchi[i].validi * sizeof(attore));
+        tota_attori += (int)blocchi[i].validi;
+    }
+    if (tota_attori == 0) {
+        fprintf(stderr, "Errore: %s è vuoto o non contiene attori validi.\n", filenomi_path);
+        fallisci();
+    }
+    g->tota_attori = tota_attori;
 
-    char output_filename[256];
-    sprintf(output_filename, "%d.%d", args->start_codice_orig, args->end_codice_orig);
+    // CreaGrafo scrive nomi.txt già ordinato per codice: il qsort serve solo altrimenti
+    for (int i = 1; i < tota_attori; ++i) {
+        if (attori[i - 1].codice > attori[i].codice) {
+            qsort(attori, tota_attori, sizeof(attore), compare_attori);
+            break;
+        }
+    }
 
-    FILE *out_fp = fopen(output_filename, "w");
-    if (!out_fp) {
-        fprintf(stderr, "Errore: impossibile creare file di output %s per %d-%d\n",
-                output_filename, args->start_codice_orig, args->end_codice_orig);
-        // Stampa su stdout che c'è stato un errore
-        printf("%d.%d: Errore creazione file output. Tempo di elaborazione 0.00 secondi\n",
-               args->start_codice_orig, args->end_codice_orig);
-        fflush(stdout);
-        free(args); // Libera gli argomenti allocati dal chiamante
-        return NULL;
+    // grafo.txt: gradi e offsets, poi coprotagonisti scritti direttamente nel CSR
+    size_t dim_grafo;
+    const char *testo_grafo = xmappa_file(filegrafo_path, &dim_grafo);
+    int *gradi = (int *)calloc(tota_attori, sizeof(int));
+    int *scritti = (int *)calloc(tota_attori, sizeof(int));
+    const char **prima_riga = (const char **)calloc(tota_attori, sizeof(char *));
+    if (!gradi || !scritti || !prima_riga) {
+        perror("calloc fallita");
+        fallisci();
+    }
+    dividi_in_righe(testo_grafo, dim_grafo, num_thread, confini);
+    for (int i = 0; i < num_thread; ++i) {
+        blocchi[i].inizio = confini[i];
+        blocchi[i].fine = confini[i + 1];
+        blocchi[i].prima_riga = prima_riga;
+        blocchi[i].gradi = gradi;
+        blocchi[i].scritti = scritti;
     }
+    esegui_in_parallelo(num_thread, grafo_conta_thread_func, blocchi, sizeof(blocco_testo_t));
+    righe_dimensiona(prima_riga, tota_attori, testo_grafo ? testo_grafo + dim_grafo : NULL, gradi);
 
-    attore *start_node = find_attore_by_codice(args->start_codice_orig, args->attori_arr, args->tota_attori);
-    attore *end_node = find_attore_by_codice(args->end_codice_orig, args->attori_arr, args->tota_attori);
+    int64_t *offsets = (int64_t *)arena_alloca(&g->arena, (tota_attori + 1) * sizeof(int64_t));
+    offsets[0] = 0;
+    for (int i = 0; i < tota_attori; ++i) {
+        offsets[i + 1] = offsets[i] + gradi[i];
+    }
+    int *vicini = (int *)arena_alloca(&g->arena, offsets[tota_attori] * sizeof(int));
+    g->offsets = offsets;
+    g->vicini = vicini;
+    esegui_in_parallelo(num_thread, grafo_analizza_thread_func, blocchi, sizeof(blocco_testo_t));
+    if (testo_grafo) munmap((void *)testo_grafo, dim_grafo);
 
-    if (!start_node) {
-        fprintf(out_fp, "codice %d non valido\n", args->start_codice_orig);
-    } else if (!end_node) {
-        fprintf(out_fp, "codice %d non valido\n", args->end_codice_orig);
-    } else {
-        fifo_queue_t *queue = fifo_queue_create();
-        abr_node_t *explored_root = NULL; // ABR per nodi visitati e predecessori
+    // Se sono stati scartati dei coprotagonisti le righe vanno avvicinate:
+    // ogni riga si sposta solo all'indietro, quindi basta una passata in avanti.
+    int64_t scrittura = 0;
+    for (int i = 0; i < tota_attori; ++i) {
+        int64_t lettura = offsets[i];
+        offsets[i] = scrittura;
+        if (scrittura != lettura) {
+            memmove(vicini + scrittura, vicini + lettura, scritti[i] * sizeof(int));
+        }
+        scrittura += scritti[i];
+    }
+    offsets[tota_attori] = scrittura;
 
-        // Inserisci il nodo di partenza
-        fifo_queue_enqueue(queue, args->start_codice_orig);
-        abr_insert(&explored_root, shuffle(args->start_codice_orig), args->start_codice_orig, -1); // -1 indica nessun parente
+    free(gradi);
+    free(scritti);
+    free(prima_riga);
+    free(confini);
+    free(blocchi);
 
-        int path_found = 0;
-        int current_codice; // Dichiarata qui, sarà usata per il dequeue
+    grafo_calcola_componenti(g, num_thread);
+}
 
-        while (!fifo_queue_is_empty(queue) && !path_found) {
-            
-            if (!fifo_queue_dequeue(queue, &current_codice)) {
-                break; // Uscita di sicurezza se la coda è vuota
-            }
+// --- Ricarica a Caldo ---
+// Con SIGHUP il grafo si ricarica dagli stessi file (snapshot o testo) mentre il
+// server continua a rispondere. Un thread carica la nuova versione, con indice
+// 2-hop, cache e team propri perché dipendono dagli id densi, poi la mette in
+// servizio con bfs_pool_sostituisci_versione e libera la vecchia quando l'ultima
+// richiesta che la usava ha finito. Per qualche istante i due grafi convivono
+// in memoria. I file vanno sostituiti con una rename, come fa CreaGrafo, e non
+// riscritti sul posto: una versione mappata da grafo.bin resta quella vecchia.
 
-            if (current_codice == args->end_codice_orig) {
-                path_found = 1;
-                break;
-            }
+// Libera una versione che nessuno usa più.
+void versione_destroy(versione_t *v) {
+    if (!v) return;
+    bfs_team_destroy(v->team);
+    if (v->cache) cache_stampa_statistiche(v->cache, stderr);
+    cache_destroy(v->cache);
+    pll_destroy(v->indice);
+    partecipazioni_destroy(v->partecipazioni);
+    grafo_destroy(&v->grafo);
+    free(v);
+}
 
-            attore *current_attore_obj = find_attore_by_codice(current_codice, args->attori_arr, args->tota_attori);
-            if (!current_attore_obj) { 
-                // fprintf(stderr, "BFS: Attore con codice %d non trovato durante la ricerca.\n", current_codice);
-                continue; // Salta questo attore se non trovato
-            }
+// Riempie la versione v, azzerata. Restituisce -1 se né lo snapshot né i file di
+// testo sono leggibili, o se non lo sono quelli di -P e -t; v resta da liberare.
+static int versione_riempi(versione_t *v, const opzioni_t *o, const char *filenomi_path,
+                           const char *filegrafo_path, int num_thread, uint64_t numero) {
+    grafo_t *g = &v->grafo;
+    uint64_t inizio_caricamento = adesso_ns();
+    if (!o->snapshot || grafo_carica_snapshot(g, o->snapshot, o->verifica_snapshot) != 0) {
+        if (access(filenomi_path, R_OK) != 0 || access(filegrafo_path, R_OK) != 0) {
+            fprintf(stderr, "Errore: %s o %s non leggibile: %s\n", filenomi_path, filegrafo_path, strerror(errno));
+            return -1;
+        }
+        if (o->snapshot) fprintf(stderr, "Caricamento dai file di testo.\n");
+        grafo_carica_testo(g, filenomi_path, filegrafo_path, num_thread);
+        struct stat st_nomi, st_grafo;
+        uint64_t byte = (stat(filenomi_path, &st_nomi) == 0 ? (uint64_t)st_nomi.st_size : 0) +
+                        (stat(filegrafo_path, &st_grafo) == 0 ? (uint64_t)st_grafo.st_size : 0);
+        statistiche_caricamento("testo", (adesso_ns() - inizio_caricamento) / 1e9, byte, g);
+    } else {
+        statistiche_caricamento("snapshot", (adesso_ns() - inizio_caricamento) / 1e9, g->dim_snapshot, g);
+    }
+    grafo_stampa_componenti(g, stderr, o->verbose);
+    if (o->riordino != RIORDINO_NESSUNO) grafo_riordina(g, o->riordino);
+    grafo_indicizza_nomi(g, num_thread);
 
-            for (int i = 0; i < current_attore_obj->numcop; ++i) {
-                int neighbor_codice = current_attore_obj->cop[i];
-                if (abr_search(explored_root, shuffle(neighbor_codice)) == NULL) { // Se il vicino non è stato esplorato
-                    abr_insert(&explored_root, shuffle(neighbor_codice), neighbor_codice, current_codice); // Marca come esplorato e registra il parente
-                    fifo_queue_enqueue(queue, neighbor_codice); // Aggiungi il vicino alla coda
-                }
-            }
+    if (o->file_partecipazioni) {
+        if (access(o->file_partecipazioni, R_OK) != 0 || (o->file_titoli && access(o->file_titoli, R_OK) != 0)) {
+            fprintf(stderr, "Errore: %s o %s non leggibile: %s\n", o->file_partecipazioni,
+                    o->file_titoli ? o->file_titoli : "-", strerror(errno));
+            return -1;
         }
+        v->partecipazioni = partecipazioni_carica(g, o->file_partecipazioni, o->file_titoli, num_thread);
+    }
 
-        if (path_found) {
-            // Ricostruisci il cammino (al contrario)
-            int *path = (int*)xmalloc(args->tota_attori * sizeof(int)); // Max path length
-            int path_len = 0;
-            int trace_codice = args->end_codice_orig;
-            while (trace_codice != -1) { // -1 è il parente del nodo start
-                if (path_len >= args->tota_attori) { // Sicurezza contro loop infiniti o cammini troppo lunghi
-                    fprintf(stderr, "Errore: superata lunghezza massima del cammino durante la ricostruzione per %d-%d.\n", args->start_codice_orig, args->end_codice_orig);
-                    path_len = 0; // Invalida il cammino
-                    break;
-                }
-                path[path_len++] = trace_codice;
-                abr_node_t *node_in_path = abr_search(explored_root, shuffle(trace_codice));
-                if (!node_in_path) { 
-                    fprintf(stderr, "Errore critico nella ricostruzione del cammino per %d-%d! Nodo %d (shuffled %d) non trovato in ABR.\n", args->start_codice_orig, args->end_codice_orig, trace_codice, shuffle(trace_codice));
-                    path_len = 0; // Segnala errore
-                    break;
-                }
-                trace_codice = node_in_path->parent_codice;
-            }
+    if (o->file_indice) {
+        v->indice = pll_prepara(g, o->file_indice, num_thread, o->verifica_snapshot);
+    }
+    if (o->comprimi) grafo_comprimi(g);
 
-            // Stampa il cammino (in ordine corretto)
-            for (int i = path_len - 1; i >= 0; --i) {
-                attore *actor_on_path = find_attore_by_codice(path[i], args->attori_arr, args->tota_attori);
-                if (actor_on_path) { // Dovrebbe essere sempre vero
-                    fprintf(out_fp, "%d\t%s\t%d\n", actor_on_path->codice, actor_on_path->nome, actor_on_path->anno);
-                }
-            }
-            free(path);
-            times(&t_end);
-            double elapsed_sec = (double)(t_end.tms_utime - t_start.tms_utime + t_end.tms_stime - t_start.tms_stime) / ticks_per_sec;
-            printf("%d.%d: Lunghezza minima %d. Tempo di elaborazione %.2f secondi\n",
-                   args->start_codice_orig, args->end_codice_orig, path_len > 0 ? path_len -1 : 0, elapsed_sec);
+    if (o->cache_mb > 0) {
+        int query_veloci = v->indice || o->modalita_bfs == BFS_BIDIREZIONALE;
+        v->cache = cache_create(o->cache_mb, g->tota_attori,
+                                query_veloci ? CACHE_SOGLIA_SORGENTE_VELOCE : CACHE_SOGLIA_SORGENTE);
+    }
+    v->team = bfs_team_create(o->thread_query, g->tota_attori);
+    v->numero = numero;
+    fprintf(stderr, "Arena del grafo: %.1f MB in %d regioni, %d in pagine grandi esplicite\n",
+            g->arena.mappati / (1024.0 * 1024.0), g->arena.num_regioni, g->arena.esplicite);
+    return 0;
+}
 
-        } else {
-            fprintf(out_fp, "non esistono cammini da %d a %d\n", args->start_codice_orig, args->end_codice_orig);
-            times(&t_end);
-            double elapsed_sec = (double)(t_end.tms_utime - t_start.tms_utime + t_end.tms_stime - t_start.tms_stime) / ticks_per_sec;
-            printf("%d.%d: Nessun cammino. Tempo di elaborazione %.2f secondi\n",
-                   args->start_codice_orig, args->end_codice_orig, elapsed_sec);
+// Carica una versione completa del grafo, o NULL se non è possibile. Con
+// 'ricarica' il server è già in servizio: gli errori irrecuperabili del
+// caricamento (fallisci, SIGBUS) non terminano il processo ma scartano la
+// versione a metà. Si liberano i pezzi già appesi alla versione; i buffer
+// temporanei del passo interrotto, se ce n'erano, restano persi.
+versione_t *versione_carica(const opzioni_t *o, const char *filenomi_path, const char *filegrafo_path,
+                            int num_thread, uint64_t numero, int ricarica) {
+    versione_t *volatile v = (versione_t *)calloc(1, sizeof(versione_t));
+    if (!v) {
+        perror("calloc fallita");
+        return NULL;
+    }
+    sigjmp_buf ripresa;
+    if (ricarica) {
+        if (sigsetjmp(ripresa, 1)) {
+            S_RIPRESA = NULL;
+            fprintf(stderr, "Caricamento della versione %" PRIu64 " interrotto.\n", numero);
+            versione_destroy(v);
+            return NULL;
         }
-        fflush(stdout); // Assicura che l'output su stdout sia visibile immediatamente
-        fifo_queue_destroy(queue);
-        abr_free(explored_root);
+        S_RIPRESA = &ripresa;
+    }
+    int esito = versione_riempi(v, o, filenomi_path, filegrafo_path, num_thread, numero);
+    S_RIPRESA = NULL;
+    if (esito != 0) {
+        versione_destroy(v);
+        return NULL;
     }
+    return v;
+}
+
+// Stato della ricarica, usato solo dal main e dal thread della ricarica in corso
+typedef struct {
+    pthread_t tid;
+    int avviata;                // thread creato e non ancora atteso
+    int finita;                 // scritto dal thread quando termina
+    bfs_pool_t *pool;
+    const opzioni_t *opzioni;
+    const char *filenomi_path, *filegrafo_path;
+    int num_thread;
+    uint64_t numero;            // numero della versione in servizio
+} ricarica_t;
 
-    fclose(out_fp);
-    free(args); // Libera gli argomenti allocati dal chiamante
+static void *ricarica_thread_func(void *arg) {
+    ricarica_t *r = (ricarica_t *)arg;
+    uint64_t inizio = adesso_ns();
+    fprintf(stderr, "Ricarica del grafo (versione %" PRIu64 ")...\n", r->numero + 1);
+    versione_t *nuova = versione_carica(r->opzioni, r->filenomi_path, r->filegrafo_path, r->num_thread,
+                                        r->numero + 1, 1);
+    if (!nuova) {
+        fprintf(stderr, "Ricarica non riuscita, resta in servizio la versione %" PRIu64 "\n", r->numero);
+        __atomic_add_fetch(&S_STATISTICHE.ricariche_fallite, 1, __ATOMIC_RELAXED);
+    } else {
+        uint64_t pronta = adesso_ns();
+        versione_t *vecchia = bfs_pool_sostituisci_versione(r->pool, nuova);
+        r->numero = nuova->numero;
+        fprintf(stderr, "Versione %" PRIu64 " in servizio: caricata in %.2f s, la precedente "
+                "rilasciata dalle richieste in corso in %.1f ms\n",
+                r->numero, (pronta - inizio) / 1e9, (adesso_ns() - pronta) / 1e6);
+        versione_destroy(vecchia);
+        __atomic_add_fetch(&S_STATISTICHE.ricariche, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&r->finita, 1, __ATOMIC_RELEASE);
     return NULL;
 }
 
+// Avvia una ricarica in background. Un SIGHUP che arriva mentre un'altra è in
+// corso si ignora: quella in corso legge già i file più recenti, o quasi.
+static void ricarica_avvia(ricarica_t *r) {
+    if (r->avviata) {
+        if (!__atomic_load_n(&r->finita, __ATOMIC_ACQUIRE)) {
+            fprintf(stderr, "Ricarica già in corso, SIGHUP ignorato.\n");
+            return;
+        }
+        pthread_join(r->tid, NULL);
+        r->avviata = 0;
+    }
+    r->finita = 0;
+    if (pthread_create(&r->tid, NULL, ricarica_thread_func, r) != 0) {
+        perror("pthread_create per la ricarica fallito");
+        return;
+    }
+    r->avviata = 1;
+}
+
+// Attende la fine della ricarica in corso, se c'è.
+static void ricarica_attendi(ricarica_t *r) {
+    if (r->avviata) pthread_join(r->tid, NULL);
+    r->avviata = 0;
+}
 
 // --- Funzione Main ---
 int main(int argc, char *argv[]) {
     S_MAIN_THREAD_ID = pthread_self();
 
-    if (argc != 4) {
-        fprintf(stderr, "Uso: %s <filenomi> <filegrafo> <numconsumatori>\n", argv[0]);
+    // Opzioni facoltative, prima dei tre argomenti posizionali:
+    //   -m uni|bidir   modalità di ricerca del cammino minimo (default: uni)
+    //   -v             statistiche di ogni query su stderr
+    //   -p <thread>    thread per la BFS parallela di una query grande
+    //                  (default: numero di CPU; 1 la disabilita)
+    //   -w <worker>    worker BFS del pool (default: numero di CPU)
+    //   -c <richieste> capacità della coda delle richieste (default: 1024)
+    //   -b <minimo>    con almeno <minimo> richieste in coda un worker ne risolve
+    //                  fino a 64 con una sola BFS multi-sorgente (default: 0, mai)
+    //   -s <snapshot>  mappa il grafo dallo snapshot binario di CreaGrafo; se
+    //                  manca o non è valido si usano i file di testo
+    //   -k             verifica i checksum di tutto lo snapshot prima di usarlo
+    //                  (e dell'indice 2-hop)
+    //   -L <indice>    risponde con l'indice 2-hop salvato in <indice>; se manca
+    //                  o è di un altro grafo lo costruisce e lo salva
+    //   -C <MB>        cache dei risultati e degli alberi BFS delle sorgenti
+    //                  frequenti, entro <MB> megabyte (default: 0, disattivata)
+    //   -o <file>      risultati come record in coda a <file>, o al lettore se
+    //                  <file> è una FIFO, invece di un file per richiesta
+    //   -F <ms>        con -o, fdatasync al più ogni <ms> millisecondi
+    //                  (0: dopo ogni scrittura; default: mai)
+    //   -S <socket>    accetta client anche sul socket Unix <socket>, con le
+    //                  risposte sulla stessa connessione
+    //   -T <file>      con SIGUSR1, e alla terminazione, scrive le statistiche
+    //                  di funzionamento in <file> invece che su stderr
+    //   -z             tiene le liste di adiacenza compresse in memoria
+    //   -P <file>      annota ogni cammino con i titoli in comune a ogni passo,
+    //                  dalle partecipazioni di CreaGrafo (partecipazioni.txt)
+    //   -t <file>      con -P, nomi dei titoli da title.basics.tsv
+    //   -R <strategia> rinumera gli attori per la località in memoria:
+    //                  grado, rcm o gorder (default: ordine dei codici)
+    //   -H             arene in pagine grandi esplicite (MAP_HUGETLB), se il
+    //                  sistema ne ha; altrimenti in pagine grandi trasparenti
+    //
+    // Segnali: SIGINT termina dopo aver completato le richieste accodate,
+    // SIGUSR1 scrive le statistiche, SIGHUP ricarica il grafo senza interrompere
+    // il servizio (vedi "Ricarica a Caldo").
+    long cpu_online = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_cpu = cpu_online > 0 ? (int)cpu_online : 1;
+    opzioni_t opzioni = { BFS_UNIDIREZIONALE, 0, num_cpu, num_cpu, 1024, 0, NULL, 0, NULL, 0, NULL, -1, NULL, NULL, 0, NULL, NULL, RIORDINO_NESSUNO };
+    int uso_errato = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:vp:w:c:b:s:kL:C:o:F:S:T:zP:t:R:H")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (strcmp(optarg, "uni") == 0) {
+                opzioni.modalita_bfs = BFS_UNIDIREZIONALE;
+            } else if (strcmp(optarg, "bidir") == 0) {
+                opzioni.modalita_bfs = BFS_BIDIREZIONALE;
+            } else {
+                fprintf(stderr, "Errore: modalità '%s' non valida (uni o bidir).\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'v':
+            opzioni.verbose = 1;
+            break;
+        case 'p':
+            opzioni.thread_query = atoi(optarg);
+            if (opzioni.thread_query <= 0 || opzioni.thread_query > 1024) {
+                fprintf(stderr, "Errore: il numero di thread per query deve essere tra 1 e 1024.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'w':
+            opzioni.num_worker = atoi(optarg);
+            if (opzioni.num_worker <= 0 || opzioni.num_worker > 1024) {
+                fprintf(stderr, "Errore: il numero di worker deve essere tra 1 e 1024.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'c':
+            opzioni.capacita_coda = atoi(optarg);
+            if (opzioni.capacita_coda <= 0) {
+                fprintf(stderr, "Errore: la capacità della coda deve essere un intero positivo.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'b':
+            opzioni.min_batch = atoi(optarg);
+            if (opzioni.min_batch < 0) {
+                fprintf(stderr, "Errore: la soglia di batch deve essere un intero non negativo.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 's':
+            opzioni.snapshot = optarg;
+            break;
+        case 'k':
+            opzioni.verifica_snapshot = 1;
+            break;
+        case 'L':
+            opzioni.file_indice = optarg;
+            break;
+        case 'C':
+            opzioni.cache_mb = atol(optarg);
+            if (opzioni.cache_mb < 0) {
+                fprintf(stderr, "Errore: la memoria della cache deve essere un intero non negativo.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'o':
+            opzioni.file_risultati = optarg;
+            break;
+        case 'S':
+            opzioni.socket = optarg;
+            break;
+        case 'T':
+            opzioni.file_statistiche = optarg;
+            break;
+        case 'z':
+            opzioni.comprimi = 1;
+            break;
+        case 'P':
+            opzioni.file_partecipazioni = optarg;
+            break;
+        case 't':
+            opzioni.file_titoli = optarg;
+            break;
+        case 'H':
+            S_PAGINE_ESPLICITE = 1;
+            break;
+        case 'R':
+            if (strcmp(optarg, "grado") == 0) {
+                opzioni.riordino = RIORDINO_GRADO;
+            } else if (strcmp(optarg, "rcm") == 0) {
+                opzioni.riordino = RIORDINO_RCM;
+            } else if (strcmp(optarg, "gorder") == 0) {
+                opzioni.riordino = RIORDINO_GORDER;
+            } else {
+                fprintf(stderr, "Errore: riordino '%s' non valido (grado, rcm o gorder).\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'F':
+            opzioni.fsync_ms = atol(optarg);
+            if (opzioni.fsync_ms < 0) {
+                fprintf(stderr, "Errore: l'intervallo di fsync deve essere un intero non negativo.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        default:
+            uso_errato = 1;
+        }
+    }
+
+    if (uso_errato || argc - optind != 3) {
+        fprintf(stderr, "Uso: %s [-m uni|bidir] [-v] [-p thread] [-w worker] [-c richieste] [-b minimo] [-s snapshot] [-k] [-L indice] [-C MB] [-o risultati] [-F ms] [-S socket] [-T statistiche] [-z] [-P partecipazioni [-t titoli]] [-R grado|rcm|gorder] [-H] <filenomi> <filegrafo> <numconsumatori>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (opzioni.file_titoli && !opzioni.file_partecipazioni) {
+        fprintf(stderr, "Errore: -t richiede -P.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (opzioni.fsync_ms >= 0 && !opzioni.file_risultati) {
+        fprintf(stderr, "Errore: -F richiede -o.\n");
         exit(EXIT_FAILURE);
     }
 
-    char *filenomi_path = argv[1];
-    char *filegrafo_path = argv[2];
-    long num_consumatori_long = strtol(argv[3], NULL, 10);
+    char *filenomi_path = argv[optind];
+    char *filegrafo_path = argv[optind + 1];
+    long num_consumatori_long = strtol(argv[optind + 2], NULL, 10);
 
     if (num_consumatori_long <= 0 || num_consumatori_long > 1024) {
         fprintf(stderr, "Errore: numconsumatori deve essere un intero positivo (max 1024).\n");
@@ -548,13 +5353,25 @@ int main(int argc, char *argv[]) {
     int num_consumatori = (int)num_consumatori_long;
 
     // --- SETUP GESTIONE SEGNALI ---
+    S_FILE_STATISTICHE = opzioni.file_statistiche;
     sigset_t sigint_mask;
     sigemptyset(&sigint_mask);
     sigaddset(&sigint_mask, SIGINT);
+    sigaddset(&sigint_mask, SIGUSR1); // Statistiche su richiesta, gestite dal thread dei segnali
+    sigaddset(&sigint_mask, SIGHUP);  // Ricarica del grafo, idem
     if (pthread_sigmask(SIG_BLOCK, &sigint_mask, NULL) != 0) {
         perror("pthread_sigmask fallito");
         exit(EXIT_FAILURE);
     }
+    // SIGBUS resta sincrono, nel thread che legge la mappatura: vedi fallisci()
+    struct sigaction sa_bus;
+    memset(&sa_bus, 0, sizeof(sa_bus));
+    sa_bus.sa_handler = sigbus_handler;
+    sigemptyset(&sa_bus.sa_mask);
+    if (sigaction(SIGBUS, &sa_bus, NULL) != 0) {
+        perror("sigaction per SIGBUS fallita");
+        exit(EXIT_FAILURE);
+    }
 
     // Creiamo la self-pipe per la notifica dei segnali
     if (pipe(S_SELF_PIPE_FD) == -1) {
@@ -573,79 +5390,23 @@ int main(int argc, char *argv[]) {
     S_PROGRAM_PHASE = PHASE_GRAPH_CONSTRUCTION;
 
     // --- Inizio del blocco di codice che avevo omesso ---
-    FILE *fp_nomi = xfopen(filenomi_path, "r");
-    int tota_attori = 0;
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read_len;
-
-    while ((read_len = getline(&line, &len, fp_nomi)) != -1) {
-        if (read_len > 1) tota_attori++;
-    }
-    rewind(fp_nomi);
-
-    if (tota_attori == 0) {
-        fprintf(stderr, "Errore: %s è vuoto o non contiene attori validi.\n", filenomi_path);
-        fclose(fp_nomi);
-        if (line) free(line);
-        exit(EXIT_FAILURE);
-    }
-
-    attore *attori_arr = (attore *)xmalloc(tota_attori * sizeof(attore));
-    int current_idx = 0;
-    while ((read_len = getline(&line, &len, fp_nomi)) != -1 && current_idx < tota_attori) {
-        if (read_len <= 1) continue;
-        if (line[read_len - 1] == '\n') line[read_len - 1] = '\0';
-        char *codice_str = strtok(line, "\t");
-        char *nome_str = strtok(NULL, "\t");
-        char *anno_str = strtok(NULL, "\t");
-        if (codice_str && nome_str && anno_str) {
-            attori_arr[current_idx].codice = atoi(codice_str);
-            attori_arr[current_idx].nome = xstrdup(nome_str);
-            attori_arr[current_idx].anno = atoi(anno_str);
-            attori_arr[current_idx].cop = NULL;
-            attori_arr[current_idx].numcop = 0;
-            current_idx++;
-        }
-    }
-    tota_attori = current_idx;
-    fclose(fp_nomi);
-    if (line) free(line);
-    line = NULL; len = 0;
+    versione_t *versione = versione_carica(&opzioni, filenomi_path, filegrafo_path, num_consumatori, 1, 0);
+    if (!versione) exit(EXIT_FAILURE);
 
-    qsort(attori_arr, tota_attori, sizeof(attore), compare_attori);
-
-    line_buffer_t *shared_line_buffer = line_buffer_init(num_consumatori * 10);
-    pthread_t *consumer_tids = (pthread_t *)xmalloc(num_consumatori * sizeof(pthread_t));
-    consumer_args_t consumer_args = { shared_line_buffer, attori_arr, tota_attori };
-
-    for (int i = 0; i < num_consumatori; ++i) {
-        if (pthread_create(&consumer_tids[i], NULL, consumer_thread_func, &consumer_args) != 0) {
-            perror("pthread_create per consumer_thread fallito");
-            exit(EXIT_FAILURE);
-        }
-    }
-
-    FILE *fp_grafo = xfopen(filegrafo_path, "r");
-    while ((read_len = getline(&line, &len, fp_grafo)) != -1) {
-        if (read_len > 1) {
-            line_buffer_put(shared_line_buffer, xstrdup(line));
-        }
+    scrittore_t *scrittore = NULL;
+    if (opzioni.file_risultati) {
+        signal(SIGPIPE, SIG_IGN); // Un lettore della FIFO che chiude non deve terminare il processo
+        scrittore = scrittore_create(opzioni.file_risultati, opzioni.fsync_ms);
     }
-    fclose(fp_grafo);
-    if (line) free(line);
 
-    line_buffer_set_done(shared_line_buffer);
-    for (int i = 0; i < num_consumatori; ++i) {
-        pthread_join(consumer_tids[i], NULL);
-    }
-    free(consumer_tids);
-    line_buffer_destroy(shared_line_buffer);
+    bfs_pool_t *bfs_pool = bfs_pool_create(opzioni.num_worker, opzioni.capacita_coda, versione, scrittore, &opzioni);
+    ricarica_t ricarica = { .pool = bfs_pool, .opzioni = &opzioni, .filenomi_path = filenomi_path,
+                            .filegrafo_path = filegrafo_path, .num_thread = num_consumatori, .numero = 1 };
     // --- Fine del blocco di codice che avevo omesso ---
     // --- FINE FASE 1 ---
 
 
-    // --- FASE 2: LETTURA DALLA PIPE CON SELECT ---
+    // --- FASE 2: LETTURA DALLA PIPE CON EPOLL ---
     S_PROGRAM_PHASE = PHASE_PIPE_READING;
     const char *pipe_name = "cammini.pipe";
     unlink(pipe_name);
@@ -660,82 +5421,123 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    fd_set read_fds;
-    int max_fd = (S_CAMMINI_PIPE_FD > S_SELF_PIPE_FD[0]) ? S_CAMMINI_PIPE_FD : S_SELF_PIPE_FD[0];
+    // In epoll i descrittori fissi sono identificati da questi indirizzi, le
+    // connessioni dal loro connessione_t.
+    static char evento_self_pipe, evento_pipe, evento_socket;
+    int epoll_fd = epoll_create1(0);
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.ptr = &evento_self_pipe;
+    if (epoll_fd == -1 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, S_SELF_PIPE_FD[0], &ev) == -1) {
+        perror("epoll fallito");
+        unlink(pipe_name);
+        exit(EXIT_FAILURE);
+    }
+    ev.data.ptr = &evento_pipe;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, S_CAMMINI_PIPE_FD, &ev) == -1) {
+        perror("epoll_ctl per cammini.pipe fallito");
+        unlink(pipe_name);
+        exit(EXIT_FAILURE);
+    }
+    server_socket_t *server = opzioni.socket ? server_socket_create(opzioni.socket, epoll_fd, &evento_socket) : NULL;
+
+    lettore_t *lettore = (lettore_t *)calloc(1, sizeof(lettore_t));
+    if (!lettore) {
+        perror("calloc fallita");
+        exit(EXIT_FAILURE);
+    }
+    lettore->pool = bfs_pool;
+    lettore->posto = opzioni.num_worker; // L'ultimo posto di in_uso
+    char resto_pipe[8 + NOMI_MAX_TESTO];
+    size_t dim_resto_pipe = 0;
+    uint32_t rimaste_pipe = 0;
     int keep_looping = 1;
 
     while (keep_looping) {
-        FD_ZERO(&read_fds);
-        FD_SET(S_CAMMINI_PIPE_FD, &read_fds);
-        FD_SET(S_SELF_PIPE_FD[0], &read_fds);
+        struct epoll_event eventi[64];
+        int pronti = epoll_wait(epoll_fd, eventi, 64, -1);
 
-        int activity = select(max_fd + 1, &read_fds, NULL, NULL, NULL);
-
-        if (activity < 0) {
+        if (pronti < 0) {
             if (errno == EINTR) continue;
-            perror("select fallito");
+            perror("epoll_wait fallito");
             break;
         }
 
-        if (FD_ISSET(S_SELF_PIPE_FD[0], &read_fds)) {
-            keep_looping = 0; // Segnale di terminazione ricevuto
-            continue;
-        }
+        for (int i = 0; i < pronti && keep_looping; ++i) {
+            void *tag = eventi[i].data.ptr;
+            if (tag == &evento_self_pipe) {
+                char comando = 'q';
+                if (read(S_SELF_PIPE_FD[0], &comando, 1) == 1 && comando == 'r') {
+                    ricarica_avvia(&ricarica); // SIGHUP
+                } else {
+                    keep_looping = 0; // Segnale di terminazione ricevuto
+                }
+            } else if (tag == &evento_socket) {
+                server_socket_accetta(server);
+            } else if (tag != &evento_pipe) {
+                if (!server_socket_evento(server, (connessione_t *)tag, eventi[i].events, lettore, bfs_pool)) {
+                    keep_looping = 0; // Terminazione durante l'attesa
+                }
+            } else {
+                // Una lettura grande per risveglio: epoll è level-triggered, quindi se
+                // restano dati si torna subito qui.
+                int num;
+                ssize_t bytes_read = lettore_leggi(lettore, S_CAMMINI_PIPE_FD, resto_pipe, &dim_resto_pipe,
+                                                   &rimaste_pipe, NULL, pipe_name, &num);
 
-        if (FD_ISSET(S_CAMMINI_PIPE_FD, &read_fds)) {
-            int32_t codici_pipe[2];
-            ssize_t bytes_read = read(S_CAMMINI_PIPE_FD, codici_pipe, sizeof(codici_pipe));
+                if (bytes_read == 0) {
+                    // Tutti i client hanno chiuso: si riapre per i prossimi
+                    lettore_fine_flusso(lettore, &dim_resto_pipe, &rimaste_pipe, pipe_name);
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, S_CAMMINI_PIPE_FD, NULL);
+                    close(S_CAMMINI_PIPE_FD);
+                    S_CAMMINI_PIPE_FD = open(pipe_name, O_RDONLY | O_NONBLOCK);
+                    ev.data.ptr = &evento_pipe;
+                    if (S_CAMMINI_PIPE_FD == -1 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, S_CAMMINI_PIPE_FD, &ev) == -1) {
+                        perror("riapertura pipe fallita");
+                        keep_looping = 0;
+                    }
+                    continue;
+                }
 
-            if (bytes_read == 0) {
-                close(S_CAMMINI_PIPE_FD);
-                S_CAMMINI_PIPE_FD = open(pipe_name, O_RDONLY | O_NONBLOCK);
-                if (S_CAMMINI_PIPE_FD == -1) {
-                    perror("riapertura pipe fallita");
-                    keep_looping = 0;
+                if (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    perror("read da cammini.pipe fallito");
+                    continue;
                 }
-                max_fd = (S_CAMMINI_PIPE_FD > S_SELF_PIPE_FD[0]) ? S_CAMMINI_PIPE_FD : S_SELF_PIPE_FD[0];
-                continue;
-            }
-            
-            if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                 // Nessun dato da leggere, è normale con O_NONBLOCK. Continua a select.
-                 continue;
-            }
-            
-            if (bytes_read < 0) {
-                perror("read da cammini.pipe fallito");
-                continue;
-            }
 
-            if (bytes_read == sizeof(codici_pipe)) {
-                bfs_args_t *bfs_task_args = (bfs_args_t*)xmalloc(sizeof(bfs_args_t));
-                bfs_task_args->attori_arr = attori_arr;
-                bfs_task_args->tota_attori = tota_attori;
-                bfs_task_args->start_codice_orig = codici_pipe[0];
-                bfs_task_args->end_codice_orig = codici_pipe[1];
-                
-                pthread_t bfs_tid;
-                if (pthread_create(&bfs_tid, NULL, bfs_thread_func, bfs_task_args) != 0) {
-                    perror("pthread_create per bfs_thread fallito");
-                    free(bfs_task_args);
+                if (num > 0 && bfs_pool_submit_molte(bfs_pool, lettore->richieste, num) < num) {
+                    keep_looping = 0; // Terminazione durante l'attesa
                 }
             }
         }
     }
+    fprintf(stderr, "Letture: %" PRIu64 " coppie (%" PRIu64 " batch) in %" PRIu64 " letture",
+            lettore->coppie, lettore->batch, lettore->letture);
+    if (lettore->scartati) fprintf(stderr, ", %" PRIu64 " byte scartati", lettore->scartati);
+    fprintf(stderr, "\n");
+    if (lettore->nomi) {
+        fprintf(stderr, "Nomi: %" PRIu64 " cercati (%" PRIu64 " senza risultati), %.1f us in media\n",
+                lettore->nomi, lettore->nomi_non_trovati, lettore->ns_nomi / 1e3 / lettore->nomi);
+    }
+    free(lettore->testo.dati);
+    free(lettore);
 
     // --- FASE 3: TERMINAZIONE ---
+    pthread_mutex_lock(&S_SELF_PIPE_MUTEX);
+    S_PROGRAM_PHASE = PHASE_TERMINATION;
+    pthread_mutex_unlock(&S_SELF_PIPE_MUTEX);
     close(S_CAMMINI_PIPE_FD);
     close(S_SELF_PIPE_FD[0]);
     close(S_SELF_PIPE_FD[1]);
     
-    struct timespec wait_time = {20, 0};
-    nanosleep(&wait_time, NULL);
-    
-    for (int i = 0; i < tota_attori; ++i) {
-        if (attori_arr[i].nome) free(attori_arr[i].nome);
-        if (attori_arr[i].cop) free(attori_arr[i].cop);
-    }
-    free(attori_arr);
+    // Una ricarica in corso arriva fino in fondo; poi le richieste già
+    // accodate vengono completate prima di liberare il grafo
+    ricarica_attendi(&ricarica);
+    versione = bfs_pool->versione;
+    bfs_pool_destroy(bfs_pool);
+    if (opzioni.file_statistiche) statistiche_scarica(); // Il file resta con i valori finali
+    server_socket_destroy(server);
+    close(epoll_fd);
+    scrittore_destroy(scrittore);
+    versione_destroy(versione);
     unlink(pipe_name);
 
     pthread_join(signal_tid, NULL);
@@ -0,0 +1,408 @@
+#define _GNU_SOURCE // Per getline. Mantenuto qui.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Client di carico per cammini.out: invia coppie casuali di codici presi da
+// nomi.txt su cammini.pipe e misura quante coppie al secondo il server accetta.
+// Il server applica la backpressure, quindi il ritmo misurato è quello a cui
+// legge e accoda le richieste.
+// Con -u il client si collega invece al socket del server (opzione -S), tiene
+// fino a -w richieste in volo su ogni connessione e attende tutte le risposte:
+// oltre al ritmo misura la latenza di ogni richiesta.
+// Con -N le coppie si chiedono per nome invece che per codice.
+
+// Come in cammini.c (sezione "Protocollo di cammini.pipe")
+#define PROTOCOLLO_MAGIC 0xCA3B0000u
+#define PROTOCOLLO_VERSIONE 1
+#define PROTOCOLLO_NOMI 0x4E
+#define NOMI_MAX_TESTO 1016
+
+typedef struct {
+    uint32_t magic;
+    uint32_t num_coppie;
+} intestazione_batch_t;
+
+// Come in cammini.c: intestazione di ogni risposta sul socket
+typedef struct {
+    uint32_t dim;
+    int32_t start_codice;
+    int32_t end_codice;
+} record_esito_t;
+
+typedef struct {
+    int32_t start_codice;
+    int32_t end_codice;
+    double inviata;             // istante di invio, in secondi
+} in_volo_t;
+
+typedef struct {
+    int indice;
+    const char *pipe;
+    const int32_t *codici;
+    char *const *nomi;          // con -N, il nome di ogni codice; altrimenti NULL
+    int num_codici;
+    long coppie;                // coppie da inviare
+    int per_batch;              // 0: una coppia nuda per write
+    long write_eseguite;
+    const char *socket;         // NULL: cammini.pipe
+    int finestra;               // con il socket: richieste in volo al massimo
+    double *latenze;            // con il socket: una per risposta
+    long risposte;
+} client_t;
+
+static void *xmalloc(size_t n) {
+    void *p = malloc(n);
+    if (!p) {
+        perror("malloc fallita");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void scrivi_tutto(int fd, const void *dati, size_t dim) {
+    const char *p = (const char *)dati;
+    while (dim > 0) {
+        ssize_t n = write(fd, p, dim);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            perror("write su cammini.pipe fallita");
+            exit(EXIT_FAILURE);
+        }
+        p += n;
+        dim -= n;
+    }
+}
+
+// Scrive in 'buf' la richiesta per nome della coppia di attori (i, j) e ne
+// restituisce la dimensione, o 0 se i nomi sono troppo lunghi.
+static size_t richiesta_per_nome(char *buf, char *const *nomi, int i, int j) {
+    int dim = snprintf(buf + sizeof(intestazione_batch_t), NOMI_MAX_TESTO + 1, "%s\t%s", nomi[i], nomi[j]);
+    if (dim < 0 || dim > NOMI_MAX_TESTO) return 0;
+    intestazione_batch_t h = { PROTOCOLLO_MAGIC | PROTOCOLLO_NOMI, (uint32_t)dim };
+    memcpy(buf, &h, sizeof(h));
+    size_t dim_frame = (dim + 7) & ~(size_t)7;
+    memset(buf + sizeof(h) + dim, 0, dim_frame - dim);
+    return sizeof(h) + dim_frame;
+}
+
+static double adesso(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Client su socket: invio e ricezione si alternano con poll, così il client
+// legge le risposte anche mentre il server non accetta altre richieste.
+static void client_socket(client_t *c) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, c->socket, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        perror("connessione al socket fallita");
+        exit(EXIT_FAILURE);
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    unsigned int seme = 12345u + c->indice;
+    int per_write = c->per_batch > 0 ? c->per_batch : 1;
+    in_volo_t *in_volo = (in_volo_t *)xmalloc(c->finestra * sizeof(in_volo_t));
+    int num_in_volo = 0;
+    c->latenze = (double *)xmalloc(c->coppie * sizeof(double));
+    // Richieste preparate e non ancora scritte del tutto
+    size_t per_coppia = c->nomi ? sizeof(intestazione_batch_t) + NOMI_MAX_TESTO + 8 : 2 * sizeof(int32_t);
+    char *uscita = (char *)xmalloc(sizeof(intestazione_batch_t) + per_write * per_coppia);
+    size_t dim_uscita = 0, inviati = 0;
+    // Risposte: si conservano solo le intestazioni, il testo si salta
+    size_t cap_ingresso = 64 * 1024, dim_ingresso = 0;
+    char *ingresso = (char *)xmalloc(cap_ingresso);
+    long preparate = 0;
+
+    while (c->risposte < c->coppie) {
+        if (inviati == dim_uscita && preparate < c->coppie && num_in_volo < c->finestra) {
+            int n = c->finestra - num_in_volo;
+            if (n > per_write) n = per_write;
+            if (n > c->coppie - preparate) n = (int)(c->coppie - preparate);
+            int32_t *coppie = (int32_t *)uscita;
+            if (c->per_batch > 0 && !c->nomi) {
+                intestazione_batch_t h = { PROTOCOLLO_MAGIC | PROTOCOLLO_VERSIONE, (uint32_t)n };
+                memcpy(uscita, &h, sizeof(h));
+                coppie += 2;
+            }
+            double t = adesso();
+            dim_uscita = 0;
+            for (int i = 0; i < n; ++i) {
+                int a = rand_r(&seme) % c->num_codici, b = rand_r(&seme) % c->num_codici;
+                if (c->nomi) {
+                    size_t dim = 0;
+                    while ((dim = richiesta_per_nome(uscita + dim_uscita, c->nomi, a, b)) == 0) {
+                        a = rand_r(&seme) % c->num_codici;
+                    }
+                    dim_uscita += dim;
+                } else {
+                    coppie[2 * i] = c->codici[a];
+                    coppie[2 * i + 1] = c->codici[b];
+                }
+                in_volo[num_in_volo++] = (in_volo_t){ c->codici[a], c->codici[b], t };
+            }
+            if (!c->nomi) dim_uscita = (char *)(coppie + 2 * n) - uscita;
+            inviati = 0;
+            preparate += n;
+            c->write_eseguite++;
+        }
+        struct pollfd pfd = { fd, POLLIN | (inviati < dim_uscita ? POLLOUT : 0), 0 };
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll fallito");
+            exit(EXIT_FAILURE);
+        }
+        if (pfd.revents & POLLOUT) {
+            ssize_t n = send(fd, uscita + inviati, dim_uscita - inviati, MSG_NOSIGNAL);
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                perror("send sul socket fallita");
+                exit(EXIT_FAILURE);
+            }
+            if (n > 0) inviati += n;
+        }
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            if (cap_ingresso - dim_ingresso < 4096) {
+                cap_ingresso *= 2;
+                ingresso = (char *)realloc(ingresso, cap_ingresso);
+                if (!ingresso) {
+                    perror("realloc fallita");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            ssize_t n = read(fd, ingresso + dim_ingresso, cap_ingresso - dim_ingresso);
+            if (n == 0) {
+                fprintf(stderr, "Il server ha chiuso la connessione: %ld risposte su %ld\n",
+                        c->risposte, c->coppie);
+                exit(EXIT_FAILURE);
+            }
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                perror("read dal socket fallita");
+                exit(EXIT_FAILURE);
+            }
+            if (n > 0) dim_ingresso += n;
+            size_t pos = 0;
+            double t = adesso();
+            while (dim_ingresso - pos >= sizeof(record_esito_t)) {
+                record_esito_t rec;
+                memcpy(&rec, ingresso + pos, sizeof(rec));
+                if (dim_ingresso - pos < sizeof(rec) + rec.dim) break;
+                pos += sizeof(rec) + rec.dim;
+                int i = 0;
+                while (i < num_in_volo && (in_volo[i].start_codice != rec.start_codice ||
+                                           in_volo[i].end_codice != rec.end_codice)) i++;
+                if (i == num_in_volo && c->nomi && num_in_volo > 0) {
+                    // Un omonimo scelto dal server al posto dell'attore chiesto: la
+                    // latenza si attribuisce alla richiesta in volo da più tempo
+                    i = 0;
+                    for (int k = 1; k < num_in_volo; ++k) {
+                        if (in_volo[k].inviata < in_volo[i].inviata) i = k;
+                    }
+                }
+                if (i == num_in_volo) {
+                    fprintf(stderr, "Risposta inattesa: %d %d\n", rec.start_codice, rec.end_codice);
+                    exit(EXIT_FAILURE);
+                }
+                c->latenze[c->risposte++] = t - in_volo[i].inviata;
+                in_volo[i] = in_volo[--num_in_volo];
+            }
+            memmove(ingresso, ingresso + pos, dim_ingresso - pos);
+            dim_ingresso -= pos;
+        }
+    }
+    free(ingresso);
+    free(uscita);
+    free(in_volo);
+    close(fd);
+}
+
+static void *client_thread_func(void *arg) {
+    client_t *c = (client_t *)arg;
+    if (c->socket) {
+        client_socket(c);
+        return NULL;
+    }
+    int fd = open(c->pipe, O_WRONLY);
+    if (fd == -1) {
+        perror("apertura di cammini.pipe fallita");
+        exit(EXIT_FAILURE);
+    }
+    unsigned int seme = 12345u + c->indice;
+    int per_write = c->per_batch > 0 ? c->per_batch : 1;
+    int32_t *buf = (int32_t *)xmalloc(sizeof(intestazione_batch_t) + per_write * 2 * sizeof(int32_t) +
+                                      NOMI_MAX_TESTO + 8);
+
+    for (long inviate = 0; inviate < c->coppie; ) {
+        if (c->nomi) {
+            // Una richiesta per nome per write, così resta atomica anche con più client
+            size_t dim = richiesta_per_nome((char *)buf, c->nomi, rand_r(&seme) % c->num_codici,
+                                            rand_r(&seme) % c->num_codici);
+            if (dim == 0) continue;
+            scrivi_tutto(fd, buf, dim);
+            c->write_eseguite++;
+            inviate++;
+            continue;
+        }
+        int n = (c->coppie - inviate < per_write) ? (int)(c->coppie - inviate) : per_write;
+        int32_t *coppie = buf;
+        if (c->per_batch > 0) {
+            intestazione_batch_t h = { PROTOCOLLO_MAGIC | PROTOCOLLO_VERSIONE, (uint32_t)n };
+            memcpy(buf, &h, sizeof(h));
+            coppie = buf + 2;
+        }
+        for (int i = 0; i < n; ++i) {
+            coppie[2 * i] = c->codici[rand_r(&seme) % c->num_codici];
+            coppie[2 * i + 1] = c->codici[rand_r(&seme) % c->num_codici];
+        }
+        scrivi_tutto(fd, buf, (char *)(coppie + 2 * n) - (char *)buf);
+        c->write_eseguite++;
+        inviate += n;
+    }
+    free(buf);
+    close(fd);
+    return NULL;
+}
+
+static int confronta_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Legge i codici (primo campo di ogni riga) da nomi.txt e, se 'nomi' non è
+// NULL, anche i nomi (secondo campo)
+static int32_t *leggi_codici(const char *path, int *num, char ***nomi) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror("apertura di nomi.txt fallita");
+        exit(EXIT_FAILURE);
+    }
+    int cap = 1024, n = 0;
+    int32_t *codici = (int32_t *)xmalloc(cap * sizeof(int32_t));
+    if (nomi) *nomi = (char **)xmalloc(cap * sizeof(char *));
+    char *riga = NULL;
+    size_t dim = 0;
+    while (getline(&riga, &dim, fp) != -1) {
+        char *fine;
+        long codice = strtol(riga, &fine, 10);
+        if (fine == riga) continue;
+        if (n == cap) {
+            cap *= 2;
+            codici = (int32_t *)realloc(codici, cap * sizeof(int32_t));
+            if (nomi) *nomi = (char **)realloc(*nomi, cap * sizeof(char *));
+            if (!codici || (nomi && !*nomi)) {
+                perror("realloc fallita");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (nomi) {
+            char *nome = fine + (*fine == '\t');
+            (*nomi)[n] = strndup(nome, strcspn(nome, "\t\n"));
+        }
+        codici[n++] = (int32_t)codice;
+    }
+    free(riga);
+    fclose(fp);
+    if (n == 0) {
+        fprintf(stderr, "Errore: %s non contiene codici.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    *num = n;
+    return codici;
+}
+
+int main(int argc, char *argv[]) {
+    // Opzioni:
+    //   -n <coppie>    coppie inviate in totale (default: 100000)
+    //   -b <coppie>    coppie per batch, in una sola write (default: 511, il
+    //                  massimo entro PIPE_BUF; 0: coppie nude, una per write)
+    //   -c <client>    client contemporanei, ognuno con la propria apertura della pipe (default: 1)
+    //   -p <pipe>      FIFO del server (default: cammini.pipe)
+    //   -u <socket>    usa il socket del server invece della FIFO, aspettando le risposte
+    //   -w <coppie>    con -u, richieste in volo al massimo per client (default: 64)
+    //   -N             chiede le coppie per nome (richieste per nome, senza batch)
+    long totale = 100000;
+    int per_batch = 511, num_client = 1, finestra = 64, per_nome = 0;
+    const char *pipe = "cammini.pipe", *sock = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:c:p:u:w:N")) != -1) {
+        switch (opt) {
+        case 'n': totale = atol(optarg); break;
+        case 'b': per_batch = atoi(optarg); break;
+        case 'c': num_client = atoi(optarg); break;
+        case 'p': pipe = optarg; break;
+        case 'u': sock = optarg; break;
+        case 'w': finestra = atoi(optarg); break;
+        case 'N': per_nome = 1; break;
+        default:
+            fprintf(stderr, "Uso: %s [-n coppie] [-b per_batch] [-c client] [-p pipe | -u socket [-w finestra]] [-N] <filenomi>\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (argc - optind != 1 || totale <= 0 || per_batch < 0 || num_client <= 0 || num_client > 1024 || finestra <= 0) {
+        fprintf(stderr, "Uso: %s [-n coppie] [-b per_batch] [-c client] [-p pipe | -u socket [-w finestra]] [-N] <filenomi>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    int num_codici;
+    char **nomi = NULL;
+    int32_t *codici = leggi_codici(argv[optind], &num_codici, per_nome ? &nomi : NULL);
+
+    client_t *client = (client_t *)xmalloc(num_client * sizeof(client_t));
+    pthread_t *tids = (pthread_t *)xmalloc(num_client * sizeof(pthread_t));
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < num_client; ++i) {
+        client[i] = (client_t){ i, pipe, codici, nomi, num_codici,
+                                totale / num_client + (i < totale % num_client), per_batch, 0,
+                                sock, finestra, NULL, 0 };
+        if (pthread_create(&tids[i], NULL, client_thread_func, &client[i]) != 0) {
+            perror("pthread_create fallito");
+            exit(EXIT_FAILURE);
+        }
+    }
+    long write_totali = 0;
+    for (int i = 0; i < num_client; ++i) {
+        pthread_join(tids[i], NULL);
+        write_totali += client[i].write_eseguite;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%ld coppie in %.3f s: %.0f coppie/s (%d client, %ld write)\n",
+           totale, sec, totale / sec, num_client, write_totali);
+
+    if (sock) {
+        // Latenze di tutte le risposte, dall'invio della richiesta
+        double *latenze = (double *)xmalloc(totale * sizeof(double));
+        long n = 0;
+        for (int i = 0; i < num_client; ++i) {
+            memcpy(latenze + n, client[i].latenze, client[i].risposte * sizeof(double));
+            n += client[i].risposte;
+            free(client[i].latenze);
+        }
+        qsort(latenze, n, sizeof(double), confronta_double);
+        printf("Latenza (finestra %d): p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", finestra,
+               latenze[n / 2] * 1e3, latenze[n * 99 / 100] * 1e3, latenze[n - 1] * 1e3);
+        free(latenze);
+    }
+
+    free(tids);
+    free(client);
+    if (nomi) {
+        for (int i = 0; i < num_codici; ++i) free(nomi[i]);
+        free(nomi);
+    }
+    free(codici);
+    return 0;
+}
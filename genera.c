@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <math.h>
+
+// Generatore di grafi sintetici simili a quello di IMDb, per misurare
+// cammini.out e CreaGrafo senza i file TSV originali.
+//
+// Ogni titolo ha un cast di dimensione distribuita secondo una legge di
+// potenza; i membri del cast sono scelti con probabilità proporzionale alla
+// popolarità dell'attore, anch'essa una legge di potenza (Zipf). Il grafo dei
+// coprotagonisti è l'unione delle cricche dei cast, quindi ha pochi attori con
+// moltissimi vicini e molti attori con pochi, come quello reale.
+// A parità di opzioni e seme l'output è sempre lo stesso.
+//
+// Scrive nomi.txt e grafo.txt nello stesso formato di CreaGrafo e, con -T,
+// anche name.basics.tsv, title.principals.tsv e title.basics.tsv: dati a
+// CreaGrafo producono gli stessi nomi.txt e grafo.txt.
+
+#define CAST_MAX 80
+
+static void *xmalloc(size_t n) {
+    void *p = malloc(n);
+    if (!p) {
+        perror("malloc fallita");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static FILE *xfopen(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    return fp;
+}
+
+// xorshift64*: veloce e riproducibile su ogni piattaforma, a differenza di rand()
+static uint64_t S_STATO = 88172645463325252ULL;
+
+static uint64_t casuale(void) {
+    S_STATO ^= S_STATO >> 12;
+    S_STATO ^= S_STATO << 25;
+    S_STATO ^= S_STATO >> 27;
+    return S_STATO * 2685821657736338717ULL;
+}
+
+// Reale uniforme in (0, 1]
+static double casuale_unitario(void) {
+    return ((casuale() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+// Persona del file dei nomi: solo gli attori entrano in nomi.txt
+typedef struct {
+    int codice;
+    int anno;                   // 0: anno di nascita sconosciuto (\N)
+    int attore;                 // professione actor/actress
+} persona_t;
+
+static const char *S_NOMI[] = { "Anna", "Marco", "Giulia", "Luca", "Sara", "Paolo", "Elena", "Carlo",
+                                "Marta", "Pietro", "Laura", "Franco", "Chiara", "Dario", "Rosa", "Enzo" };
+static const char *S_SILLABE[] = { "ro", "ma", "ti", "lo", "ver", "den", "ca", "sel", "bri", "no",
+                                   "fa", "gi", "mon", "ta", "ler", "pa" };
+
+// Nome deterministico della persona i
+static void nome_persona(int i, char *buf, size_t dim) {
+    unsigned x = (unsigned)i * 2654435761u;
+    snprintf(buf, dim, "%s %c%s%s%s", S_NOMI[x % 16], 'A' + (x >> 4) % 26, S_SILLABE[(x >> 9) % 16],
+             S_SILLABE[(x >> 13) % 16], S_SILLABE[(x >> 17) % 16]);
+}
+
+// Indice dell'attore scelto: ricerca binaria sulle popolarità cumulate
+static int scegli_attore(const double *cumulate, int n) {
+    double u = casuale_unitario() * cumulate[n - 1];
+    int lo = 0, hi = n - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (cumulate[mid] < u) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int confronta_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    // Opzioni:
+    //   -a <attori>    attori in nomi.txt (default: 100000)
+    //   -t <titoli>    titoli (default: 2 per attore)
+    //   -z <esponente> esponente della popolarità degli attori (default: 0.8;
+    //                  più alto: gradi più sbilanciati)
+    //   -k <esponente> esponente della legge di potenza delle dimensioni dei
+    //                  cast, maggiore di 1 (default: 2.5)
+    //   -s <seme>      seme del generatore (default: 1)
+    //   -T             scrive anche i file TSV per CreaGrafo
+    long num_attori = 100000, num_titoli = -1, seme = 1;
+    double zipf = 0.8, esponente_cast = 2.5;
+    int tsv = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:t:z:k:s:T")) != -1) {
+        switch (opt) {
+        case 'a': num_attori = atol(optarg); break;
+        case 't': num_titoli = atol(optarg); break;
+        case 'z': zipf = atof(optarg); break;
+        case 'k': esponente_cast = atof(optarg); break;
+        case 's': seme = atol(optarg); break;
+        case 'T': tsv = 1; break;
+        default:
+            fprintf(stderr, "Uso: %s [-a attori] [-t titoli] [-z esponente] [-k esponente] [-s seme] [-T]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (num_titoli < 0) num_titoli = 2 * num_attori;
+    if (num_attori < 2 || num_attori > 100000000 || num_titoli > 1000000000L || zipf < 0 || esponente_cast <= 1) {
+        fprintf(stderr, "Errore: parametri non validi.\n");
+        exit(EXIT_FAILURE);
+    }
+    S_STATO ^= (uint64_t)seme * 0x9E3779B97F4A7C15ULL;
+    if (S_STATO == 0) S_STATO = 1;
+
+    // Persone: circa un quarto non entra in nomi.txt (non attore, o attore con
+    // anno sconosciuto), come nel file reale. I codici crescono con buchi.
+    long cap_persone = num_attori * 2, num_persone = 0, num_esclusi = 0, n_attori = 0;
+    persona_t *persone = (persona_t *)xmalloc(cap_persone * sizeof(persona_t));
+    int *attori = (int *)xmalloc(num_attori * sizeof(int));   // indici in 'persone'
+    int *esclusi = (int *)xmalloc(cap_persone * sizeof(int)); // indici in 'persone'
+    long codice = 0;
+    while (n_attori < num_attori && num_persone < cap_persone) {
+        persona_t *p = &persone[num_persone];
+        codice += 1 + casuale() % 4;
+        p->codice = (int)codice;
+        p->attore = 1;
+        p->anno = 1900 + (int)(casuale() % 106);
+        if (casuale() % 4 == 0) {
+            if (casuale() % 2) p->anno = 0;
+            else p->attore = 0;
+            esclusi[num_esclusi++] = (int)num_persone;
+        } else {
+            attori[n_attori++] = (int)num_persone;
+        }
+        num_persone++;
+    }
+    num_attori = n_attori;
+
+    // Popolarità: l'attore di rango r ha peso 1/(r+1)^zipf; i ranghi sono
+    // mescolati, così gli attori più noti non hanno tutti i codici più bassi.
+    int *rango = (int *)xmalloc(num_attori * sizeof(int));
+    for (long i = 0; i < num_attori; ++i) rango[i] = (int)i;
+    for (long i = num_attori - 1; i > 0; --i) {
+        long j = casuale() % (i + 1);
+        int tmp = rango[i];
+        rango[i] = rango[j];
+        rango[j] = tmp;
+    }
+    double *cumulate = (double *)xmalloc(num_attori * sizeof(double));
+    double somma = 0;
+    for (long i = 0; i < num_attori; ++i) {
+        somma += 1.0 / pow(rango[i] + 1.0, zipf);
+        cumulate[i] = somma;
+    }
+
+    // Cast: dimensione k >= 1 con P(k) ~ k^-esponente_cast, entro CAST_MAX
+    int *cast_inizio = (int *)xmalloc((num_titoli + 1) * sizeof(int));
+    size_t cap_cast = num_titoli * 4 + 16, dim_cast = 0;
+    int *cast = (int *)xmalloc(cap_cast * sizeof(int)); // indici in 'attori'
+    for (long t = 0; t < num_titoli; ++t) {
+        cast_inizio[t] = (int)dim_cast;
+        int k = (int)pow(casuale_unitario(), -1.0 / (esponente_cast - 1.0));
+        if (k > CAST_MAX) k = CAST_MAX;
+        if (k > num_attori) k = (int)num_attori;
+        if (dim_cast + k > cap_cast) {
+            cap_cast = cap_cast * 2 + k;
+            cast = (int *)realloc(cast, cap_cast * sizeof(int));
+            if (!cast) {
+                perror("realloc fallita");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (int j = 0; j < k; ++j) {
+            int a, doppio;
+            do { // Un attore compare una volta sola nello stesso cast
+                a = scegli_attore(cumulate, (int)num_attori);
+                doppio = 0;
+                for (size_t x = cast_inizio[t]; x < dim_cast; ++x) doppio |= cast[x] == a;
+            } while (doppio);
+            cast[dim_cast++] = a;
+        }
+    }
+    cast_inizio[num_titoli] = (int)dim_cast;
+    if (dim_cast > INT32_MAX / 2) {
+        fprintf(stderr, "Errore: troppe partecipazioni.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Coprotagonisti in CSR: gradi con ripetizioni, riempimento, poi ordinamento e deduplica
+    int64_t *offsets = (int64_t *)calloc(num_attori + 1, sizeof(int64_t));
+    if (!offsets) {
+        perror("calloc fallita");
+        exit(EXIT_FAILURE);
+    }
+    for (long t = 0; t < num_titoli; ++t) {
+        int k = cast_inizio[t + 1] - cast_inizio[t];
+        for (int j = cast_inizio[t]; j < cast_inizio[t + 1]; ++j) offsets[cast[j] + 1] += k - 1;
+    }
+    for (long i = 0; i < num_attori; ++i) offsets[i + 1] += offsets[i];
+    int *vicini = (int *)xmalloc((offsets[num_attori] + 1) * sizeof(int));
+    int64_t *pos = (int64_t *)xmalloc(num_attori * sizeof(int64_t));
+    memcpy(pos, offsets, num_attori * sizeof(int64_t));
+    for (long t = 0; t < num_titoli; ++t) {
+        for (int j = cast_inizio[t]; j < cast_inizio[t + 1]; ++j) {
+            for (int x = cast_inizio[t]; x < cast_inizio[t + 1]; ++x) {
+                if (x != j) vicini[pos[cast[j]]++] = persone[attori[cast[x]]].codice;
+            }
+        }
+    }
+
+    char nome[64];
+    FILE *fn = xfopen("nomi.txt");
+    FILE *fg = xfopen("grafo.txt");
+    int64_t archi = 0;
+    for (long i = 0; i < num_attori; ++i) {
+        const persona_t *p = &persone[attori[i]];
+        nome_persona(attori[i], nome, sizeof(nome));
+        fprintf(fn, "%d\t%s\t%d\n", p->codice, nome, p->anno);
+
+        int *v = vicini + offsets[i];
+        int64_t n = offsets[i + 1] - offsets[i], unici = 0;
+        qsort(v, n, sizeof(int), confronta_int);
+        for (int64_t j = 0; j < n; ++j) {
+            if (j == 0 || v[j] != v[j - 1]) v[unici++] = v[j];
+        }
+        fprintf(fg, "%d\t%" PRId64, p->codice, unici);
+        for (int64_t j = 0; j < unici; ++j) fprintf(fg, "\t%d", v[j]);
+        fputc('\n', fg);
+        archi += unici;
+    }
+    fclose(fn);
+    fclose(fg);
+
+    if (tsv) {
+        FILE *fp = xfopen("name.basics.tsv");
+        fprintf(fp, "nconst\tprimaryName\tbirthYear\tdeathYear\tprimaryProfession\tknownForTitles\n");
+        for (long i = 0; i < num_persone; ++i) {
+            nome_persona((int)i, nome, sizeof(nome));
+            fprintf(fp, "nm%07d\t%s\t", persone[i].codice, nome);
+            if (persone[i].anno) fprintf(fp, "%d", persone[i].anno);
+            else fprintf(fp, "\\N");
+            fprintf(fp, "\t\\N\t%s\t\\N\n", persone[i].attore ? (i % 2 ? "actress" : "actor,producer") : "director,writer");
+        }
+        fclose(fp);
+
+        // Ogni titolo ha anche un regista, preso tra le persone che non sono in
+        // nomi.txt: CreaGrafo lo ignora, come i registi del file reale.
+        fp = xfopen("title.principals.tsv");
+        FILE *fb = xfopen("title.basics.tsv");
+        fprintf(fp, "tconst\tordering\tnconst\tcategory\tjob\tcharacters\n");
+        fprintf(fb, "tconst\ttitleType\tprimaryTitle\toriginalTitle\tisAdult\tstartYear\tendYear\truntimeMinutes\tgenres\n");
+        for (long t = 0; t < num_titoli; ++t) {
+            int ordine = 1;
+            for (int j = cast_inizio[t]; j < cast_inizio[t + 1]; ++j) {
+                fprintf(fp, "tt%07ld\t%d\tnm%07d\tactor\t\\N\t\\N\n", t + 1, ordine++, persone[attori[cast[j]]].codice);
+            }
+            if (num_esclusi > 0) {
+                fprintf(fp, "tt%07ld\t%d\tnm%07d\tdirector\t\\N\t\\N\n", t + 1, ordine,
+                        persone[esclusi[casuale() % num_esclusi]].codice);
+            }
+            fprintf(fb, "tt%07ld\tmovie\tTitolo %ld\tTitolo %ld\t0\t%d\t\\N\t%d\tDrama\n",
+                    t + 1, t + 1, t + 1, 1920 + (int)(t % 100), 80 + (int)(t % 60));
+        }
+        fclose(fp);
+        fclose(fb);
+    }
+
+    fprintf(stderr, "%ld attori (%ld persone), %ld titoli, %zu partecipazioni, %" PRId64 " archi\n",
+            num_attori, num_persone, num_titoli, dim_cast, archi / 2);
+    free(pos);
+    free(vicini);
+    free(offsets);
+    free(cast);
+    free(cast_inizio);
+    free(cumulate);
+    free(rango);
+    free(esclusi);
+    free(attori);
+    free(persone);
+    return 0;
+}